@@ -137,7 +137,7 @@ static void coap_client_send_meas_run(void *o)
         {
             // Construct the coap message
             create_coap_row_mean_data_message(&user_ctx->row_mean_data_inventory[index], &coap_msg_buffer, get_timestamp());
-            LOG_INF("row_num: %d; temperature: %d; idx: %d", user_ctx->row_mean_data_inventory[index].row_id,user_ctx->row_mean_data_inventory[index].mean_row_temp, log_counter);
+            LOG_INF("row_num: %d; temperature: %d; idx: %d", user_ctx->row_mean_data_inventory[index].row_id,user_ctx->row_mean_data_inventory[index].mean.temperature, log_counter);
             // Send the coap message to coap server
             coap_put((uint8_t *)resource, strlen(resource), (uint8_t *)&coap_msg_buffer, sizeof(message_coap_row_mean_data_t));
         }
@@ -58,23 +58,23 @@ void gpio_row_control_msg_parse(message_control_gpios_t* p_gpios_control)
 {
     // LOG_INF("Controlling 9160 gpios");
     // Control fan for every row
-    gpio_pin_set(gpio_dev, ROW_1_FAN_GPIO, p_gpios_control->row_fan_control[0]);
-    gpio_pin_set(gpio_dev, ROW_2_FAN_GPIO, p_gpios_control->row_fan_control[1]);
-    gpio_pin_set(gpio_dev, ROW_3_FAN_GPIO, p_gpios_control->row_fan_control[2]);
-    gpio_pin_set(gpio_dev, ROW_4_FAN_GPIO, p_gpios_control->row_fan_control[3]);
-    gpio_pin_set(gpio_dev, ROW_5_FAN_GPIO, p_gpios_control->row_fan_control[4]);
+    gpio_pin_set(gpio_dev, ROW_1_FAN_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_fan_control, 0));
+    gpio_pin_set(gpio_dev, ROW_2_FAN_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_fan_control, 1));
+    gpio_pin_set(gpio_dev, ROW_3_FAN_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_fan_control, 2));
+    gpio_pin_set(gpio_dev, ROW_4_FAN_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_fan_control, 3));
+    gpio_pin_set(gpio_dev, ROW_5_FAN_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_fan_control, 4));
 
     // control water for every row
-    gpio_pin_set(gpio_dev, ROW_1_WATER_GPIO, p_gpios_control->row_water_control[0]);
-    gpio_pin_set(gpio_dev, ROW_2_WATER_GPIO, p_gpios_control->row_water_control[1]);
-    gpio_pin_set(gpio_dev, ROW_3_WATER_GPIO, p_gpios_control->row_water_control[2]);
-    gpio_pin_set(gpio_dev, ROW_4_WATER_GPIO, p_gpios_control->row_water_control[3]);
-    gpio_pin_set(gpio_dev, ROW_5_WATER_GPIO, p_gpios_control->row_water_control[4]);
+    gpio_pin_set(gpio_dev, ROW_1_WATER_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_water_control, 0));
+    gpio_pin_set(gpio_dev, ROW_2_WATER_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_water_control, 1));
+    gpio_pin_set(gpio_dev, ROW_3_WATER_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_water_control, 2));
+    gpio_pin_set(gpio_dev, ROW_4_WATER_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_water_control, 3));
+    gpio_pin_set(gpio_dev, ROW_5_WATER_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_water_control, 4));
 
     // control light for every row
-    gpio_pin_set(gpio_dev, ROW_1_LIGHT_GPIO, p_gpios_control->row_lights_control[0]);
-    gpio_pin_set(gpio_dev, ROW_2_LIGHT_GPIO, p_gpios_control->row_lights_control[1]);
-    gpio_pin_set(gpio_dev, ROW_3_LIGHT_GPIO, p_gpios_control->row_lights_control[2]);
-    gpio_pin_set(gpio_dev, ROW_4_LIGHT_GPIO, p_gpios_control->row_lights_control[3]);
-    gpio_pin_set(gpio_dev, ROW_5_LIGHT_GPIO, p_gpios_control->row_lights_control[4]);
+    gpio_pin_set(gpio_dev, ROW_1_LIGHT_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_lights_control, 0));
+    gpio_pin_set(gpio_dev, ROW_2_LIGHT_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_lights_control, 1));
+    gpio_pin_set(gpio_dev, ROW_3_LIGHT_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_lights_control, 2));
+    gpio_pin_set(gpio_dev, ROW_4_LIGHT_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_lights_control, 3));
+    gpio_pin_set(gpio_dev, ROW_5_LIGHT_GPIO, ROW_BITMAP_TEST(p_gpios_control->row_lights_control, 4));
 }
\ No newline at end of file
@@ -67,7 +67,7 @@ uint8_t store_row_mean_data_message(message_row_mean_data_t *msg_to_store)
 {
     uint8_t ret = FAILURE;
 
-    if (msg_to_store->message_buffer.row_id <= MAX_CONFIGURATION_ID || msg_to_store->message_buffer.row_id > 0)
+    if (msg_to_store->message_buffer.row_id <= MAX_CONFIGURATION_ID && msg_to_store->message_buffer.row_id > 0)
     {
         memcpy(&row_mean_data_inventory[msg_to_store->message_buffer.row_id - 1], &msg_to_store->message_buffer, sizeof(row_mean_data_t));
         ret = SUCCESS;
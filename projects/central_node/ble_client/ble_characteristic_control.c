@@ -13,6 +13,7 @@
 #include "../measurements/measurements_data_storage.h"
 #include "../../common/common.h"
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_DECLARE(ble_m);
@@ -115,9 +116,9 @@ static uint8_t read_characteristic_cb(struct bt_conn *conn, uint8_t err,
                                       struct bt_gatt_read_params *params,
                                       const void *data, uint16_t length)
 {
-    // Measured data are casted to 32 bit integer, we might have another var type for
-    // each characteristic
-    int32_t *measurement_data = (int32_t *)data;
+    // Measurements are sent as the fields of measurement_values_t (little endian),
+    // configuration id and battery level are read from their first byte
+    const uint8_t *measurement_data = data;
     // fetch the ble_connection_data bluetooth_devices that corresponds to the
     // given connection handle
     ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
@@ -140,27 +141,27 @@ static uint8_t read_characteristic_cb(struct bt_conn *conn, uint8_t err,
     if (params->single.handle == conn_data->temperature_value_handle)
     {
         // Store measured temperature on measurement_data
-        set_temperature_measurement_value(conn, *measurement_data);
+        set_temperature_measurement_value(conn, (int16_t)sys_get_le16(measurement_data));
     }
     else if (params->single.handle == conn_data->humidity_value_handle)
     {
-        set_humidity_measurement_value(conn, *measurement_data);
+        set_humidity_measurement_value(conn, sys_get_le16(measurement_data));
     }
     else if(params->single.handle == conn_data->soil_moisture_value_handle)
     {
-        set_soil_moisture_measurement_value(conn, *measurement_data);
+        set_soil_moisture_measurement_value(conn, sys_get_le16(measurement_data));
     }
     else if(params->single.handle == conn_data->light_intensity_value_handle)
     {
-        set_light_intensity_measurement_value(conn, *measurement_data);
+        set_light_intensity_measurement_value(conn, sys_get_le16(measurement_data));
     }
     else if (params->single.handle == conn_data->configuration_value_handle)
     {
-        set_configuration_id_value(conn, (uint8_t)*measurement_data);
+        set_configuration_id_value(conn, *measurement_data);
     }
     else if (params->single.handle == conn_data->battery_value_handle)
     {
-        set_battery_level_value(conn, (uint8_t)*measurement_data);
+        set_battery_level_value(conn, *measurement_data);
     }
 
     return BT_GATT_ITER_STOP;
@@ -161,10 +161,9 @@ static void connected(struct bt_conn *conn, uint8_t conn_err)
     char addr[BT_ADDR_LE_STR_LEN];
     char *log_addr;
 
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-
     if (conn_err)
     {
+        bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
         log_addr = strdup(addr);
         LOG_INF("Failed to connect to %s (%u)", log_addr, conn_err);
 
@@ -176,8 +175,6 @@ static void connected(struct bt_conn *conn, uint8_t conn_err)
     }
     // Set connected flag to true after connection is established
     ble_connection_data->is_connected = true;
-    // Store mac address of device
-    memcpy(ble_connection_data->mac_address, addr, sizeof(char) * MAC_ADDRESS_LENGTH);
 
     k_sem_give(&ble_connect_ok_sem);
     k_sem_give(&at_least_one_active_connection_sem);
@@ -115,24 +115,4 @@ struct bt_conn *get_ble_conn_handles(uint8_t index)
         LOG_INF("Wrong ble device index %d", index);
         return NULL;
     }
-}
-
-/**
- * @brief Function to retreive the mac address of a bluetooth connection
- * 
- * @param conn 
- * @return the mac address corresponding to the connection handle
- * @return NULL if the connection handle is not found on the array of ble devices
- */
-char *get_mac_address_by_conn_handle(struct bt_conn* conn)
-{
-    for(int index = 0; index < BLE_MAX_CONNECTIONS; index++)
-    {
-        if(bluetooth_devices->ble_connection_handle == conn)
-        {
-            return bluetooth_devices->mac_address;
-        }
-    }
-
-    return NULL;
 }
\ No newline at end of file
@@ -14,7 +14,6 @@
 typedef struct ble_connection_data_s
 {
     struct bt_conn *ble_connection_handle;
-    char mac_address[MAC_ADDRESS_LENGTH];
     bool is_connected;
     uint16_t temperature_value_handle;
     uint16_t humidity_value_handle;
@@ -30,5 +29,4 @@ void remove_connection_data(struct bt_conn *conn);
 ble_connection_data_t *get_device_by_conn_handle(struct bt_conn *conn);
 
 struct bt_conn *get_ble_conn_handles(uint8_t index);
-char *get_mac_address_by_conn_handle(struct bt_conn* conn);
 #endif // BLE_CONNECTION_DATA_H
@@ -84,13 +84,13 @@ static void env_control_run(void *o)
                 // Control the fan
                 if (get_row_fan_switch(row_index))
                 {
-                    message_control_gpios.row_fan_control[row_index] = true;
+                    ROW_BITMAP_SET(message_control_gpios.row_fan_control, row_index);
                     // Set fan on for row index
                     LOG_INF("Manual fan on for %d", row_index + 1);
                 }
                 else
                 {
-                    message_control_gpios.row_fan_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_fan_control, row_index);
                     // Set fan off for row index
                     LOG_INF("Manual fan off for %d", row_index + 1);
                 }
@@ -98,13 +98,13 @@ static void env_control_run(void *o)
                 // Control the water
                 if (get_row_water_switch(row_index))
                 {
-                    message_control_gpios.row_water_control[row_index] = true;
+                    ROW_BITMAP_SET(message_control_gpios.row_water_control, row_index);
                     // Set water on for row index
                     LOG_INF("Manual water on for %d", row_index + 1);
                 }
                 else
                 {
-                    message_control_gpios.row_water_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
                     // Set water off for row index
                     LOG_INF("Manual water off for %d", row_index + 1);
                 }
@@ -112,13 +112,13 @@ static void env_control_run(void *o)
                 // Control the lights
                 if (get_row_light_switch(row_index))
                 {
-                    message_control_gpios.row_lights_control[row_index] = true;
+                    ROW_BITMAP_SET(message_control_gpios.row_lights_control, row_index);
                     // Set lights on for row index
                     LOG_INF("Manual lights on for %d", row_index + 1);
                 }
                 else
                 {
-                    message_control_gpios.row_lights_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_lights_control, row_index);
                     // Set lights off for row index
                     LOG_INF("Manual lights off for %d", row_index + 1);
                 }
@@ -128,13 +128,13 @@ static void env_control_run(void *o)
                 // Control the fan
                 if ((get_row_current_temperature(row_index) > get_row_temp_threshold(row_index)) || (get_row_current_humidity(row_index) > get_row_hum_threshold(row_index)))
                 {
-                    message_control_gpios.row_fan_control[row_index] = true;
+                    ROW_BITMAP_SET(message_control_gpios.row_fan_control, row_index);
                     // Set fan on for row index
                     LOG_INF("Auto fan on for %d", row_index + 1);
                 }
                 else
                 {
-                    message_control_gpios.row_fan_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_fan_control, row_index);
                     // Set fan off for row index
                     LOG_INF("Auto fan off for %d", row_index + 1);
                 }
@@ -142,35 +142,35 @@ static void env_control_run(void *o)
                 // Control the water
                 if (get_row_current_soil_moisture(row_index) < get_row_soil_moisture_threshold(row_index))
                 {
-                    message_control_gpios.row_water_control[row_index] = true;
+                    ROW_BITMAP_SET(message_control_gpios.row_water_control, row_index);
                     // Set water on for row index
                     LOG_INF("Auto water on for %d", row_index + 1);
                 }
                 // Water will be turned off after we exceed the threshold 10% of the user requested limit
                 else if (get_row_current_soil_moisture(row_index) > get_row_soil_moisture_threshold(row_index) + SOIL_MOISTURE_OFFSET * get_row_soil_moisture_threshold(row_index))
                 {
-                    message_control_gpios.row_water_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
                     // Set water off for row index
                     LOG_INF("Auto water off for %d", row_index + 1);
                 }
                 // if soil moisture reaches 100%, water must be turned off TODO: Check if 100 should be lower, like 90%
                 else if (get_row_current_soil_moisture(row_index) >= ONE_HUNDRED_PERCENT)
                 {
-                    message_control_gpios.row_water_control[row_index] = false;
+                    ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
                     // Set water off for row index
                     LOG_INF("Auto water off for %d", row_index + 1);
                 }
                 // Lights will be on as long as the row is registered
-                message_control_gpios.row_lights_control[row_index] = true;
+                ROW_BITMAP_SET(message_control_gpios.row_lights_control, row_index);
                     // Set lights on for row index
                 LOG_INF("Auto lights on for %d", row_index + 1);
             }
         }
         else
         {
-            message_control_gpios.row_fan_control[row_index] = false;
-            message_control_gpios.row_water_control[row_index] = false;
-            message_control_gpios.row_lights_control[row_index] = false;
+            ROW_BITMAP_CLEAR(message_control_gpios.row_fan_control, row_index);
+            ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
+            ROW_BITMAP_CLEAR(message_control_gpios.row_lights_control, row_index);
             // Set fan/water/light off
             LOG_INF("Row not registered, so all off %d", row_index + 1);
         }
@@ -13,9 +13,12 @@ LOG_MODULE_DECLARE(measurements_m);
 
 // --- static variables definitions --------------------------------------------
 // measurement_data will store all measurements from each sensor node
+static measurements_data_t measurement_data[BLE_MAX_CONNECTIONS];
+// Connection handle of every measurement_data slot. The handle only has a meaning on
+// this device, so it is kept out of measurements_data_t (nodes are identified by address)
 // get_all_ble_connection_handles() function fills this array with conenction handles only
 // if a connection gets invalid, measurement_data will not be updated
-static measurements_data_t measurement_data[BLE_MAX_CONNECTIONS];
+static struct bt_conn *measurement_connection_handle[BLE_MAX_CONNECTIONS];
 // mean_row_measurements will store mean measurement values for every row
 static row_mean_data_t mean_row_measurements[MAX_CONFIGURATION_ID];
 
@@ -30,6 +33,22 @@ row_mean_data_t *get_row_mean_data(void)
     return mean_row_measurements;
 }
 
+/**
+ * @brief Get the connection handle of a measurement_data slot
+ *
+ * @param device_index Index of the node on measurement_data
+ * @return connection handle, NULL if the node is not connected
+ */
+struct bt_conn *get_measurement_connection_handle(uint16_t device_index)
+{
+    if (device_index >= BLE_MAX_CONNECTIONS)
+    {
+        return NULL;
+    }
+
+    return measurement_connection_handle[device_index];
+}
+
 /**
  * @brief function to clear measurement_data, this is called
  *        every time we take measurements
@@ -39,26 +58,25 @@ void clear_measurement_data(void)
 {
     // Clean measurement_data array
     memset(measurement_data, 0, sizeof(measurements_data_t) * BLE_MAX_CONNECTIONS);
+    memset(measurement_connection_handle, 0, sizeof(measurement_connection_handle));
     memset(mean_row_measurements, 0, sizeof(row_mean_data_t) * MAX_CONFIGURATION_ID);
 }
 
 /**
  * @brief Get all connection handles from connected sensor nodes and store them
- *        on measurement_data.ble_connection_handle member
+ *        on measurement_connection_handle
  *
  */
 void get_all_ble_connection_handles(void)
 {
-    char *mac_address;
-    // store all connection handles on the local variable measurement_data
+    // store all connection handles on the local variable measurement_connection_handle
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
         // TODO: make sure ble_connection_handle is null if device is not connected
-        measurement_data[i].ble_connection_handle = get_ble_conn_handles(i);
-        mac_address = get_mac_address_by_conn_handle(measurement_data[i].ble_connection_handle);
-        if(mac_address != NULL)
+        measurement_connection_handle[i] = get_ble_conn_handles(i);
+        if (measurement_connection_handle[i] != NULL)
         {
-            memcpy(measurement_data[i].mac_address, mac_address, MAC_ADDRESS_LENGTH * sizeof(char));
+            bt_addr_le_copy(&measurement_data[i].peer_address, bt_conn_get_dst(measurement_connection_handle[i]));
         }
     }
 }
@@ -70,13 +88,13 @@ void get_all_ble_connection_handles(void)
  * @param conn Ble connection handle
  * @param measured_temperature Measured temp
  */
-void set_temperature_measurement_value(struct bt_conn *conn, int32_t measured_temperature)
+void set_temperature_measurement_value(struct bt_conn *conn, int16_t measured_temperature)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
-            measurement_data[i].ambient_temp_measurement = measured_temperature;
+            measurement_data[i].values.temperature = measured_temperature;
             k_sem_give(&read_response_sem);
             break;
         }
@@ -90,13 +108,13 @@ void set_temperature_measurement_value(struct bt_conn *conn, int32_t measured_te
  * @param conn Ble connection handle
  * @param measured_humidity Measured humidity
  */
-void set_humidity_measurement_value(struct bt_conn *conn, int32_t measured_humidity)
+void set_humidity_measurement_value(struct bt_conn *conn, uint16_t measured_humidity)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
-            measurement_data[i].ambient_hum_measurement = measured_humidity;
+            measurement_data[i].values.humidity = measured_humidity;
             k_sem_give(&read_response_sem);
             break;
         }
@@ -110,13 +128,13 @@ void set_humidity_measurement_value(struct bt_conn *conn, int32_t measured_humid
  * @param conn 
  * @param soil_moisture 
  */
-void set_soil_moisture_measurement_value(struct bt_conn *conn, int32_t soil_moisture)
+void set_soil_moisture_measurement_value(struct bt_conn *conn, uint16_t soil_moisture)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
-            measurement_data[i].soil_moisture_measurement = soil_moisture;
+            measurement_data[i].values.soil_moisture = soil_moisture;
             k_sem_give(&read_response_sem);
             break;
         }
@@ -130,13 +148,13 @@ void set_soil_moisture_measurement_value(struct bt_conn *conn, int32_t soil_mois
  * @param conn 
  * @param light_intensity 
  */
-void set_light_intensity_measurement_value(struct bt_conn *conn, int32_t light_intensity)
+void set_light_intensity_measurement_value(struct bt_conn *conn, uint16_t light_intensity)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
-            measurement_data[i].light_measurement = light_intensity;
+            measurement_data[i].values.light_intensity = light_intensity;
             k_sem_give(&read_response_sem);
             break;
         }
@@ -154,7 +172,7 @@ void set_configuration_id_value(struct bt_conn *conn, uint8_t configuration_id)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
             measurement_data[i].row_id = configuration_id;
             if (configuration_id > 0 && configuration_id <= MAX_CONFIGURATION_ID)
@@ -185,7 +203,7 @@ void set_battery_level_value(struct bt_conn *conn, uint8_t battery_level)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (measurement_connection_handle[i] == conn)
         {
             measurement_data[i].battery_level = battery_level;
             k_sem_give(&read_response_sem);
@@ -209,18 +227,18 @@ bool measurements_and_device_data(void)
     // Take measurements from every connected sensor node
     for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
     {
-        if (measurement_data[index].ble_connection_handle != NULL)
+        if (measurement_connection_handle[index] != NULL)
         {
             measurement_taken++;
             for (int char_index = 0; char_index < MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT + CONFIGURE_SERVICE_CHARACTERISTIC_COUNT; char_index++)
             {
                 // Reading every characteristic value from measurement service. (As measurement service gets bigger, we will not need to change this function)
-                read_characteristic_wrapper(measurement_data[index].ble_connection_handle, char_index);
+                read_characteristic_wrapper(measurement_connection_handle[index], char_index);
                 err = k_sem_take(&read_response_sem, K_MSEC(1500));
                 if(err != 0)
                 {
                     LOG_INF("Error in characteristics read:%d", err);
-                    measurement_data[index].ble_connection_handle = NULL;
+                    measurement_connection_handle[index] = NULL;
                     // Measurement was invalid, so reduce measurement counter
                     measurement_taken--;
                     break;
@@ -235,19 +253,23 @@ bool measurements_and_device_data(void)
 // TODO: just for debug
 void print_all_measurements_and_connection_handles(void)
 {
+    char addr[BT_ADDR_LE_STR_LEN];
+
     // Take measurements from every connected sensor node
     for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
     {
-        if (measurement_data[index].ble_connection_handle != NULL)
+        if (measurement_connection_handle[index] != NULL)
         {
+            bt_addr_le_to_str(&measurement_data[index].peer_address, addr, sizeof(addr));
             LOG_INF("-----------------");
-            LOG_INF("Temperature is: %d.%d C", measurement_data[index].ambient_temp_measurement / 100, measurement_data[index].ambient_temp_measurement % 100);
-            LOG_INF("Humidity is: %d.%d percent", measurement_data[index].ambient_hum_measurement / 100, measurement_data[index].ambient_hum_measurement % 100);
-            LOG_INF("Soil moisture is: %d percent", measurement_data[index].soil_moisture_measurement);
-            LOG_INF("Light intensity is: %d", measurement_data[index].light_measurement);
+            LOG_INF("Address: %s", addr);
+            LOG_INF("Temperature is: %d.%d C", measurement_data[index].values.temperature / 100, measurement_data[index].values.temperature % 100);
+            LOG_INF("Humidity is: %d.%d percent", measurement_data[index].values.humidity / 100, measurement_data[index].values.humidity % 100);
+            LOG_INF("Soil moisture is: %d percent", measurement_data[index].values.soil_moisture);
+            LOG_INF("Light intensity is: %d", measurement_data[index].values.light_intensity);
             LOG_INF("Battery level is: %d percent", measurement_data[index].battery_level);
             LOG_INF("Configuration id is: %d", measurement_data[index].row_id);
-            LOG_INF("Conn handle: %d", (int)measurement_data[index].ble_connection_handle);
+            LOG_INF("Conn handle: %d", (int)measurement_connection_handle[index]);
             LOG_INF("-----------------");
         }
     }
@@ -146,13 +146,13 @@ static void calculate_mean_measurements_run(void *o)
                 if (user_ctx->measurements_data[measurement_data_index].row_id == user_ctx->row_mean_data[row_index].row_id)
                 {
                     // Mean row humidity
-                    mean_ambient_humidity += user_ctx->measurements_data[measurement_data_index].ambient_hum_measurement;
+                    mean_ambient_humidity += user_ctx->measurements_data[measurement_data_index].values.humidity;
                     // Mean row temp
-                    mean_ambient_temperature += user_ctx->measurements_data[measurement_data_index].ambient_temp_measurement;
+                    mean_ambient_temperature += user_ctx->measurements_data[measurement_data_index].values.temperature;
                     // Mean light intensity
-                    mean_light_intensity += user_ctx->measurements_data[measurement_data_index].light_measurement;
+                    mean_light_intensity += user_ctx->measurements_data[measurement_data_index].values.light_intensity;
                     // Mean soil moisture
-                    mean_soil_moisture += user_ctx->measurements_data[measurement_data_index].soil_moisture_measurement;
+                    mean_soil_moisture += user_ctx->measurements_data[measurement_data_index].values.soil_moisture;
                     // Increment measurement counter every time we find a node that exists on the row that is being currently referenced (row_index)
                     measurements_counter++;
                 }
@@ -164,10 +164,10 @@ static void calculate_mean_measurements_run(void *o)
             mean_soil_moisture /= measurements_counter;
             measurements_counter = 0;
             // Save mean values for the corresponding row
-            user_ctx->row_mean_data[row_index].mean_row_humidity = mean_ambient_humidity;
-            user_ctx->row_mean_data[row_index].mean_row_light = mean_light_intensity;
-            user_ctx->row_mean_data[row_index].mean_row_soil_moisture = mean_soil_moisture;
-            user_ctx->row_mean_data[row_index].mean_row_temp = mean_ambient_temperature;
+            user_ctx->row_mean_data[row_index].mean.humidity = mean_ambient_humidity;
+            user_ctx->row_mean_data[row_index].mean.light_intensity = mean_light_intensity;
+            user_ctx->row_mean_data[row_index].mean.soil_moisture = mean_soil_moisture;
+            user_ctx->row_mean_data[row_index].mean.temperature = mean_ambient_temperature;
             // Update the status of fan/water/lights for the corresponding row
             user_ctx->row_mean_data[row_index].is_fan_active = get_row_fan_switch(row_index);
             user_ctx->row_mean_data[row_index].is_watering_active = get_row_water_switch(row_index);
@@ -181,10 +181,10 @@ static void calculate_mean_measurements_run(void *o)
         if (user_ctx->row_mean_data[index].is_row_registered)
         {
             LOG_INF(" ------- MEAN DATA --------- row id: %d", user_ctx->row_mean_data[index].row_id);
-            //LOG_INF("Mean Temperature is: %d.%d C", user_ctx->row_mean_data[index].mean_row_temp / 100, user_ctx->row_mean_data[index].mean_row_temp % 100);
-            //LOG_INF("Mean Humidity is: %d.%d percent", user_ctx->row_mean_data[index].mean_row_humidity / 100, user_ctx->row_mean_data[index].mean_row_humidity % 100);
-            //LOG_INF("Mean Soil moisture is: %d percent", user_ctx->row_mean_data[index].mean_row_soil_moisture / 100);
-            //LOG_INF("Mean Light intensity is: %d", user_ctx->row_mean_data[index].mean_row_light);
+            //LOG_INF("Mean Temperature is: %d.%d C", user_ctx->row_mean_data[index].mean.temperature / 100, user_ctx->row_mean_data[index].mean.temperature % 100);
+            //LOG_INF("Mean Humidity is: %d.%d percent", user_ctx->row_mean_data[index].mean.humidity / 100, user_ctx->row_mean_data[index].mean.humidity % 100);
+            //LOG_INF("Mean Soil moisture is: %d percent", user_ctx->row_mean_data[index].mean.soil_moisture / 100);
+            //LOG_INF("Mean Light intensity is: %d", user_ctx->row_mean_data[index].mean.light_intensity);
         }
     }
 
@@ -207,10 +207,10 @@ static void environment_control_run(void *o)
         // on measurements data storage side
         if(user_ctx->row_mean_data[row_id].is_row_registered)
         {
-            set_row_current_humidity(user_ctx->row_mean_data[row_id].mean_row_humidity, row_id);
-            set_row_current_temperature(user_ctx->row_mean_data[row_id].mean_row_temp, row_id);
-            set_row_current_light_exposure(user_ctx->row_mean_data[row_id].mean_row_light, row_id);
-            set_row_current_soil_moisture(user_ctx->row_mean_data[row_id].mean_row_soil_moisture, row_id);
+            set_row_current_humidity(user_ctx->row_mean_data[row_id].mean.humidity, row_id);
+            set_row_current_temperature(user_ctx->row_mean_data[row_id].mean.temperature, row_id);
+            set_row_current_light_exposure(user_ctx->row_mean_data[row_id].mean.light_intensity, row_id);
+            set_row_current_soil_moisture(user_ctx->row_mean_data[row_id].mean.soil_moisture, row_id);
             set_row_registered(row_id);
         }
         else
@@ -262,7 +262,7 @@ static void send_data_to_9160_run(void *o)
     // Send all measurement data
     for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
     {
-        if (user_ctx->measurements_data[index].ble_connection_handle != NULL)
+        if (get_measurement_connection_handle(index) != NULL)
         {
             create_measurements_data_tx_message(&user_ctx->measurements_data[index], &msg_measurement_data);
             internal_uart_send_data((uint8_t *)&msg_measurement_data, sizeof(message_measurement_data_t));
@@ -10,8 +10,13 @@
 #include "ble_characteristic_control.h"
 #include "ble_fsm.h"
 #include "ble_connection_data.h"
+#include "ble_handle_cache.h"
+#include "ble_link_stats.h"
 #include "measurements/measurements_data_storage.h"
+#include "measurements/measurements_fsm_timer.h"
 #include "common.h"
+#include <errno.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/logging/log.h>
 
 // --- logging settings --------------------------------------------------------
@@ -22,17 +27,66 @@ LOG_MODULE_DECLARE(ble_m);
 #define SERVICE_MAP_SIZE 2
 // characteristic map contains all the supported characteristic UUIDs
 #define CHARACTERISTIC_MAP_SIZE MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT + CONFIGURE_SERVICE_CHARACTERISTIC_COUNT
+// How many times a failed characteristic read is repeated before the sequence moves on without it
+#define CHARACTERISTIC_READ_RETRY_BUDGET 2
+// The time beacon is written again when a read sequence starts this long after
+// the last one, so that the clock drift of the nodes stays small
+#define TIME_BEACON_RESYNC_PERIOD_MS (10 * 60 * 1000)
+// Single reads are counted on the read latency histogram of their characteristic index
+BUILD_ASSERT((CHARACTERISTIC_MAP_SIZE) == READ_LATENCY_CHARACTERISTIC_COUNT,
+             "READ_LATENCY_CHARACTERISTIC_COUNT must match the characteristic map");
+
+// --- structs -----------------------------------------------------------------
+// Every connection slot (same indexing as bluetooth_devices) owns its read
+// parameters, so a read can be in flight on every connection at the same time
+typedef struct read_slot_s
+{
+    struct bt_gatt_read_params read_parameters;
+    // Characteristic that is currently being read (see TEMPERATURE_CHAR_INDEX)
+    uint8_t char_index;
+    // true while the stack owns read_parameters
+    bool is_read_in_flight;
+    // true while all characteristics of the device are read one after the other
+    bool is_sequence_active;
+    // Retries left for the characteristic that is currently being read
+    uint8_t retries_left;
+    // First error of the sequence, reported when the sequence ends
+    int sequence_err;
+    // Uptime (ms) the sequence started and bytes read since, for the throughput benchmark
+    int64_t sequence_start_time;
+    uint32_t sequence_bytes;
+    // true while a measurement record read is handled by the stack
+    bool is_record_read;
+    // Cycle count the read request in flight was sent, for the read latency histograms
+    uint32_t request_cycles;
+#if defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+    // Value handles of a Read Multiple Variable request, by characteristic index
+    uint16_t handles[CHARACTERISTIC_MAP_SIZE];
+    // true while a Read Multiple Variable request is handled by the stack
+    bool is_multiple_read;
+    // true if a value of the response was cut by the ATT MTU
+    bool is_multiple_read_truncated;
+#endif
+} read_slot_t;
 
 // --- static variables definitions --------------------------------------------
 static struct bt_gatt_discover_params discover_params = {0};
-static struct bt_gatt_read_params read_parameters = {0};
+static read_slot_t read_slots[BLE_MAX_CONNECTIONS];
+#ifdef MEASUREMENTS_PUSH_MODE
+// Subscriptions to the measurement service characteristics of every connection slot
+// Indexed as [connection slot][characteristic index]
+static struct bt_gatt_subscribe_params subscribe_params[BLE_MAX_CONNECTIONS][MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT];
+// Used by the stack to discover the CCC handle of every subscription
+static struct bt_gatt_discover_params ccc_discover_params[BLE_MAX_CONNECTIONS][MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT];
+#endif
+// Service Changed indication subscription of every connection slot
+static struct bt_gatt_subscribe_params service_changed_subscribe_params[BLE_MAX_CONNECTIONS];
+static struct bt_gatt_discover_params service_changed_ccc_discover_params[BLE_MAX_CONNECTIONS];
 
 // --- service and characteristic map: here we store all supported services UUIDs and all supported characteristic UUIDs
 // those maps help us to reference a service or a characteristic by an index and not by UUIDs
 static struct bt_uuid *service[SERVICE_MAP_SIZE] = {BT_UUID_MEASUREMENT_SERVICE, BT_UUID_CONFIGURE_SERVICE};
 static struct bt_uuid *characteristic[CHARACTERISTIC_MAP_SIZE] = {BT_UUID_TEMPERATURE, BT_UUID_HUMIDITY, BT_UUID_SOIL_MOISTURE, BT_UUID_LIGHT_EXPOSURE, BT_UUID_CONFIGURATION, BT_UUID_BAS_BATTERY_LEVEL};
-static uint8_t service_index;
-static uint8_t characteristic_index;
 
 // --- static function declarations --------------------------------------------
 static uint8_t characteristic_discovery(struct bt_conn *conn,
@@ -43,13 +97,42 @@ static uint8_t read_characteristic_cb(struct bt_conn *conn, uint8_t err,
                                       struct bt_gatt_read_params *params,
                                       const void *data, uint16_t length);
 static void store_value_handle(struct bt_conn *conn, uint16_t value_handle, uint8_t characteristic);
+static void finish_read_sequence(read_slot_t *slot, uint8_t slot_index, int err);
+static void read_next_sequence_characteristic(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index);
+static uint16_t get_characteristic_value_handle(const ble_connection_data_t *conn_data, uint8_t char_select);
+static int read_slot_characteristic(struct bt_conn *conn, read_slot_t *slot, uint8_t char_select);
+static int read_slot_all_characteristics(struct bt_conn *conn, read_slot_t *slot);
+static int read_slot_measurement_record(struct bt_conn *conn, read_slot_t *slot);
+static uint8_t read_measurement_record_cb(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index,
+                                          uint8_t err, const void *data, uint16_t length);
+static void store_measurement_record(struct bt_conn *conn, const void *data);
+static void store_characteristic_value(struct bt_conn *conn, uint8_t char_index, const void *data);
+static uint16_t get_characteristic_value_length(uint8_t char_index);
+static void invalidate_cached_value_handles(struct bt_conn *conn, uint8_t err);
+static uint32_t get_read_latency(const read_slot_t *slot);
+static uint8_t service_changed_discovery(struct bt_conn *conn,
+                                         const struct bt_gatt_attr *attr,
+                                         struct bt_gatt_discover_params *params);
+static uint8_t service_changed_indicate_cb(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                                           const void *data, uint16_t length);
+static void service_changed_subscribe_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_subscribe_params *params);
+#ifdef MEASUREMENTS_PUSH_MODE
+static uint8_t measurement_notify_cb(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                                     const void *data, uint16_t length);
+#endif
+#if defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+static uint8_t read_multiple_characteristics_cb(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index,
+                                                uint8_t err, const void *data, uint16_t length);
+static int read_slot_multiple_characteristics(struct bt_conn *conn, read_slot_t *slot);
+#endif
 
 // --- static function definitions ---------------------------------------------
 /**
- * @brief Function that discovers characteristic handle. This function is actually
- *        a callback that characteristic_discovery_wrapper calls after setting the
- *        desired service and characteristic that should be discoverd and save
- *        its handle value
+ * @brief Function that discovers the characteristic handles of a service. This function
+ *        is actually a callback that characteristic_discovery_wrapper calls after setting
+ *        the desired service. When the service is found, every characteristic in the
+ *        handle range of the service is discovered in a single pass, and the value handle
+ *        of every characteristic found on the characteristic map is stored
  *
  * @param conn Connection handle
  * @param attr
@@ -61,48 +144,76 @@ static uint8_t characteristic_discovery(struct bt_conn *conn,
                                         struct bt_gatt_discover_params *params)
 {
     int err;
+    const struct bt_gatt_chrc *chrc;
+    ble_connection_data_t *conn_data;
 
     if (!attr)
     {
         LOG_INF("Discover complete");
         (void)memset(params, 0, sizeof(*params));
+        k_sem_give(&ble_char_discovery_sem);
         return BT_GATT_ITER_STOP;
     }
 
-    if (!bt_uuid_cmp(discover_params.uuid, service[service_index]))
+    if (params->type == BT_GATT_DISCOVER_PRIMARY)
     {
-        // TODO: should use "*params" probably. discover_params is constructed on
-        // characteristic_discovery_wrapper and  characteristic_discovery is called as
-        // a cb function with discovery_params as params
-        discover_params.uuid = characteristic[characteristic_index];
-        discover_params.start_handle = attr->handle + 1;
-        discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+        // Service found, walk all of its characteristics (no UUID filter)
+        params->uuid = NULL;
+        params->start_handle = attr->handle + 1;
+        params->end_handle = ((struct bt_gatt_service_val *)attr->user_data)->end_handle;
+        params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
 
-        err = bt_gatt_discover(conn, &discover_params);
+        err = bt_gatt_discover(conn, params);
         if (err)
         {
             remove_connection_data(conn);
             LOG_INF("Discover failed (err %d)", err);
+            k_sem_give(&ble_char_discovery_sem);
         }
+
+        return BT_GATT_ITER_STOP;
     }
-    else if (!bt_uuid_cmp(discover_params.uuid, characteristic[characteristic_index]))
-    {
-        // --- store characteristic handle
-        store_value_handle(conn, bt_gatt_attr_value_handle(attr), characteristic_index);
 
-        k_sem_give(&ble_char_discovery_sem);
+    // --- store the handle of a characteristic that exists on the characteristic map
+    chrc = attr->user_data;
+    // The measurement record and the time beacon are not on the map, the record
+    // is read instead of the whole map and the beacon is only written
+    conn_data = get_device_by_conn_handle(conn);
+    if (!bt_uuid_cmp(chrc->uuid, BT_UUID_MEASUREMENT_RECORD))
+    {
+        if (conn_data != NULL)
+        {
+            conn_data->measurement_record_value_handle = bt_gatt_attr_value_handle(attr);
+        }
+        return BT_GATT_ITER_CONTINUE;
+    }
+    if (!bt_uuid_cmp(chrc->uuid, BT_UUID_TIME_BEACON))
+    {
+        if (conn_data != NULL)
+        {
+            conn_data->time_beacon_value_handle = bt_gatt_attr_value_handle(attr);
+        }
+        return BT_GATT_ITER_CONTINUE;
+    }
 
-        return BT_GATT_ITER_STOP;
+    for (uint8_t char_index = 0; char_index < CHARACTERISTIC_MAP_SIZE; char_index++)
+    {
+        if (!bt_uuid_cmp(chrc->uuid, characteristic[char_index]))
+        {
+            store_value_handle(conn, bt_gatt_attr_value_handle(attr), char_index);
+            break;
+        }
     }
 
-    return BT_GATT_ITER_STOP;
+    return BT_GATT_ITER_CONTINUE;
 }
 
 /**
  * @brief Callback function that performs ble read on a desired characteristic
- *        of a connected device.
- *        TODO: probably add the measurements_data_storage setter in here to
- *              store the value
+ *        of a connected device. The read value is stored on the measurements
+ *        data storage. If a read sequence is active on the connection slot, the
+ *        read of the next characteristic is requested from here, so every
+ *        connection keeps its own read in flight independently of the others
  *
  * @param conn
  * @param err
@@ -115,248 +226,1113 @@ static uint8_t read_characteristic_cb(struct bt_conn *conn, uint8_t err,
                                       struct bt_gatt_read_params *params,
                                       const void *data, uint16_t length)
 {
-    // Measured data are casted to 32 bit integer, we might have another var type for
-    // each characteristic
-    int32_t *measurement_data = (int32_t *)data;
-    // fetch the ble_connection_data bluetooth_devices that corresponds to the
-    // given connection handle
-    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
-    // if nothing fetched (invalid connection handle), get_device_by_conn_handle()
-    // will return null
-    if (conn_data == NULL)
+    // Every connection slot owns its read parameters, so the slot is known
+    // from the params pointer without searching for the connection handle
+    read_slot_t *slot = CONTAINER_OF(params, read_slot_t, read_parameters);
+    uint8_t slot_index = slot - read_slots;
+    int ret;
+
+    if (slot->is_record_read)
     {
-        LOG_INF("Error in connection handle");
-        return BT_GATT_ITER_STOP;
+        return read_measurement_record_cb(conn, slot, slot_index, err, data, length);
     }
 
-    // TODO: define this error state (describe it better)
-    if (data == NULL)
+#if defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+    if (slot->is_multiple_read)
     {
-        LOG_INF("Read complete");
-        return BT_GATT_ITER_STOP;
+        return read_multiple_characteristics_cb(conn, slot, slot_index, err, data, length);
     }
+#endif
 
-    // printk for now -> will be replaced with measurements setter
-    if (params->single.handle == conn_data->temperature_value_handle)
+    // The stack is done with the read parameters of this slot
+    slot->is_read_in_flight = false;
+
+    // TODO: define this error state (describe it better)
+    if (err || data == NULL || length < get_characteristic_value_length(slot->char_index))
     {
-        // Store measured temperature on measurement_data
-        set_temperature_measurement_value(conn, *measurement_data);
+        LOG_INF("Read failed (err %d), characteristic: %d", err, slot->char_index);
+        if (err)
+        {
+            invalidate_cached_value_handles(conn, err);
+        }
+
+        // Single reads (read_characteristic_wrapper) stop here
+        if (!slot->is_sequence_active)
+        {
+            return BT_GATT_ITER_STOP;
+        }
+
+        // Repeat the read while the retry budget of the characteristic lasts,
+        // then move on without it (it stays invalid on the measurements data)
+        if (slot->retries_left > 0)
+        {
+            slot->retries_left--;
+            ret = read_slot_characteristic(conn, slot, slot->char_index);
+            if (ret)
+            {
+                finish_read_sequence(slot, slot_index, ret);
+            }
+            return BT_GATT_ITER_STOP;
+        }
+
+        if (slot->sequence_err == 0)
+        {
+            slot->sequence_err = err ? err : -ENODATA;
+        }
     }
-    else if (params->single.handle == conn_data->humidity_value_handle)
+    else
     {
-        set_humidity_measurement_value(conn, *measurement_data);
+        ble_link_stats_record_read_latency(conn, slot->char_index, get_read_latency(slot));
+        store_characteristic_value(conn, slot->char_index, data);
+        slot->sequence_bytes += length;
+
+        // Single reads (read_characteristic_wrapper) stop here
+        if (!slot->is_sequence_active)
+        {
+            return BT_GATT_ITER_STOP;
+        }
     }
-    else if(params->single.handle == conn_data->soil_moisture_value_handle)
+
+    // Move on to the next characteristic of the sequence
+    read_next_sequence_characteristic(conn, slot, slot_index);
+
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * @brief Function that requests the read of the next characteristic of the read
+ *        sequence of a connection slot, or ends the sequence after the last one
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @param slot_index Index of the slot (same as the bluetooth_devices index)
+ */
+static void read_next_sequence_characteristic(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index)
+{
+    int ret;
+
+    slot->char_index++;
+    slot->retries_left = CHARACTERISTIC_READ_RETRY_BUDGET;
+    if (slot->char_index >= CHARACTERISTIC_MAP_SIZE)
     {
-        set_soil_moisture_measurement_value(conn, *measurement_data);
+        finish_read_sequence(slot, slot_index, slot->sequence_err);
+        return;
     }
-    else if(params->single.handle == conn_data->light_intensity_value_handle)
+
+    ret = read_slot_characteristic(conn, slot, slot->char_index);
+    if (ret)
     {
-        set_light_intensity_measurement_value(conn, *measurement_data);
+        finish_read_sequence(slot, slot_index, ret);
     }
-    else if (params->single.handle == conn_data->configuration_value_handle)
+}
+
+/**
+ * @brief Function that returns the time since the read request in flight of a
+ *        connection slot was sent
+ *
+ * @param slot Read slot of the connection
+ * @return uint32_t read latency in us
+ */
+static uint32_t get_read_latency(const read_slot_t *slot)
+{
+    return k_cyc_to_us_floor32(k_cycle_get_32() - slot->request_cycles);
+}
+
+/**
+ * @brief Function that ends the read sequence of a connection slot and reports
+ *        the result to the measurements data storage
+ *
+ * @param slot Read slot of the connection
+ * @param slot_index Index of the slot (same as the bluetooth_devices index)
+ * @param err 0 if every characteristic was read, error code otherwise
+ */
+static void finish_read_sequence(read_slot_t *slot, uint8_t slot_index, int err)
+{
+    ble_connection_data_t *conn_data;
+    int64_t sequence_time;
+
+    if (!slot->is_sequence_active)
     {
-        set_configuration_id_value(conn, (uint8_t)*measurement_data);
+        return;
     }
-    else if (params->single.handle == conn_data->battery_value_handle)
+
+    slot->is_sequence_active = false;
+
+    // Throughput benchmark: bytes of the sequence over its duration
+    conn_data = get_device_by_conn_handle(get_ble_conn_handles(slot_index));
+    sequence_time = k_uptime_get() - slot->sequence_start_time;
+    if (conn_data != NULL)
     {
-        set_battery_level_value(conn, (uint8_t)*measurement_data);
+        conn_data->read_throughput = (uint32_t)((slot->sequence_bytes * 1000LL) / MAX(sequence_time, 1));
+        ble_link_stats_set_read_latency(conn_data->ble_connection_handle, (uint32_t)sequence_time);
     }
 
-    return BT_GATT_ITER_STOP;
+    set_read_sequence_result(slot_index, err);
 }
 
 /**
- * @brief Function that stores the handle value of the discovered characteristic
- *        on the corresponding bluetooth_device
+ * @brief Function that drops the cached value handles of a sensor node after a
+ *        read error that points at the handles. Link loss and timeouts
+ *        (BT_ATT_ERR_UNLIKELY for the reads in flight when a link drops) keep the
+ *        cache, the node reconnects with the same handles. If the handle itself
+ *        was rejected, the node is disconnected so that its next connection
+ *        discovers the characteristics again
  *
- * @param conn
- * @param value_handle
- * @param characteristic
+ * @param conn Connection handle
+ * @param err ATT error of the read
  */
-static void store_value_handle(struct bt_conn *conn, uint16_t value_handle, uint8_t characteristic)
+static void invalidate_cached_value_handles(struct bt_conn *conn, uint8_t err)
 {
-    ble_connection_data_t *conn_data;
-    conn_data = get_device_by_conn_handle(conn);
-
-    if (conn_data == NULL)
+    if (err != BT_ATT_ERR_INVALID_HANDLE && err != BT_ATT_ERR_ATTRIBUTE_NOT_FOUND &&
+        err != BT_ATT_ERR_READ_NOT_PERMITTED)
     {
-        LOG_INF("Invalid connection handle");
         return;
     }
 
-    switch (characteristic)
+    ble_handle_cache_invalidate(bt_conn_get_dst(conn));
+
+    if (err == BT_ATT_ERR_INVALID_HANDLE)
     {
-    case TEMPERATURE_CHAR_INDEX:
-        conn_data->temperature_value_handle = value_handle;
-        break;
-    case HUMIDITY_CHAR_INDEX:
-        conn_data->humidity_value_handle = value_handle;
-        break;
-    case SOIL_MOISTURE_CHAR_INDEX:
-        conn_data->soil_moisture_value_handle = value_handle;
-        break;
-    case LIGHT_INTENSITY_CHAR_INDEX:
-        conn_data->light_intensity_value_handle = value_handle;
-        break;
-    case CONFIGURATION_CHAR_INDEX:
-        conn_data->configuration_value_handle = value_handle;
-        break;
-    case BATTERY_CHAR_INDEX:
-        conn_data->battery_value_handle = value_handle;
-        break;
-    default:
-        LOG_INF("Invalid characteristic value: %d", characteristic);
-        break;
+        LOG_INF("Invalid value handle, disconnecting");
+        bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
     }
 }
 
-// --- function definitions ----------------------------------------------------
 /**
- * @brief Function that constructs discovery params, selects a desired service and characteristic
- *        and calls characteristic_discovery to discover (and store) the characteristic handle value
- *        of the selected service existing on the connection handle
- *        TODO: as more services or characteristics are added, the switch cases should be updated
- *              just like the static struct bt_uuid *service, static struct bt_uuid *characteristic
+ * @brief Callback of the Service Changed characteristic discovery. Stores the
+ *        value handle of the characteristic on the connection data
  *
  * @param conn Connection handle
- * @param service_select Service selection index (e.g. see MEASUREMENT_SERVICE_INDEX)
- * @param char_select Characteristic selection index (e.g. see TEMPERATURE_CHAR_INDEX)
+ * @param attr NULL if the peer has no Service Changed characteristic
+ * @param params
+ * @return uint8_t
  */
-void characteristic_discovery_wrapper(struct bt_conn *conn, uint8_t service_select, uint8_t char_select)
+static uint8_t service_changed_discovery(struct bt_conn *conn,
+                                         const struct bt_gatt_attr *attr,
+                                         struct bt_gatt_discover_params *params)
 {
-    int err;
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
 
-    // Set the index of the array: static struct bt_uuid *service to select the
-    // desired service UUID
-    // TODO: probably include the characteristic switch inside the service
-    // switch (case MEASUREMENT_SERVICE_INDEX)
-    //              ...
-    //              case TEMPERATURE_CHAR_INDEX ....
-    switch (service_select)
-    {
-    case MEASUREMENT_SERVICE_INDEX:
-        service_index = MEASUREMENT_SERVICE_INDEX;
-        // Set the index of the array: static struct bt_uuid *characteristic to
-        // select the desired characteristic UUID
-        switch (char_select)
-        {
-        case TEMPERATURE_CHAR_INDEX:
-            characteristic_index = TEMPERATURE_CHAR_INDEX;
-            break;
-        case HUMIDITY_CHAR_INDEX:
-            characteristic_index = HUMIDITY_CHAR_INDEX;
-            break;
-        case SOIL_MOISTURE_CHAR_INDEX:
-            characteristic_index = SOIL_MOISTURE_CHAR_INDEX;
-            break;
-        case LIGHT_INTENSITY_CHAR_INDEX:
-            characteristic_index = LIGHT_INTENSITY_CHAR_INDEX;
-            break;
-        default:
-            // --- Add debug info
-            LOG_INF("Invalid measurement characteristic selection: %d", char_select);
-            return;
-        }
-        break;
-    case CONFIGURE_SERVICE_INDEX:
-        service_index = CONFIGURE_SERVICE_INDEX;
-        // Set the index of the array: static struct bt_uuid *characteristic to
-        // select the desired characteristic UUID
-        switch (char_select)
-        {
-        case CONFIGURATION_CHAR_INDEX:
-            characteristic_index = CONFIGURATION_CHAR_INDEX;
-            break;
-        case BATTERY_CHAR_INDEX:
-            characteristic_index = BATTERY_CHAR_INDEX;
-            break;
-        default:
-            // --- Add debug info
-            LOG_INF("Invalid measurement characteristic selection: %d", char_select);
-            return;
-        }
-        break;
-    default:
-        // --- Add debug info
-        LOG_INF("Invalid service selection: %d", service_select);
-        return;
-        break;
+    if (attr != NULL && conn_data != NULL)
+    {
+        conn_data->service_changed_value_handle = bt_gatt_attr_value_handle(attr);
     }
 
-    // --- Discover characteristic parameters
-    discover_params.uuid = service[service_index];
-    discover_params.func = characteristic_discovery;
-    discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
-    discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
-    discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+    (void)memset(params, 0, sizeof(*params));
+    k_sem_give(&ble_char_discovery_sem);
+
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * @brief Callback function that is called when a sensor node indicates that its
+ *        GATT database changed. The cached handles of the node are dropped and the
+ *        node is disconnected, so that its next connection discovers them again
+ *
+ * @param conn Connection handle
+ * @param params
+ * @param data NULL when the subscription is removed (e.g. after disconnection)
+ * @param length
+ * @return uint8_t
+ */
+static uint8_t service_changed_indicate_cb(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                                           const void *data, uint16_t length)
+{
+    if (data == NULL)
+    {
+        params->value_handle = 0U;
+        return BT_GATT_ITER_STOP;
+    }
+
+    LOG_INF("Service changed, disconnecting");
+    ble_handle_cache_invalidate(bt_conn_get_dst(conn));
+    bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * @brief Callback function that is called when the Service Changed subscription
+ *        is written. Keeps the CCC handle (discovered by the stack if it was not
+ *        cached) on the connection data
+ *
+ * @param conn Connection handle
+ * @param err
+ * @param params
+ */
+static void service_changed_subscribe_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_subscribe_params *params)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
 
-    err = bt_gatt_discover(conn, &discover_params);
     if (err)
     {
-        LOG_INF("Discover failed(err %d)", err);
-        return;
+        LOG_INF("Service changed subscription failed (err %d)", err);
+        ble_handle_cache_invalidate(bt_conn_get_dst(conn));
     }
+    else if (conn_data != NULL)
+    {
+        conn_data->service_changed_ccc_handle = params->ccc_handle;
+    }
+
+    k_sem_give(&ble_char_discovery_sem);
 }
 
 /**
- * @brief Wrapper function to read a characteristic value of a connected devices that
- *        corresponds to the @param: conn.
- *        The caracteristic to be read is referenced by an index (see TEMPERATURE_CHAR_INDEX)
+ * @brief Callback of a measurement record read. A complete record stores every
+ *        measurement of the node at once and ends the read sequence. If the read
+ *        fails, the characteristics are read one by one instead (read multiple or
+ *        single reads)
  *
  * @param conn Connection handle
- * @param char_select Takes values like: TEMPERATURE_CHAR_INDEX
+ * @param slot Read slot of the connection
+ * @param slot_index Index of the slot (same as the bluetooth_devices index)
+ * @param err
+ * @param data
+ * @param length
+ * @return uint8_t
  */
-void read_characteristic_wrapper(struct bt_conn *conn, uint8_t char_select)
+static uint8_t read_measurement_record_cb(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index,
+                                          uint8_t err, const void *data, uint16_t length)
 {
-    uint16_t characteristic_handle;
+    int ret;
+    ble_connection_data_t *conn_data;
 
-    // fetch the ble_connection_data bluetooth_devices that corresponds to the
-    // given connection handle
+    // The stack is done with the read parameters of this slot
+    slot->is_record_read = false;
+    slot->is_read_in_flight = false;
+
+    if (!err && data != NULL && length >= sizeof(measurement_record_t) &&
+        ((const measurement_record_t *)data)->version == MEASUREMENT_RECORD_VERSION)
+    {
+        ble_link_stats_record_read_latency(conn, READ_LATENCY_KIND_RECORD, get_read_latency(slot));
+        store_measurement_record(conn, data);
+        slot->sequence_bytes += length;
+        finish_read_sequence(slot, slot_index, 0);
+        return BT_GATT_ITER_STOP;
+    }
+
+    LOG_INF("Read measurement record failed (err %d), fall back to characteristic reads", err);
+    if (err)
+    {
+        invalidate_cached_value_handles(conn, err);
+    }
+    else
+    {
+        // Record of another version, do not read it again on this connection
+        conn_data = get_device_by_conn_handle(conn);
+        if (conn_data != NULL)
+        {
+            conn_data->measurement_record_value_handle = 0;
+        }
+    }
+
+    ret = read_slot_all_characteristics(conn, slot);
+    if (ret)
+    {
+        finish_read_sequence(slot, slot_index, ret);
+    }
+
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * @brief Function that requests the measurement record of a connected device, every
+ *        measurement of a single sampling pass of the node in one read
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @return 0 on success, error code otherwise (e.g. the node has no measurement record)
+ */
+static int read_slot_measurement_record(struct bt_conn *conn, read_slot_t *slot)
+{
+    int err;
     ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
 
-    // if nothing fetched (invalid connection handle), get_device_by_conn_handle()
-    // will return null
     if (conn_data == NULL)
     {
         LOG_INF("Invalid connection handle");
-        return;
+        return -ENOTCONN;
     }
 
-    // Select one of the available characteristics of the selected connected device
-    // TODO: This switch will get bigger as more characteristics are added to the measurement service
-    switch (char_select)
+    if (conn_data->measurement_record_value_handle == 0)
     {
-    // --- measurement service
-    case TEMPERATURE_CHAR_INDEX:
-        characteristic_handle = conn_data->temperature_value_handle;
-        break;
-    case HUMIDITY_CHAR_INDEX:
-        characteristic_handle = conn_data->humidity_value_handle;
-        break;
-    case SOIL_MOISTURE_CHAR_INDEX:
-        characteristic_handle = conn_data->soil_moisture_value_handle;
-        break;
-    case LIGHT_INTENSITY_CHAR_INDEX:
-        characteristic_handle = conn_data->light_intensity_value_handle;
-        break;
-    // --- configure service
-    case CONFIGURATION_CHAR_INDEX:
-        characteristic_handle = conn_data->configuration_value_handle;
-        break;
-    case BATTERY_CHAR_INDEX:
-        characteristic_handle = conn_data->battery_value_handle;
-        break;
-    default:
-        // --- Add debug info
-        LOG_INF("Invalid characteristic selection: %d", char_select);
-        return;
+        return -ENOENT;
     }
+
     // --- Construct the read parameters
-    read_parameters.handle_count = 1;
-    read_parameters.single.handle = characteristic_handle;
-    read_parameters.func = read_characteristic_cb;
+    slot->read_parameters.handle_count = 1;
+    slot->read_parameters.single.handle = conn_data->measurement_record_value_handle;
+    slot->read_parameters.single.offset = 0;
+    slot->read_parameters.func = read_characteristic_cb;
 
     // Read characteristic request
-    bt_gatt_read(conn, &read_parameters);
-}
\ No newline at end of file
+    slot->is_record_read = true;
+    slot->is_read_in_flight = true;
+    slot->request_cycles = k_cycle_get_32();
+    err = bt_gatt_read(conn, &slot->read_parameters);
+    if (err)
+    {
+        slot->is_record_read = false;
+        slot->is_read_in_flight = false;
+        LOG_INF("Read measurement record request failed (err %d)", err);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Function that requests the values of all characteristics of the characteristic
+ *        map of a connected device. When CONFIG_BT_GATT_READ_MULT_VAR_LEN is enabled,
+ *        all values are requested with a single ATT Read Multiple Variable request,
+ *        otherwise (or if the peer rejected it) they are read one by one
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @return 0 on success, error code otherwise
+ */
+static int read_slot_all_characteristics(struct bt_conn *conn, read_slot_t *slot)
+{
+    int err;
+
+    slot->retries_left = CHARACTERISTIC_READ_RETRY_BUDGET;
+#if defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+    // Read the whole sensor record in one round trip. If the peer rejected the
+    // request before (or it cannot be sent), fall back to per-handle reads
+    err = read_slot_multiple_characteristics(conn, slot);
+    if (err)
+    {
+        err = read_slot_characteristic(conn, slot, 0);
+    }
+#else
+    err = read_slot_characteristic(conn, slot, 0);
+#endif
+
+    return err;
+}
+
+#if defined(CONFIG_BT_GATT_READ_MULT_VAR_LEN)
+/**
+ * @brief Callback of an ATT Read Multiple Variable request. The stack calls it
+ *        once for every value of the response (in the order of the requested
+ *        handles) and once more with data == NULL when the response is done.
+ *        Values that did not fit in the response (truncated by the ATT MTU) and
+ *        every value of a peer that rejects the request, are read one by one
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @param slot_index Index of the slot (same as the bluetooth_devices index)
+ * @param err
+ * @param data
+ * @param length
+ * @return uint8_t
+ */
+static uint8_t read_multiple_characteristics_cb(struct bt_conn *conn, read_slot_t *slot, uint8_t slot_index,
+                                                uint8_t err, const void *data, uint16_t length)
+{
+    int ret;
+    ble_connection_data_t *conn_data;
+
+    if (!err && data != NULL)
+    {
+        // Store the value only if it arrived complete. After a truncated value
+        // nothing else fits in the response
+        if (!slot->is_multiple_read_truncated && slot->char_index < CHARACTERISTIC_MAP_SIZE &&
+            length >= get_characteristic_value_length(slot->char_index))
+        {
+            store_characteristic_value(conn, slot->char_index, data);
+            slot->sequence_bytes += length;
+            slot->char_index++;
+        }
+        else
+        {
+            slot->is_multiple_read_truncated = true;
+        }
+
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    // Response is done, the stack is done with the read parameters of this slot
+    slot->is_multiple_read = false;
+    slot->is_read_in_flight = false;
+
+    if (!err)
+    {
+        ble_link_stats_record_read_latency(conn, READ_LATENCY_KIND_MULTIPLE, get_read_latency(slot));
+    }
+    else
+    {
+        LOG_INF("Read multiple failed (err %d), fall back to single reads", err);
+        // Peer does not support the request, do not try it again on this connection
+        conn_data = get_device_by_conn_handle(conn);
+        if (err == BT_ATT_ERR_NOT_SUPPORTED && conn_data != NULL)
+        {
+            conn_data->is_read_multiple_rejected = true;
+        }
+        else
+        {
+            invalidate_cached_value_handles(conn, err);
+        }
+        slot->char_index = 0;
+    }
+
+    if (slot->char_index >= CHARACTERISTIC_MAP_SIZE)
+    {
+        finish_read_sequence(slot, slot_index, 0);
+        return BT_GATT_ITER_STOP;
+    }
+
+    // Read the values that are still missing one by one
+    ret = read_slot_characteristic(conn, slot, slot->char_index);
+    if (ret)
+    {
+        finish_read_sequence(slot, slot_index, ret);
+    }
+
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * @brief Function that requests the values of all characteristics of a connected
+ *        device with a single ATT Read Multiple Variable request
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @return 0 on success, error code otherwise
+ */
+static int read_slot_multiple_characteristics(struct bt_conn *conn, read_slot_t *slot)
+{
+    int err;
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    if (conn_data->is_read_multiple_rejected)
+    {
+        return -ENOTSUP;
+    }
+
+    // The values are returned in the order of the handles, so the handles are
+    // placed by characteristic index
+    for (uint8_t char_index = 0; char_index < CHARACTERISTIC_MAP_SIZE; char_index++)
+    {
+        slot->handles[char_index] = get_characteristic_value_handle(conn_data, char_index);
+        if (slot->handles[char_index] == 0)
+        {
+            return -EINVAL;
+        }
+    }
+
+    // --- Construct the read parameters
+    slot->char_index = 0;
+    slot->is_multiple_read_truncated = false;
+    slot->read_parameters.handle_count = CHARACTERISTIC_MAP_SIZE;
+    slot->read_parameters.multiple.handles = slot->handles;
+    slot->read_parameters.multiple.variable = true;
+    slot->read_parameters.func = read_characteristic_cb;
+
+    // Read multiple variable request
+    slot->is_multiple_read = true;
+    slot->is_read_in_flight = true;
+    slot->request_cycles = k_cycle_get_32();
+    err = bt_gatt_read(conn, &slot->read_parameters);
+    if (err)
+    {
+        slot->is_multiple_read = false;
+        slot->is_read_in_flight = false;
+        LOG_INF("Read multiple request failed (err %d)", err);
+    }
+
+    return err;
+}
+#endif // CONFIG_BT_GATT_READ_MULT_VAR_LEN
+
+#ifdef MEASUREMENTS_PUSH_MODE
+/**
+ * @brief Callback function that is called when a sensor node notifies a measurement
+ *        characteristic. The value goes straight to the measurements data storage
+ *
+ * @param conn
+ * @param params
+ * @param data NULL when the subscription is removed (e.g. after disconnection)
+ * @param length
+ * @return uint8_t
+ */
+static uint8_t measurement_notify_cb(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+                                     const void *data, uint16_t length)
+{
+    // The position of params on subscribe_params gives the characteristic index
+    uint8_t char_index = (params - &subscribe_params[0][0]) % MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT;
+
+    if (data == NULL)
+    {
+        LOG_INF("Unsubscribed from characteristic: %d", char_index);
+        params->value_handle = 0U;
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (length >= get_characteristic_value_length(char_index))
+    {
+        store_characteristic_value(conn, char_index, data);
+    }
+
+    return BT_GATT_ITER_CONTINUE;
+}
+#endif // MEASUREMENTS_PUSH_MODE
+
+/**
+ * @brief Function that stores a characteristic value, read from a sensor node,
+ *        on the measurements data storage
+ *
+ * @param conn Connection handle
+ * @param char_index Takes values like: TEMPERATURE_CHAR_INDEX
+ * @param data Value as received from the sensor node
+ */
+static void store_characteristic_value(struct bt_conn *conn, uint8_t char_index, const void *data)
+{
+    // Measurements are sent as the fields of measurement_values_t. Values of a read
+    // multiple response are not aligned
+    uint16_t measurement_data = sys_get_le16(data);
+
+    switch (char_index)
+    {
+    case TEMPERATURE_CHAR_INDEX:
+        // Store measured temperature on measurement_data
+        set_temperature_measurement_value(conn, (int16_t)measurement_data);
+        break;
+    case HUMIDITY_CHAR_INDEX:
+        set_humidity_measurement_value(conn, measurement_data);
+        break;
+    case SOIL_MOISTURE_CHAR_INDEX:
+        set_soil_moisture_measurement_value(conn, measurement_data);
+        break;
+    case LIGHT_INTENSITY_CHAR_INDEX:
+        set_light_intensity_measurement_value(conn, measurement_data);
+        break;
+    case CONFIGURATION_CHAR_INDEX:
+        // Configuration id is sent as a single byte
+        set_configuration_id_value(conn, *(const uint8_t *)data);
+        break;
+    case BATTERY_CHAR_INDEX:
+        // Battery level is sent as a 32 bit integer
+        set_battery_level_value(conn, (uint8_t)sys_get_le32(data));
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Function that stores every measurement of a measurement record, read from
+ *        a sensor node, on the measurements data storage
+ *
+ * @param conn Connection handle
+ * @param data Record as received from the sensor node (not aligned)
+ */
+static void store_measurement_record(struct bt_conn *conn, const void *data)
+{
+    measurement_record_t record;
+
+    memcpy(&record, data, sizeof(record));
+    set_temperature_measurement_value(conn, (int16_t)sys_le16_to_cpu(record.values.temperature));
+    set_humidity_measurement_value(conn, sys_le16_to_cpu(record.values.humidity));
+    set_soil_moisture_measurement_value(conn, sys_le16_to_cpu(record.values.soil_moisture));
+    set_light_intensity_measurement_value(conn, sys_le16_to_cpu(record.values.light_intensity));
+    set_configuration_id_value(conn, record.row_id);
+    set_battery_level_value(conn, record.battery_level);
+    set_sampling_epoch_value(conn, sys_le16_to_cpu(record.epoch));
+}
+
+/**
+ * @brief Function that returns the size of a characteristic value as sent by the
+ *        sensor node
+ *
+ * @param char_index Takes values like: TEMPERATURE_CHAR_INDEX
+ * @return uint16_t size of the value in bytes
+ */
+static uint16_t get_characteristic_value_length(uint8_t char_index)
+{
+    switch (char_index)
+    {
+    case CONFIGURATION_CHAR_INDEX:
+        return sizeof(uint8_t);
+    case BATTERY_CHAR_INDEX:
+        return sizeof(int32_t);
+    default:
+        // Measurements are sent as the fields of measurement_values_t
+        return sizeof(uint16_t);
+    }
+}
+
+/**
+ * @brief Function that returns the value handle of a characteristic of a connected device
+ *
+ * @param conn_data Connection data of the device
+ * @param char_select Takes values like: TEMPERATURE_CHAR_INDEX
+ * @return uint16_t value handle, 0 if the characteristic selection is invalid
+ */
+static uint16_t get_characteristic_value_handle(const ble_connection_data_t *conn_data, uint8_t char_select)
+{
+    // Select one of the available characteristics of the selected connected device
+    // TODO: This switch will get bigger as more characteristics are added to the measurement service
+    switch (char_select)
+    {
+    // --- measurement service
+    case TEMPERATURE_CHAR_INDEX:
+        return conn_data->temperature_value_handle;
+    case HUMIDITY_CHAR_INDEX:
+        return conn_data->humidity_value_handle;
+    case SOIL_MOISTURE_CHAR_INDEX:
+        return conn_data->soil_moisture_value_handle;
+    case LIGHT_INTENSITY_CHAR_INDEX:
+        return conn_data->light_intensity_value_handle;
+    // --- configure service
+    case CONFIGURATION_CHAR_INDEX:
+        return conn_data->configuration_value_handle;
+    case BATTERY_CHAR_INDEX:
+        return conn_data->battery_value_handle;
+    default:
+        // --- Add debug info
+        LOG_INF("Invalid characteristic selection: %d", char_select);
+        return 0;
+    }
+}
+
+/**
+ * @brief Function that requests the read of a characteristic using the read
+ *        parameters of the given connection slot
+ *
+ * @param conn Connection handle
+ * @param slot Read slot of the connection
+ * @param char_select Takes values like: TEMPERATURE_CHAR_INDEX
+ * @return 0 on success, error code otherwise
+ */
+static int read_slot_characteristic(struct bt_conn *conn, read_slot_t *slot, uint8_t char_select)
+{
+    int err;
+    uint16_t characteristic_handle;
+
+    // fetch the ble_connection_data bluetooth_devices that corresponds to the
+    // given connection handle
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    // if nothing fetched (invalid connection handle), get_device_by_conn_handle()
+    // will return null
+    if (conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    characteristic_handle = get_characteristic_value_handle(conn_data, char_select);
+    if (characteristic_handle == 0)
+    {
+        return -EINVAL;
+    }
+
+    // --- Construct the read parameters
+    slot->char_index = char_select;
+    slot->read_parameters.handle_count = 1;
+    slot->read_parameters.single.handle = characteristic_handle;
+    slot->read_parameters.single.offset = 0;
+    slot->read_parameters.func = read_characteristic_cb;
+
+    // Read characteristic request
+    slot->is_read_in_flight = true;
+    slot->request_cycles = k_cycle_get_32();
+    err = bt_gatt_read(conn, &slot->read_parameters);
+    if (err)
+    {
+        slot->is_read_in_flight = false;
+        LOG_INF("Read request failed (err %d)", err);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Function that stores the handle value of the discovered characteristic
+ *        on the corresponding bluetooth_device
+ *
+ * @param conn
+ * @param value_handle
+ * @param characteristic
+ */
+static void store_value_handle(struct bt_conn *conn, uint16_t value_handle, uint8_t characteristic)
+{
+    ble_connection_data_t *conn_data;
+    conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return;
+    }
+
+    switch (characteristic)
+    {
+    case TEMPERATURE_CHAR_INDEX:
+        conn_data->temperature_value_handle = value_handle;
+        break;
+    case HUMIDITY_CHAR_INDEX:
+        conn_data->humidity_value_handle = value_handle;
+        break;
+    case SOIL_MOISTURE_CHAR_INDEX:
+        conn_data->soil_moisture_value_handle = value_handle;
+        break;
+    case LIGHT_INTENSITY_CHAR_INDEX:
+        conn_data->light_intensity_value_handle = value_handle;
+        break;
+    case CONFIGURATION_CHAR_INDEX:
+        conn_data->configuration_value_handle = value_handle;
+        break;
+    case BATTERY_CHAR_INDEX:
+        conn_data->battery_value_handle = value_handle;
+        break;
+    default:
+        LOG_INF("Invalid characteristic value: %d", characteristic);
+        break;
+    }
+}
+
+// --- function definitions ----------------------------------------------------
+/**
+ * @brief Function that constructs discovery params, selects a desired service and calls
+ *        characteristic_discovery to discover (and store) the handle values of every
+ *        characteristic of the selected service existing on the connection handle.
+ *        ble_char_discovery_sem is given when the discovery of the service is done
+ *
+ * @param conn Connection handle
+ * @param service_select Service selection index (e.g. see MEASUREMENT_SERVICE_INDEX)
+ */
+void characteristic_discovery_wrapper(struct bt_conn *conn, uint8_t service_select)
+{
+    int err;
+
+    if (service_select >= SERVICE_MAP_SIZE)
+    {
+        // --- Add debug info
+        LOG_INF("Invalid service selection: %d", service_select);
+        return;
+    }
+
+    // --- Discover service parameters
+    discover_params.uuid = service[service_select];
+    discover_params.func = characteristic_discovery;
+    discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+
+    err = bt_gatt_discover(conn, &discover_params);
+    if (err)
+    {
+        LOG_INF("Discover failed(err %d)", err);
+        return;
+    }
+}
+
+/**
+ * @brief Wrapper function to read a characteristic value of a connected devices that
+ *        corresponds to the @param: conn.
+ *        The caracteristic to be read is referenced by an index (see TEMPERATURE_CHAR_INDEX)
+ *
+ * @param conn Connection handle
+ * @param char_select Takes values like: TEMPERATURE_CHAR_INDEX
+ */
+void read_characteristic_wrapper(struct bt_conn *conn, uint8_t char_select)
+{
+    int slot_index = get_device_index_by_conn_handle(conn);
+
+    if (slot_index < 0)
+    {
+        LOG_INF("Invalid connection handle");
+        return;
+    }
+
+    // A read of this connection is still handled by the stack
+    if (read_slots[slot_index].is_read_in_flight)
+    {
+        LOG_INF("Read already in progress on slot: %d", slot_index);
+        return;
+    }
+
+    read_slots[slot_index].is_sequence_active = false;
+    read_slot_characteristic(conn, &read_slots[slot_index], char_select);
+}
+
+/**
+ * @brief Wrapper function to read every characteristic (measurement and configure
+ *        service) of the connected device that corresponds to @param: conn.
+ *        Nodes with a measurement record characteristic send all values in a single
+ *        read. Otherwise, when CONFIG_BT_GATT_READ_MULT_VAR_LEN is enabled, all values
+ *        are requested with a single ATT Read Multiple Variable request.
+ *        The function returns right after the first read request. The following
+ *        reads are chained from read_characteristic_cb and the result of the whole
+ *        sequence is reported through set_read_sequence_result(), so sequences
+ *        of different connections run concurrently
+ *
+ * @param conn Connection handle
+ * @return 0 if the sequence started, error code otherwise
+ */
+int read_all_characteristics_wrapper(struct bt_conn *conn)
+{
+    int err;
+    int slot_index = get_device_index_by_conn_handle(conn);
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (slot_index < 0 || conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    // Keep the sampling epochs of the node aligned with the central
+    if (k_uptime_get() - conn_data->time_beacon_time > TIME_BEACON_RESYNC_PERIOD_MS)
+    {
+        write_time_beacon(conn);
+    }
+
+    // A late response of a previous cycle still owns the read parameters, skip
+    // this connection for now
+    if (read_slots[slot_index].is_read_in_flight)
+    {
+        LOG_INF("Read already in progress on slot: %d", slot_index);
+        return -EBUSY;
+    }
+
+    read_slots[slot_index].is_sequence_active = true;
+    read_slots[slot_index].retries_left = CHARACTERISTIC_READ_RETRY_BUDGET;
+    read_slots[slot_index].sequence_err = 0;
+    read_slots[slot_index].sequence_start_time = k_uptime_get();
+    read_slots[slot_index].sequence_bytes = 0;
+    err = read_slot_measurement_record(conn, &read_slots[slot_index]);
+    if (err)
+    {
+        err = read_slot_all_characteristics(conn, &read_slots[slot_index]);
+    }
+    if (err)
+    {
+        read_slots[slot_index].is_sequence_active = false;
+    }
+
+    return err;
+}
+
+#ifdef MEASUREMENTS_PUSH_MODE
+/**
+ * @brief Function that subscribes to the notifications of every measurement service
+ *        characteristic of a connected device. Characteristic discovery must be
+ *        completed before calling it. The sensor node then pushes its measurements
+ *        on its own sampling schedule
+ *
+ * @param conn Connection handle
+ * @return 0 on success, error code of the first subscription that failed otherwise
+ */
+int subscribe_measurement_notifications(struct bt_conn *conn)
+{
+    int err;
+    int slot_index = get_device_index_by_conn_handle(conn);
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+    struct bt_gatt_subscribe_params *params;
+
+    if (slot_index < 0 || conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    // Notifications are stored on the slot of this connection
+    set_measurement_connection_handle(slot_index, conn);
+
+    for (uint8_t char_index = 0; char_index < MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT; char_index++)
+    {
+        params = &subscribe_params[slot_index][char_index];
+
+        memset(params, 0, sizeof(*params));
+        params->notify = measurement_notify_cb;
+        params->value = BT_GATT_CCC_NOTIFY;
+        params->value_handle = get_characteristic_value_handle(conn_data, char_index);
+        // CCC handle is discovered by the stack (CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+        params->ccc_handle = BT_GATT_AUTO_DISCOVER_CCC_HANDLE;
+        params->end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+        params->disc_params = &ccc_discover_params[slot_index][char_index];
+
+        err = bt_gatt_subscribe(conn, params);
+        if (err && err != -EALREADY)
+        {
+            LOG_INF("Subscribe failed (err %d), characteristic: %d", err, char_index);
+            return err;
+        }
+    }
+
+    // Configuration id and battery level are not notified, read the whole
+    // record once so the node is assigned to its row right away
+    return read_all_characteristics_wrapper(conn);
+}
+#endif // MEASUREMENTS_PUSH_MODE
+/**
+ * @brief Function that discovers the Service Changed characteristic of a connected
+ *        device. ble_char_discovery_sem is given when the discovery is done
+ *
+ * @param conn Connection handle
+ */
+void service_changed_discovery_wrapper(struct bt_conn *conn)
+{
+    int err;
+
+    discover_params.uuid = BT_UUID_GATT_SC;
+    discover_params.func = service_changed_discovery;
+    discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    err = bt_gatt_discover(conn, &discover_params);
+    if (err)
+    {
+        LOG_INF("Discover failed(err %d)", err);
+    }
+}
+
+/**
+ * @brief Function that subscribes to the Service Changed indications of a connected
+ *        device. ble_char_discovery_sem is given when the subscription is written
+ *
+ * @param conn Connection handle
+ * @return 0 on success, error code otherwise (e.g. the peer has no Service Changed characteristic)
+ */
+int subscribe_service_changed(struct bt_conn *conn)
+{
+    int err;
+    int slot_index = get_device_index_by_conn_handle(conn);
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+    struct bt_gatt_subscribe_params *params;
+
+    if (slot_index < 0 || conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    if (conn_data->service_changed_value_handle == 0)
+    {
+        return -ENOENT;
+    }
+
+    params = &service_changed_subscribe_params[slot_index];
+    memset(params, 0, sizeof(*params));
+    params->notify = service_changed_indicate_cb;
+    params->subscribe = service_changed_subscribe_cb;
+    params->value = BT_GATT_CCC_INDICATE;
+    params->value_handle = conn_data->service_changed_value_handle;
+    if (conn_data->service_changed_ccc_handle != 0)
+    {
+        params->ccc_handle = conn_data->service_changed_ccc_handle;
+    }
+    else
+    {
+        // CCC handle is discovered by the stack (CONFIG_BT_GATT_AUTO_DISCOVER_CCC)
+        params->ccc_handle = BT_GATT_AUTO_DISCOVER_CCC_HANDLE;
+        params->end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+        params->disc_params = &service_changed_ccc_discover_params[slot_index];
+    }
+
+    err = bt_gatt_subscribe(conn, params);
+    if (err)
+    {
+        LOG_INF("Service changed subscribe failed (err %d)", err);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Function that fills the value handles of a connected device from the
+ *        handle cache
+ *
+ * @param conn Connection handle
+ * @return true if the device was cached and characteristic discovery can be skipped
+ */
+bool restore_cached_value_handles(struct bt_conn *conn)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        return false;
+    }
+
+    return ble_handle_cache_restore(bt_conn_get_dst(conn), conn_data);
+}
+
+/**
+ * @brief Function that stores the discovered value handles of a connected device
+ *        in the handle cache. Nothing is stored if a characteristic was not found
+ *
+ * @param conn Connection handle
+ */
+void save_value_handles_in_cache(struct bt_conn *conn)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        return;
+    }
+
+    for (uint8_t char_index = 0; char_index < CHARACTERISTIC_MAP_SIZE; char_index++)
+    {
+        if (get_characteristic_value_handle(conn_data, char_index) == 0)
+        {
+            LOG_INF("Characteristic %d not discovered, not cached", char_index);
+            return;
+        }
+    }
+
+    ble_handle_cache_save(bt_conn_get_dst(conn), conn_data);
+}
+
+/**
+ * @brief Function that writes the time base of the central (current sampling epoch)
+ *        to the time beacon characteristic of a connected device. The node then
+ *        samples its sensors at the start of every epoch, and tags its measurement
+ *        record with the epoch
+ *
+ * @param conn Connection handle
+ * @return 0 on success, error code otherwise (e.g. the node has no time beacon)
+ */
+int write_time_beacon(struct bt_conn *conn)
+{
+    int err;
+    time_beacon_t beacon;
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        LOG_INF("Invalid connection handle");
+        return -ENOTCONN;
+    }
+
+    if (conn_data->time_beacon_value_handle == 0)
+    {
+        return -ENOENT;
+    }
+
+    beacon.epoch = sys_cpu_to_le16(get_sampling_epoch());
+    beacon.epoch_time = sys_cpu_to_le32(get_sampling_epoch_time());
+    beacon.epoch_period = sys_cpu_to_le16(MEASUREMENT_PERIOD_IN_SEC);
+
+    // Write without response, it goes out on the next connection event
+    err = bt_gatt_write_without_response(conn, conn_data->time_beacon_value_handle, &beacon, sizeof(beacon), false);
+    if (err)
+    {
+        LOG_INF("Time beacon write failed (err %d)", err);
+        return err;
+    }
+
+    conn_data->time_beacon_time = k_uptime_get();
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 // --- includes ----------------------------------------------------------------
 #include <stdint.h>
+#include <stdbool.h>
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
@@ -39,7 +40,16 @@
 // --- CONFIGURATION SERVICE INFO ---
 
 // --- functions declarations --------------------------------------------------
-void characteristic_discovery_wrapper(struct bt_conn *conn, uint8_t service_select, uint8_t char_select);
+void characteristic_discovery_wrapper(struct bt_conn *conn, uint8_t service_select);
 void read_characteristic_wrapper(struct bt_conn *conn, uint8_t char_select);
+int read_all_characteristics_wrapper(struct bt_conn *conn);
+void service_changed_discovery_wrapper(struct bt_conn *conn);
+int subscribe_service_changed(struct bt_conn *conn);
+bool restore_cached_value_handles(struct bt_conn *conn);
+void save_value_handles_in_cache(struct bt_conn *conn);
+int write_time_beacon(struct bt_conn *conn);
+#ifdef MEASUREMENTS_PUSH_MODE
+int subscribe_measurement_notifications(struct bt_conn *conn);
+#endif
 
 #endif // BLE_CHARACTERISTIC_CONTROL_H
@@ -10,8 +10,13 @@
 #include "ble_conn_control.h"
 #include "ble_characteristic_control.h"
 #include "ble_fsm.h"
+#include "ble_node_registry.h"
+#include "ble_link_stats.h"
 #include "common.h"
 #include "measurements/measurements_fsm.h"
+#ifdef BLE_ADV_TELEMETRY_MODE
+#include "measurements/measurements_data_storage.h"
+#endif
 
 #include <zephyr/kernel.h>
 #include <zephyr/types.h>
@@ -25,30 +30,108 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/sys/byteorder.h>
 
+#if defined(BLE_ADV_TELEMETRY_MODE) && !defined(CONFIG_BT_EXT_ADV)
+#error "BLE_ADV_TELEMETRY_MODE needs CONFIG_BT_EXT_ADV (see prj.conf)"
+#endif
+
 // --- defines -----------------------------------------------------------------
 // TODO: 600 might be causing an issue where the central node is informed about
 // a disconnection late
 #define BT_CONNECTION_PARAMETERS BT_LE_CONN_PARAM(0x40, 0x55, 4, 600)
+// Used while characteristics are discovered or read: 7.5 to 15 ms interval,
+// no peripheral latency, 4 s supervision timeout
+#define BLE_BURST_CONNECTION_INTERVAL_MIN 6
+#define BLE_BURST_CONNECTION_INTERVAL_MAX 12
+#define BT_BURST_CONNECTION_PARAMETERS BT_LE_CONN_PARAM(BLE_BURST_CONNECTION_INTERVAL_MIN, \
+                                                        BLE_BURST_CONNECTION_INTERVAL_MAX, 0, 400)
+// Used between read cycles: 500 ms interval, the node may skip
+// BLE_IDLE_CONNECTION_LATENCY connection events, 6 s supervision timeout
+#define BT_IDLE_CONNECTION_PARAMETERS BT_LE_CONN_PARAM(BLE_IDLE_CONNECTION_INTERVAL, BLE_IDLE_CONNECTION_INTERVAL, \
+                                                       BLE_IDLE_CONNECTION_LATENCY, 600)
+// A connection parameters update that is rejected (another LL procedure in progress)
+// is requested again after BLE_PROFILE_RETRY_DELAY_MS. No callback is called when an
+// accepted update fails, so it is considered lost after BLE_PROFILE_UPDATE_TIMEOUT_MS
+#define BLE_PROFILE_RETRY_DELAY_MS 1000
+#define BLE_PROFILE_UPDATE_TIMEOUT_MS (4 * BLE_IDLE_CONNECTION_WAKEUP_MS)
+// Time given to a sensor node to answer the ATT MTU exchange
+#define BLE_MTU_EXCHANGE_TIMEOUT_MS 2000
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_DECLARE(ble_m);
 
 // --- static variables definitions --------------------------------------------
-// BLE connection data (contains the ble handle)
+// BLE connection data (contains the ble handle) of the connection being created
 static ble_connection_data_t *ble_connection_data;
+// Sensor nodes found while scanning, waiting to be connected (first in, first out)
+static bt_addr_le_t pending_devices[BLE_PENDING_DEVICES_QUEUE_SIZE];
+static uint8_t pending_devices_count;
+// Pending devices are queued by the bt rx thread and dequeued by the ble fsm
+static K_MUTEX_DEFINE(pending_devices_mutex);
+// Scan parameters given to start_scan(), used to resume scanning after a connection
+static const struct bt_le_scan_param *active_scan_parameters;
+// Links are updated by the ble discovery thread one at a time
+static struct bt_gatt_exchange_params mtu_exchange_params;
+static K_SEM_DEFINE(mtu_exchange_sem, 0, 1);
+// Connection profiles are requested by the ble and measurements threads and requested
+// again by connection_profile_work, one request at a time
+static K_MUTEX_DEFINE(connection_profile_mutex);
+#ifdef BLE_AUTO_RECONNECT
+// Known sensor nodes, whether each of them was added to the Filter Accept List
+// already (the list is only changed by the ble fsm, while auto connect is stopped)
+// and how many reconnect windows in a row each of them missed
+static bt_addr_le_t known_devices[BLE_KNOWN_DEVICES_SIZE];
+static bool is_known_device_listed[BLE_KNOWN_DEVICES_SIZE];
+static uint8_t known_device_misses[BLE_KNOWN_DEVICES_SIZE];
+static uint8_t known_devices_count;
+// Known devices are added by the bt rx thread and listed by the ble fsm
+static K_MUTEX_DEFINE(known_devices_mutex);
+// Set when a known sensor node disconnects, until the ble fsm reconnects it
+static atomic_t auto_reconnect_requested;
+#endif
 
 // --- static functions declarations -------------------------------------------
 static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
                          struct net_buf_simple *ad);
 static bool connectable_device_found(struct bt_data *data, void *user_data);
+#ifdef BLE_ADV_TELEMETRY_MODE
+static bool telemetry_record_found(struct bt_data *data, void *user_data);
+#endif
 static void disconnected(struct bt_conn *conn, uint8_t reason);
 static void connected(struct bt_conn *conn, uint8_t conn_err);
-static void disconnected(struct bt_conn *conn, uint8_t reason);
+static void queue_pending_device(const bt_addr_le_t *addr);
+static bool dequeue_pending_device(bt_addr_le_t *addr);
+#ifdef BLE_AUTO_RECONNECT
+static int find_known_device(const bt_addr_le_t *addr);
+static void update_filter_accept_list(void);
+static void remove_known_device(uint8_t index);
+#endif
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_exchange_params *params);
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout);
+static enum ble_connection_profile_e get_applied_profile(uint16_t interval, uint16_t latency);
+static bool is_profile_update_outstanding(const ble_connection_data_t *conn_data);
+static int request_connection_profile(struct bt_conn *conn, ble_connection_data_t *conn_data);
+static void connection_profile_work_handler(struct k_work *work);
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param);
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info);
+#endif
+
+// Requests the profiles that are not in use once the outstanding updates end
+static K_WORK_DELAYABLE_DEFINE(connection_profile_work, connection_profile_work_handler);
 
 // --- static functions definitions --------------------------------------------
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = connected,
     .disconnected = disconnected,
+    .le_param_updated = le_param_updated,
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    .le_phy_updated = le_phy_updated,
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    .le_data_len_updated = le_data_len_updated,
+#endif
 };
 
 /**
@@ -64,6 +147,20 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
                          struct net_buf_simple *ad)
 {
+#ifdef BLE_ADV_TELEMETRY_MODE
+    // Sensor nodes that only report their measurements advertise them, they are
+    // stored without connecting
+    if (type == BT_GAP_ADV_TYPE_EXT_ADV || type == BT_GAP_ADV_TYPE_ADV_NONCONN_IND)
+    {
+        bt_data_parse(ad, telemetry_record_found, (void *)addr);
+        return;
+    }
+#ifndef BLE_ROTATION_MODE
+    // Measurements are stored per node registry index, connected nodes are only
+    // served together with BLE_ROTATION_MODE
+    return;
+#endif
+#endif
     // Filter devices that we can connect to
     if (type == BT_GAP_ADV_TYPE_ADV_IND ||
         type == BT_GAP_ADV_TYPE_ADV_DIRECT_IND)
@@ -112,7 +209,6 @@ static bool connectable_device_found(struct bt_data *data, void *user_data)
             // probably pass it as an argument to start scan to make module
             // more generic
             uint8_t service_uuid[BT_UUID_SIZE_128] = {MEASUREMENT_SERVICE_UUID};
-            int err;
 
             // Storing the received UUID on a buffer
             memcpy(received_uuid, &data->data[i], BT_UUID_SIZE_128);
@@ -123,24 +219,8 @@ static bool connectable_device_found(struct bt_data *data, void *user_data)
                 continue;
             }
 
-            // TODO: why stop the scan?
-            err = bt_le_scan_stop();
-            if (err)
-            {
-                LOG_INF("Stop LE scan failed (err %d)", err);
-                continue;
-            }
-
-            // Create the connection to the device that supports the desired service
-            // Note: after creating connection successfully, connected callback
-            // will be called
-            err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
-                                    BT_CONNECTION_PARAMETERS, &ble_connection_data->ble_connection_handle);
-            if (err)
-            {
-                LOG_INF("Create conn failed (err %d)", err);
-                k_sem_give(&ble_connect_ok_sem);
-            }
+            // Scanning goes on, the ble fsm connects to the queued devices one after the other
+            queue_pending_device(addr);
 
             return false;
         }
@@ -150,6 +230,45 @@ static bool connectable_device_found(struct bt_data *data, void *user_data)
     return true;
 }
 
+#ifdef BLE_ADV_TELEMETRY_MODE
+/**
+ * @brief After finding a non connectable device, check if it advertises a
+ *        measurement record (connectionless telemetry) and store it
+ * 
+ * @param data 
+ * @param user_data 
+ * @return true to continue parsing the advertising data
+ * @return false if the record was found
+ */
+static bool telemetry_record_found(struct bt_data *data, void *user_data)
+{
+    bt_addr_le_t *addr = user_data;
+    telemetry_adv_record_t record;
+    uint16_t node_index;
+
+    if (data->type != BT_DATA_MANUFACTURER_DATA || data->data_len != sizeof(telemetry_adv_record_t))
+    {
+        return true;
+    }
+
+    memcpy(&record, data->data, sizeof(record));
+    if (sys_le16_to_cpu(record.company_id) != TELEMETRY_ADV_COMPANY_ID ||
+        record.measurement.version != MEASUREMENT_RECORD_VERSION)
+    {
+        return true;
+    }
+
+    ble_node_registry_add(addr, false, &node_index);
+    // A new record counts as a service of the node (for the sampling period metric)
+    if (set_advertised_measurements(node_index, addr, &record.measurement))
+    {
+        ble_node_registry_set_served(node_index, true);
+    }
+
+    return false;
+}
+#endif // BLE_ADV_TELEMETRY_MODE
+
 /**
  * @brief Callback function that is called when a connection is established
  * 
@@ -158,24 +277,41 @@ static bool connectable_device_found(struct bt_data *data, void *user_data)
  */
 static void connected(struct bt_conn *conn, uint8_t conn_err)
 {
-    char addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    struct bt_conn_info info;
 
     if (conn_err)
     {
         LOG_WRN("Connection failed: %d", conn_err);
 
-        bt_conn_unref(conn);
+        // Connections created by the controller (auto connect) are not referenced yet
+        if (ble_connection_data->ble_connection_handle == conn)
+        {
+            bt_conn_unref(conn);
+        }
         conn = NULL;
+        ble_connection_data->ble_connection_handle = NULL;
 
         k_sem_give(&ble_connect_ok_sem);
         return;
     }
+#ifdef BLE_AUTO_RECONNECT
+    // Known nodes reconnected by the controller, keep a reference like bt_conn_le_create() does
+    if (ble_connection_data->ble_connection_handle == NULL)
+    {
+        ble_connection_data->ble_connection_handle = bt_conn_ref(conn);
+        LOG_INF("Known device reconnected");
+    }
+#endif
+    // Map the connection to its device so that later lookups are constant-time
+    set_device_conn_index(conn, ble_connection_data);
+    // Radio duty cycle is estimated from the connection parameters in use
+    if (bt_conn_get_info(conn, &info) == 0)
+    {
+        set_connection_parameters(ble_connection_data, info.le.interval, info.le.latency);
+    }
     // Set connected flag to true after connection is established
     ble_connection_data->is_connected = true;
-    // Store mac address of device
-    memcpy(ble_connection_data->mac_address, addr, sizeof(char) * MAC_ADDRESS_LENGTH);
+    ble_link_stats_connected(conn);
 
     k_sem_give(&ble_connect_ok_sem);
     k_sem_give(&at_least_one_active_connection_sem);
@@ -192,50 +328,478 @@ static void connected(struct bt_conn *conn, uint8_t conn_err)
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
     // --- logging ---
-    char addr[BT_ADDR_LE_STR_LEN];
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
     LOG_INF("BLE disconnected, reason: %d",reason);
+    ble_link_stats_disconnected(conn, reason);
 
+#ifdef BLE_ROTATION_MODE
+    // A node that disconnects before it is served can be scheduled again
+    ble_node_registry_set_served(get_node_index_by_conn_handle(conn), false);
+#endif
+#ifdef BLE_AUTO_RECONNECT
+    // Known nodes are reconnected by the controller, without scanning for them
+    k_mutex_lock(&known_devices_mutex, K_FOREVER);
+    if (find_known_device(bt_conn_get_dst(conn)) >= 0)
+    {
+        atomic_set(&auto_reconnect_requested, true);
+    }
+    k_mutex_unlock(&known_devices_mutex);
+#endif
     // --- remove connection ---
     remove_connection_data(conn);
     k_sem_give(&ble_wait_for_disconnect_sem);
     k_sem_take(&at_least_one_active_connection_sem, K_NO_WAIT);
 }
 
-// --- function definitions ----------------------------------------------------
 /**
- * @brief Function to start searching for ble devices to connect
- *        Fetches an available device from static ble_connection_data_t bluetooth_devices
+ * @brief Callback function that is called when the ATT MTU exchange is done
  * 
- * @param scan_parameters Scan parameters
- * @return ble_connection_data_t* 
+ * @param conn Connection handle
+ * @param err 0 on success, ATT error otherwise (the default MTU is kept then)
+ * @param params 
+ */
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_exchange_params *params)
+{
+    if (err)
+    {
+        LOG_INF("MTU exchange failed (err %d)", err);
+    }
+
+    k_sem_give(&mtu_exchange_sem);
+}
+
+/**
+ * @brief Callback function that is called when the connection parameters of a
+ *        connection change (see set_connection_profile())
+ * 
+ * @param conn Connection handle
+ * @param interval New connection interval (1.25 ms units)
+ * @param latency New peripheral latency
+ * @param timeout New supervision timeout (10 ms units)
+ */
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data != NULL)
+    {
+        set_connection_parameters(conn_data, interval, latency);
+        conn_data->applied_profile = get_applied_profile(interval, latency);
+        conn_data->is_profile_update_pending = false;
+        // A profile requested while this update was outstanding is requested now
+        if (conn_data->requested_profile != BLE_DEFAULT_PROFILE &&
+            conn_data->applied_profile != conn_data->requested_profile)
+        {
+            k_work_reschedule(&connection_profile_work, K_NO_WAIT);
+        }
+    }
+}
+
+/**
+ * @brief Get the connection parameters profile that matches the parameters of a connection
+ * 
+ * @param interval Connection interval (1.25 ms units)
+ * @param latency Peripheral latency
+ * @return Profile in use, BLE_DEFAULT_PROFILE if the parameters match no profile
  */
-ble_connection_data_t *start_scan(const struct bt_le_scan_param *scan_parameters)
+static enum ble_connection_profile_e get_applied_profile(uint16_t interval, uint16_t latency)
+{
+    if (interval >= BLE_BURST_CONNECTION_INTERVAL_MIN && interval <= BLE_BURST_CONNECTION_INTERVAL_MAX &&
+        latency == 0)
+    {
+        return BLE_BURST_PROFILE;
+    }
+    if (interval == BLE_IDLE_CONNECTION_INTERVAL && latency == BLE_IDLE_CONNECTION_LATENCY)
+    {
+        return BLE_IDLE_PROFILE;
+    }
+
+    return BLE_DEFAULT_PROFILE;
+}
+
+/**
+ * @brief Check whether a connection parameters update of a connection is still in
+ *        progress (accepted and neither completed nor timed out)
+ * 
+ * @param conn_data Connection data of the device
+ * @return true if the update is in progress
+ */
+static bool is_profile_update_outstanding(const ble_connection_data_t *conn_data)
+{
+    return conn_data->is_profile_update_pending &&
+           (k_uptime_get() - conn_data->profile_update_time) < BLE_PROFILE_UPDATE_TIMEOUT_MS;
+}
+
+/**
+ * @brief Request the profile set on the connection data of a connection. A rejected
+ *        request is retried by connection_profile_work. Called with
+ *        connection_profile_mutex taken
+ * 
+ * @param conn Connection handle
+ * @param conn_data Connection data of the device
+ * @return 0 on success (or if the profile is in use already), error code otherwise
+ */
+static int request_connection_profile(struct bt_conn *conn, ble_connection_data_t *conn_data)
 {
     int err;
 
-    // Fetch an available device from static ble_connection_data_t bluetooth_devices
-    ble_connection_data = get_empty_ble_handle();
+    err = bt_conn_le_param_update(conn, (conn_data->requested_profile == BLE_BURST_PROFILE) ?
+                                            BT_BURST_CONNECTION_PARAMETERS :
+                                            BT_IDLE_CONNECTION_PARAMETERS);
+    if (err == -EALREADY)
+    {
+        conn_data->applied_profile = conn_data->requested_profile;
+        conn_data->is_profile_update_pending = false;
+        return 0;
+    }
+    if (err)
+    {
+        LOG_INF("Connection parameters update failed (err %d), retrying", err);
+        conn_data->is_profile_update_pending = false;
+        k_work_schedule(&connection_profile_work, K_MSEC(BLE_PROFILE_RETRY_DELAY_MS));
+        return err;
+    }
+
+    conn_data->profile_update_time = k_uptime_get();
+    conn_data->is_profile_update_pending = true;
+    // Checked again if the update is lost
+    k_work_schedule(&connection_profile_work, K_MSEC(BLE_PROFILE_UPDATE_TIMEOUT_MS));
+
+    return 0;
+}
+
+/**
+ * @brief Work handler that requests the profile of every connection whose requested
+ *        profile is not in use and that has no update in progress
+ * 
+ * @param work Work item
+ */
+static void connection_profile_work_handler(struct k_work *work)
+{
+    ble_connection_data_t *conn_data;
+    struct bt_conn *conn;
+
+    k_mutex_lock(&connection_profile_mutex, K_FOREVER);
+    for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        conn = get_ble_conn_handles(index);
+        conn_data = get_device_by_conn_handle(conn);
+        if (conn_data == NULL || !conn_data->is_connected ||
+            conn_data->requested_profile == BLE_DEFAULT_PROFILE ||
+            conn_data->applied_profile == conn_data->requested_profile)
+        {
+            continue;
+        }
+
+        if (is_profile_update_outstanding(conn_data))
+        {
+            k_work_schedule(&connection_profile_work, K_MSEC(BLE_PROFILE_UPDATE_TIMEOUT_MS));
+            continue;
+        }
+        request_connection_profile(conn, conn_data);
+    }
+    k_mutex_unlock(&connection_profile_mutex);
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+/**
+ * @brief Callback function that is called when the PHY of a connection changes
+ * 
+ * @param conn Connection handle
+ * @param param New PHY of the connection
+ */
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data != NULL)
+    {
+        conn_data->tx_phy = param->tx_phy;
+    }
+}
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+/**
+ * @brief Callback function that is called when the data length of a connection changes
+ * 
+ * @param conn Connection handle
+ * @param info New data length of the connection
+ */
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data != NULL)
+    {
+        conn_data->tx_data_length = info->tx_max_len;
+    }
+}
+#endif
+
+/**
+ * @brief Queue a sensor node that supports the desired service, to be connected
+ *        by the ble fsm. A device already queued or already connected is skipped,
+ *        as well as every device found while the queue is full
+ * 
+ * @param addr Address of the sensor node
+ */
+static void queue_pending_device(const bt_addr_le_t *addr)
+{
+    struct bt_conn *conn;
+
+    // Already connected (or being connected)
+    conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+    if (conn != NULL)
+    {
+        bt_conn_unref(conn);
+        return;
+    }
+
+#ifdef BLE_ROTATION_MODE
+    // In rotation mode nodes are scheduled from the node registry instead
+    if (ble_node_registry_add(addr, true, NULL))
+    {
+        k_sem_give(&ble_pending_device_sem);
+    }
+    return;
+#endif
+
+    k_mutex_lock(&pending_devices_mutex, K_FOREVER);
+    for (uint8_t index = 0; index < pending_devices_count; index++)
+    {
+        if (!bt_addr_le_cmp(&pending_devices[index], addr))
+        {
+            k_mutex_unlock(&pending_devices_mutex);
+            return;
+        }
+    }
+
+    if (pending_devices_count < BLE_PENDING_DEVICES_QUEUE_SIZE)
+    {
+        bt_addr_le_copy(&pending_devices[pending_devices_count], addr);
+        pending_devices_count++;
+        k_sem_give(&ble_pending_device_sem);
+    }
+    k_mutex_unlock(&pending_devices_mutex);
+}
+
+/**
+ * @brief Take the oldest queued sensor node out of the pending devices queue
+ * 
+ * @param addr Filled with the address of the sensor node
+ * @return true if a device was dequeued, false if the queue is empty
+ */
+static bool dequeue_pending_device(bt_addr_le_t *addr)
+{
+    bool is_dequeued = false;
+
+    k_mutex_lock(&pending_devices_mutex, K_FOREVER);
+    if (pending_devices_count > 0)
+    {
+        bt_addr_le_copy(addr, &pending_devices[0]);
+        pending_devices_count--;
+        memmove(&pending_devices[0], &pending_devices[1], pending_devices_count * sizeof(bt_addr_le_t));
+        is_dequeued = true;
+    }
+    k_mutex_unlock(&pending_devices_mutex);
+
+    return is_dequeued;
+}
+
+#ifdef BLE_AUTO_RECONNECT
+/**
+ * @brief Find a sensor node on the known devices. Must be called with
+ *        known_devices_mutex locked
+ * 
+ * @param addr Address of the sensor node
+ * @return index of the node on known_devices, -1 if it is not known
+ */
+static int find_known_device(const bt_addr_le_t *addr)
+{
+    for (int index = 0; index < known_devices_count; index++)
+    {
+        if (!bt_addr_le_cmp(&known_devices[index], addr))
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Add the known sensor nodes that are not listed yet to the controller
+ *        Filter Accept List. Must be called while auto connect is stopped
+ * 
+ */
+static void update_filter_accept_list(void)
+{
+    int err;
+
+    k_mutex_lock(&known_devices_mutex, K_FOREVER);
+    for (uint8_t index = 0; index < known_devices_count; index++)
+    {
+        if (is_known_device_listed[index])
+        {
+            continue;
+        }
+
+        err = bt_le_filter_accept_list_add(&known_devices[index]);
+        if (err)
+        {
+            LOG_INF("Filter Accept List add failed (err %d)", err);
+            continue;
+        }
+        is_known_device_listed[index] = true;
+    }
+    k_mutex_unlock(&known_devices_mutex);
+}
+
+/**
+ * @brief Remove a sensor node from the known devices and from the controller Filter
+ *        Accept List. The last known device takes its place. Must be called with
+ *        known_devices_mutex locked, while auto connect is stopped
+ * 
+ * @param index Index of the node on known_devices
+ */
+static void remove_known_device(uint8_t index)
+{
+    int err;
+    uint8_t last_index = known_devices_count - 1;
 
-    // If this condition is true, device array is full
-    if (ble_connection_data == NULL)
+    if (is_known_device_listed[index])
     {
-        // Handle NULL return by waiting for a device to disconnect and then start scan again
-        return NULL;
+        err = bt_le_filter_accept_list_remove(&known_devices[index]);
+        if (err)
+        {
+            LOG_INF("Filter Accept List remove failed (err %d)", err);
+        }
     }
 
+    bt_addr_le_copy(&known_devices[index], &known_devices[last_index]);
+    is_known_device_listed[index] = is_known_device_listed[last_index];
+    known_device_misses[index] = known_device_misses[last_index];
+    known_devices_count--;
+}
+#endif // BLE_AUTO_RECONNECT
+
+// --- function definitions ----------------------------------------------------
+/**
+ * @brief Function to start searching for ble devices to connect. Scanning goes
+ *        on in the background: every device that supports the desired service is
+ *        queued (see queue_pending_device()) and ble_pending_device_sem is given
+ * 
+ * @param scan_parameters Scan parameters
+ * @return 0 on success, error code otherwise
+ */
+int start_scan(const struct bt_le_scan_param *scan_parameters)
+{
+    int err;
+
+    active_scan_parameters = scan_parameters;
+
     // Start searching for connectable devices. If a connectable device is found,
     // device_found() cb will be called to check if this device supports the services
     // needed by the central_node
-    // TODO: is bt_le_scan_start until connection? If not, returning ble_connection_data could be problematic
     err = bt_le_scan_start(scan_parameters, device_found);
     if (err)
     {
         LOG_INF("Scanning failed to start (err %d)", err);
-        return NULL;
+        return err;
     }
     LOG_INF("Scan started");
-    return ble_connection_data;
+    return 0;
+}
+
+/**
+ * @brief Function to restart scanning after it was paused to create a connection
+ * 
+ */
+void resume_scan(void)
+{
+    int err;
+
+    if (active_scan_parameters == NULL)
+    {
+        return;
+    }
+
+    err = bt_le_scan_start(active_scan_parameters, device_found);
+    if (err && err != -EALREADY)
+    {
+        LOG_INF("Scanning failed to resume (err %d)", err);
+    }
+}
+
+/**
+ * @brief Function to create a connection to a sensor node.
+ *        Scanning is paused, as the controller can not scan and initiate a
+ *        connection at the same time. ble_connect_ok_sem is given when the
+ *        connection is established or failed; resume_scan() must be called then
+ * 
+ * @param addr Address of the sensor node
+ * @param conn_data Free bluetooth device member (see get_empty_ble_handle())
+ *                  that will store the connection data
+ * @return 0 if the connection is being created, error code otherwise
+ */
+int connect_to_device(const bt_addr_le_t *addr, ble_connection_data_t *conn_data)
+{
+    int err;
+
+    ble_connection_data = conn_data;
+
+    err = bt_le_scan_stop();
+    if (err && err != -EALREADY)
+    {
+        LOG_INF("Stop LE scan failed (err %d)", err);
+    }
+
+    // Create the connection to the device that supports the desired service
+    // Note: after creating connection successfully, connected callback
+    // will be called
+    err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+                            BT_CONNECTION_PARAMETERS, &ble_connection_data->ble_connection_handle);
+    if (err)
+    {
+        LOG_INF("Create conn failed (err %d)", err);
+        resume_scan();
+    }
+
+    return err;
+}
+
+/**
+ * @brief Function to create a connection to the oldest queued sensor node
+ *        (see connect_to_device())
+ * 
+ * @param conn_data Free bluetooth device member (see get_empty_ble_handle())
+ *                  that will store the connection data
+ * @return 0 if the connection is being created, error code otherwise
+ */
+int connect_to_pending_device(ble_connection_data_t *conn_data)
+{
+    bt_addr_le_t addr;
+
+    if (!dequeue_pending_device(&addr))
+    {
+        return -ENOENT;
+    }
+
+    return connect_to_device(&addr, conn_data);
+}
+
+/**
+ * @brief Function to cancel a connection that was not established in time
+ *        The connected callback is then called with an error
+ * 
+ */
+void cancel_pending_connection(void)
+{
+    if (ble_connection_data != NULL && ble_connection_data->ble_connection_handle != NULL &&
+        !ble_connection_data->is_connected)
+    {
+        bt_conn_disconnect(ble_connection_data->ble_connection_handle, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    }
 }
 
 /**
@@ -251,4 +815,262 @@ void bt_ready(int err)
     {
         LOG_INF("Error while enabling bluetooth (err %d)", err);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Function to negotiate a faster link with a connected sensor node: 2M PHY,
+ *        maximum LE data length and a larger ATT MTU. Every step falls back to the
+ *        default (1M PHY, 27 bytes, 23 bytes MTU) if the node or the controller
+ *        does not support it. Called by the ble discovery thread before discovery,
+ *        blocks until the MTU exchange is done
+ * 
+ * @param conn Connection handle
+ * @return 0 if the MTU exchange completed, error code otherwise
+ */
+int update_link_parameters(struct bt_conn *conn)
+{
+    int err;
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if (conn_data == NULL)
+    {
+        return -ENOTCONN;
+    }
+
+    conn_data->tx_phy = BT_GAP_LE_PHY_1M;
+    conn_data->tx_data_length = BT_GAP_DATA_LEN_DEFAULT;
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err)
+    {
+        LOG_INF("PHY update failed (err %d)", err);
+    }
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err)
+    {
+        LOG_INF("Data length update failed (err %d)", err);
+    }
+#endif
+
+    k_sem_reset(&mtu_exchange_sem);
+    mtu_exchange_params.func = mtu_exchange_cb;
+    err = bt_gatt_exchange_mtu(conn, &mtu_exchange_params);
+    if (err)
+    {
+        LOG_INF("MTU exchange failed to start (err %d)", err);
+    }
+    else if (k_sem_take(&mtu_exchange_sem, K_MSEC(BLE_MTU_EXCHANGE_TIMEOUT_MS)) != 0)
+    {
+        err = -ETIMEDOUT;
+    }
+    conn_data->att_mtu = bt_gatt_get_mtu(conn);
+
+    return err;
+}
+
+/**
+ * @brief Function to request the connection parameters of a profile on a connection:
+ *        short interval without latency while reading (burst), long interval with
+ *        high peripheral latency in between (idle). While an update of the connection
+ *        is in progress the profile is only recorded, and requested when the update
+ *        completes (see le_param_updated()) or times out
+ * 
+ * @param conn Connection handle
+ * @param profile Connection parameters profile
+ * @return 0 on success (or if the request is deferred), error code otherwise
+ */
+int set_connection_profile(struct bt_conn *conn, enum ble_connection_profile_e profile)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+    int err = 0;
+
+    if (conn_data == NULL)
+    {
+        return -ENOTCONN;
+    }
+
+    k_mutex_lock(&connection_profile_mutex, K_FOREVER);
+    conn_data->requested_profile = profile;
+    if (!is_profile_update_outstanding(conn_data))
+    {
+        err = request_connection_profile(conn, conn_data);
+    }
+    k_mutex_unlock(&connection_profile_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Function to request the connection parameters of a profile on every
+ *        connection (see set_connection_profile())
+ * 
+ * @param profile Connection parameters profile
+ */
+void set_all_connections_profile(enum ble_connection_profile_e profile)
+{
+    ble_connection_data_t *conn_data;
+    struct bt_conn *conn;
+
+    for (uint8_t index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        conn = get_ble_conn_handles(index);
+        conn_data = get_device_by_conn_handle(conn);
+        // Skip the connection being created
+        if (conn_data != NULL && conn_data->is_connected)
+        {
+            set_connection_profile(conn, profile);
+        }
+    }
+}
+
+#ifdef BLE_AUTO_RECONNECT
+/**
+ * @brief Function to remember a sensor node that was assigned to a row, so that
+ *        it is reconnected by the controller (Filter Accept List) when it drops.
+ *        Called from the read callbacks, the list itself is updated by the ble fsm
+ * 
+ * @param addr Address of the sensor node
+ */
+void add_known_device(const bt_addr_le_t *addr)
+{
+    k_mutex_lock(&known_devices_mutex, K_FOREVER);
+    if (find_known_device(addr) < 0 && known_devices_count < BLE_KNOWN_DEVICES_SIZE)
+    {
+        bt_addr_le_copy(&known_devices[known_devices_count], addr);
+        is_known_device_listed[known_devices_count] = false;
+        known_device_misses[known_devices_count] = 0;
+        known_devices_count++;
+    }
+    k_mutex_unlock(&known_devices_mutex);
+}
+
+/**
+ * @brief Function to check (and clear) whether a known sensor node disconnected
+ * 
+ * @return true if a known sensor node disconnected since the last call
+ */
+bool is_auto_reconnect_requested(void)
+{
+    return atomic_cas(&auto_reconnect_requested, true, false);
+}
+
+/**
+ * @brief Function to check whether any known sensor node is not connected
+ * 
+ * @return true if at least one known sensor node is not connected
+ */
+bool is_known_device_disconnected(void)
+{
+    struct bt_conn *conn;
+    bool is_disconnected = false;
+
+    k_mutex_lock(&known_devices_mutex, K_FOREVER);
+    for (uint8_t index = 0; index < known_devices_count && !is_disconnected; index++)
+    {
+        conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, &known_devices[index]);
+        if (conn == NULL)
+        {
+            is_disconnected = true;
+        }
+        else
+        {
+            bt_conn_unref(conn);
+        }
+    }
+    k_mutex_unlock(&known_devices_mutex);
+
+    return is_disconnected;
+}
+
+/**
+ * @brief Function to count a missed reconnect window for every known sensor node
+ *        that is not connected. Nodes that missed BLE_KNOWN_DEVICE_MAX_MISSES windows
+ *        in a row are dropped (they are added again once the scanner finds them).
+ *        Must be called while auto connect is stopped
+ * 
+ */
+void count_known_devices_misses(void)
+{
+    struct bt_conn *conn;
+    char addr[BT_ADDR_LE_STR_LEN];
+    uint8_t index = 0;
+
+    k_mutex_lock(&known_devices_mutex, K_FOREVER);
+    while (index < known_devices_count)
+    {
+        conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, &known_devices[index]);
+        if (conn != NULL)
+        {
+            bt_conn_unref(conn);
+            known_device_misses[index] = 0;
+            index++;
+            continue;
+        }
+
+        known_device_misses[index]++;
+        if (known_device_misses[index] < BLE_KNOWN_DEVICE_MAX_MISSES)
+        {
+            index++;
+            continue;
+        }
+
+        bt_addr_le_to_str(&known_devices[index], addr, sizeof(addr));
+        LOG_INF("Known device dropped after %d missed reconnects: %s", BLE_KNOWN_DEVICE_MAX_MISSES, addr);
+        // The last known device is moved to this index, so it is checked next
+        remove_known_device(index);
+    }
+    k_mutex_unlock(&known_devices_mutex);
+}
+
+/**
+ * @brief Function to let the controller connect to the first known sensor node
+ *        (on the Filter Accept List) it hears, without host scanning. Scanning is
+ *        paused like in connect_to_device(); ble_connect_ok_sem is given when the
+ *        connection is established or failed
+ * 
+ * @param conn_data Free bluetooth device member (see get_empty_ble_handle())
+ *                  that will store the connection data
+ * @return 0 if auto connect started, error code otherwise
+ */
+int start_auto_connect(ble_connection_data_t *conn_data)
+{
+    int err;
+
+    ble_connection_data = conn_data;
+    // Set by the connected callback
+    ble_connection_data->ble_connection_handle = NULL;
+
+    err = bt_le_scan_stop();
+    if (err && err != -EALREADY)
+    {
+        LOG_INF("Stop LE scan failed (err %d)", err);
+    }
+
+    update_filter_accept_list();
+    err = bt_conn_le_create_auto(BT_CONN_LE_CREATE_CONN, BT_CONNECTION_PARAMETERS);
+    if (err)
+    {
+        LOG_INF("Auto connect failed to start (err %d)", err);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Function to stop the auto connect started by start_auto_connect().
+ *        The connected callback is then called with an error
+ * 
+ */
+void stop_auto_connect(void)
+{
+    int err;
+
+    err = bt_conn_create_auto_stop();
+    if (err && err != -EALREADY)
+    {
+        LOG_INF("Stop auto connect failed (err %d)", err);
+    }
+}
+#endif // BLE_AUTO_RECONNECT
@@ -13,9 +13,60 @@
 	BT_CONN_LE_CREATE_PARAM(BT_CONN_LE_OPT_NONE, \
 				BT_GAP_SCAN_SLOW_INTERVAL_2, \
 				BT_GAP_SCAN_SLOW_WINDOW_2)
+// How many found sensor nodes can wait to be connected
+#define BLE_PENDING_DEVICES_QUEUE_SIZE BLE_MAX_CONNECTIONS
+// Idle connection parameters: interval (1.25 ms units) and peripheral latency
+#define BLE_IDLE_CONNECTION_INTERVAL 400
+#define BLE_IDLE_CONNECTION_LATENCY 4
+// Longest time (ms) a node on the idle connection parameters may take to listen
+// to the central, so the first request of a read cycle may wait that long
+#define BLE_IDLE_CONNECTION_WAKEUP_MS ((BLE_IDLE_CONNECTION_LATENCY + 1) * BLE_IDLE_CONNECTION_INTERVAL * 5 / 4)
+// Known (row assigned) sensor nodes are kept in the controller Filter Accept List and
+// reconnected by the controller when they drop. Rotated nodes are disconnected on
+// purpose and advertising nodes are not connected, so it is not used with them
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST) && !defined(BLE_ROTATION_MODE) && !defined(BLE_ADV_TELEMETRY_MODE)
+#define BLE_AUTO_RECONNECT
+// How many known sensor nodes are kept in the Filter Accept List: as many as the
+// controller list holds (8 is the controller default when its size is not known)
+#ifdef CONFIG_BT_CTLR_FAL_SIZE
+#define BLE_KNOWN_DEVICES_SIZE MIN(CONFIG_BT_CTLR_FAL_SIZE, BLE_MAX_CONNECTIONS)
+#else
+#define BLE_KNOWN_DEVICES_SIZE MIN(8, BLE_MAX_CONNECTIONS)
+#endif
+// Consecutive reconnect windows a known sensor node may miss before it is dropped
+// from the known devices (and the Filter Accept List)
+#define BLE_KNOWN_DEVICE_MAX_MISSES 3
+#endif
+
+// --- enums -------------------------------------------------------------------
+// Connection parameters profiles (see set_connection_profile())
+enum ble_connection_profile_e
+{
+    // Parameters the connection was established with (none requested yet)
+    BLE_DEFAULT_PROFILE,
+    // Short interval, no latency: while characteristics are discovered or read
+    BLE_BURST_PROFILE,
+    // Long interval, high latency: between read cycles
+    BLE_IDLE_PROFILE
+};
 
 // --- function declarations ---------------------------------------------------
-ble_connection_data_t *start_scan(const struct bt_le_scan_param *scan_parameters);
+int start_scan(const struct bt_le_scan_param *scan_parameters);
+void resume_scan(void);
+int connect_to_device(const bt_addr_le_t *addr, ble_connection_data_t *conn_data);
+int connect_to_pending_device(ble_connection_data_t *conn_data);
+void cancel_pending_connection(void);
+int update_link_parameters(struct bt_conn *conn);
+int set_connection_profile(struct bt_conn *conn, enum ble_connection_profile_e profile);
+void set_all_connections_profile(enum ble_connection_profile_e profile);
+#ifdef BLE_AUTO_RECONNECT
+void add_known_device(const bt_addr_le_t *addr);
+bool is_auto_reconnect_requested(void);
+bool is_known_device_disconnected(void);
+void count_known_devices_misses(void);
+int start_auto_connect(ble_connection_data_t *conn_data);
+void stop_auto_connect(void);
+#endif
 void bt_ready(int err);
 
 #endif // BLE_CONN_CONTROL_H
@@ -1,6 +1,7 @@
 // --- includes ----------------------------------------------------------------
 #include "ble_connection_data.h"
 #include "ble_characteristic_control.h"
+#include "ble_node_registry.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -13,6 +14,35 @@ LOG_MODULE_DECLARE(ble_m);
 // --- static variables definitions --------------------------------------------
 // All connection data are stored on this static variable
 static ble_connection_data_t bluetooth_devices[BLE_MAX_CONNECTIONS];
+// Maps the stack connection index (bt_conn_index()) to the bluetooth_devices index,
+// so that callbacks find their device without going through the whole array
+static uint8_t conn_index_to_device_index[CONFIG_BT_MAX_CONN];
+
+// --- static function declarations --------------------------------------------
+static void update_radio_time(ble_connection_data_t *conn_data);
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Add the radio time of the connection events since the last call, for the
+ *        connection parameters in use. The central takes part in every connection
+ *        event, the node skips up to conn_latency events
+ * 
+ * @param conn_data Connection data of the device
+ */
+static void update_radio_time(ble_connection_data_t *conn_data)
+{
+    int64_t now = k_uptime_get();
+    uint64_t conn_events;
+
+    if (conn_data->conn_interval != 0)
+    {
+        // Interval is in 1.25 ms units
+        conn_events = ((uint64_t)(now - conn_data->conn_param_time) * 4) / (conn_data->conn_interval * 5);
+        conn_data->central_radio_time += conn_events * BLE_CONN_EVENT_RADIO_TIME_US;
+        conn_data->node_radio_time += (conn_events / (conn_data->conn_latency + 1)) * BLE_CONN_EVENT_RADIO_TIME_US;
+    }
+    conn_data->conn_param_time = now;
+}
 
 // --- function definitions ----------------------------------------------------
 /**
@@ -78,24 +108,59 @@ void remove_connection_data(struct bt_conn *conn)
  */
 ble_connection_data_t *get_device_by_conn_handle(struct bt_conn *conn)
 {
-    int index = 0;
-    bool device_found = false;
-    for (index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    int index = get_device_index_by_conn_handle(conn);
+
+    if (index < 0)
     {
-        if (bluetooth_devices[index].ble_connection_handle == conn)
-        {
-            device_found = true;
-            break;
-        }
+        return NULL;
+    }
+
+    return &bluetooth_devices[index];
+}
+
+/**
+ * @brief Get the index of the device (on static ble_connection_data_t bluetooth_devices)
+ *        that corresponds to the given connection handle. The same index is used
+ *        by the measurements data storage and the characteristic read slots
+ * 
+ * @param conn Connection handle
+ * @return index of the bluetooth device member, -1 if not found
+ */
+int get_device_index_by_conn_handle(struct bt_conn *conn)
+{
+    uint8_t index;
+
+    if (conn == NULL)
+    {
+        return -1;
     }
-    if (device_found)
+
+    index = conn_index_to_device_index[bt_conn_index(conn)];
+    // Entries are not cleared on disconnection, so make sure the mapping is still valid
+    if (index >= BLE_MAX_CONNECTIONS || bluetooth_devices[index].ble_connection_handle != conn)
     {
-        return &bluetooth_devices[index];
+        return -1;
     }
-    else
+
+    return index;
+}
+
+/**
+ * @brief Map a newly established connection to the bluetooth_devices member
+ *        that holds its connection data. Must be called from the connected callback
+ *        before any other lookup by connection handle
+ * 
+ * @param conn Connection handle
+ * @param conn_data bluetooth device member returned by get_empty_ble_handle()
+ */
+void set_device_conn_index(struct bt_conn *conn, ble_connection_data_t *conn_data)
+{
+    if (conn == NULL || conn_data == NULL)
     {
-        return NULL;
+        return;
     }
+
+    conn_index_to_device_index[bt_conn_index(conn)] = conn_data - bluetooth_devices;
 }
 
 /**
@@ -118,21 +183,108 @@ struct bt_conn *get_ble_conn_handles(uint8_t index)
 }
 
 /**
- * @brief Function to retreive the mac address of a bluetooth connection
+ * @brief Function to retreive the node registry index of a bluetooth connection
+ *        (rotation mode)
  * 
  * @param conn 
- * @return the mac address corresponding to the connection handle
- * @return NULL if the connection handle is not found on the array of ble devices
+ * @return the node registry index corresponding to the connection handle
+ * @return BLE_NODE_INVALID_INDEX if the connection handle is not found on the array of ble devices
+ */
+uint16_t get_node_index_by_conn_handle(struct bt_conn *conn)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+
+    if(conn_data == NULL)
+    {
+        return BLE_NODE_INVALID_INDEX;
+    }
+
+    return conn_data->node_index;
+}
+
+/**
+ * @brief Log the negotiated link parameters and the read throughput of every
+ *        connected device (throughput benchmark)
+ * 
+ */
+void log_link_throughput(void)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
+
+    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        if (!bluetooth_devices[index].is_connected)
+        {
+            continue;
+        }
+
+        bt_addr_le_to_str(bt_conn_get_dst(bluetooth_devices[index].ble_connection_handle), addr, sizeof(addr));
+        LOG_INF("%s: mtu %d, data length %d, phy %d, read %u B/s", addr,
+                bluetooth_devices[index].att_mtu, bluetooth_devices[index].tx_data_length,
+                bluetooth_devices[index].tx_phy, bluetooth_devices[index].read_throughput);
+    }
+}
+
+/**
+ * @brief Set the connection parameters in use by a device. Called when the
+ *        connection is established and every time its parameters are updated
+ * 
+ * @param conn_data Connection data of the device
+ * @param interval Connection interval (1.25 ms units)
+ * @param latency Peripheral latency (connection events)
+ */
+void set_connection_parameters(ble_connection_data_t *conn_data, uint16_t interval, uint16_t latency)
+{
+    if (conn_data->connected_time == 0)
+    {
+        conn_data->connected_time = k_uptime_get();
+        conn_data->conn_param_time = conn_data->connected_time;
+    }
+
+    update_radio_time(conn_data);
+    conn_data->conn_interval = interval;
+    conn_data->conn_latency = latency;
+}
+
+/**
+ * @brief Log the estimated radio duty cycle since connection: the central one is
+ *        the sum of every connection, the node one is the mean of the nodes
+ * 
  */
-char *get_mac_address_by_conn_handle(struct bt_conn* conn)
+void log_radio_duty_cycle(void)
 {
-    for(int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    // Duty cycles in hundredths of a percent
+    uint32_t central_duty_cycle = 0;
+    uint32_t node_duty_cycle = 0;
+    uint8_t connections = 0;
+    int64_t connected_time;
+
+    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
     {
-        if(bluetooth_devices->ble_connection_handle == conn)
+        if (!bluetooth_devices[index].is_connected || bluetooth_devices[index].connected_time == 0)
         {
-            return bluetooth_devices->mac_address;
+            continue;
         }
+
+        update_radio_time(&bluetooth_devices[index]);
+        connected_time = bluetooth_devices[index].conn_param_time - bluetooth_devices[index].connected_time;
+        if (connected_time <= 0)
+        {
+            continue;
+        }
+
+        // radio time (us) * 10000 / (connected time (ms) * 1000)
+        central_duty_cycle += (uint32_t)((bluetooth_devices[index].central_radio_time * 10) / connected_time);
+        node_duty_cycle += (uint32_t)((bluetooth_devices[index].node_radio_time * 10) / connected_time);
+        connections++;
     }
 
-    return NULL;
-}
\ No newline at end of file
+    if (connections == 0)
+    {
+        return;
+    }
+
+    node_duty_cycle /= connections;
+    LOG_INF("Radio duty cycle (estimated): central %u.%02u %%, node mean %u.%02u %%",
+            central_duty_cycle / 100, central_duty_cycle % 100, node_duty_cycle / 100, node_duty_cycle % 100);
+}
@@ -6,15 +6,17 @@
 #include "common.h"
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/conn.h>
 
 // --- defines -----------------------------------------------------------------
 #define BLE_MAX_CONNECTIONS 20
+// Estimated radio time (us) of a connection event without data (both sides, 1M PHY)
+#define BLE_CONN_EVENT_RADIO_TIME_US 400
 
 // --- structs -----------------------------------------------------------------
 typedef struct ble_connection_data_s
 {
     struct bt_conn *ble_connection_handle;
-    char mac_address[MAC_ADDRESS_LENGTH];
     bool is_connected;
     uint16_t temperature_value_handle;
     uint16_t humidity_value_handle;
@@ -22,13 +24,53 @@ typedef struct ble_connection_data_s
     uint16_t light_intensity_value_handle;
     uint16_t configuration_value_handle;
     uint16_t battery_value_handle;
+    // Measurement record characteristic (0 if the peer has none), read instead of
+    // every characteristic above when available
+    uint16_t measurement_record_value_handle;
+    // Time beacon characteristic (0 if the peer has none) and uptime (ms) it was last written
+    uint16_t time_beacon_value_handle;
+    int64_t time_beacon_time;
+    // Service Changed characteristic of the GATT service (0 if the peer has none)
+    uint16_t service_changed_value_handle;
+    uint16_t service_changed_ccc_handle;
+    // Set when the peer rejects ATT Read Multiple Variable requests
+    bool is_read_multiple_rejected;
+    // Index of the node on the node registry (rotation mode)
+    uint16_t node_index;
+    // Negotiated link parameters (see update_link_parameters())
+    uint16_t att_mtu;
+    uint16_t tx_data_length;
+    uint8_t tx_phy;
+    // Throughput (bytes/sec) of the last read sequence of the node
+    uint32_t read_throughput;
+    // Connection interval (1.25 ms units) and peripheral latency in use
+    uint16_t conn_interval;
+    uint16_t conn_latency;
+    // Connection parameters profile (enum ble_connection_profile_e) requested by the
+    // central and the one in use, and whether an update requested at
+    // profile_update_time (uptime, ms) is still outstanding
+    uint8_t requested_profile;
+    uint8_t applied_profile;
+    bool is_profile_update_pending;
+    int64_t profile_update_time;
+    // Radio duty cycle estimate: uptime (ms) of the connection and of the last
+    // parameters change, radio time (us) of the central and the node since connection
+    int64_t connected_time;
+    int64_t conn_param_time;
+    uint64_t central_radio_time;
+    uint64_t node_radio_time;
 } ble_connection_data_t;
 
 // --- function declarations ---------------------------------------------------
 ble_connection_data_t *get_empty_ble_handle(void);
 void remove_connection_data(struct bt_conn *conn);
 ble_connection_data_t *get_device_by_conn_handle(struct bt_conn *conn);
+int get_device_index_by_conn_handle(struct bt_conn *conn);
+void set_device_conn_index(struct bt_conn *conn, ble_connection_data_t *conn_data);
 
 struct bt_conn *get_ble_conn_handles(uint8_t index);
-char *get_mac_address_by_conn_handle(struct bt_conn* conn);
+uint16_t get_node_index_by_conn_handle(struct bt_conn *conn);
+void log_link_throughput(void);
+void set_connection_parameters(ble_connection_data_t *conn_data, uint16_t interval, uint16_t latency);
+void log_radio_duty_cycle(void);
 #endif // BLE_CONNECTION_DATA_H
@@ -10,6 +10,10 @@
 #include "ble_fsm.h"
 #include "ble_conn_control.h"
 #include "ble_characteristic_control.h"
+#ifdef BLE_ROTATION_MODE
+#include "ble_node_registry.h"
+#include "measurements/measurements_data_storage.h"
+#endif
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -20,6 +24,19 @@
 // --- defines -----------------------------------------------------------------
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
+// Time given to a queued sensor node to accept the connection
+#define BLE_CONNECT_TIMEOUT_MS 3000
+#ifdef BLE_ROTATION_MODE
+// How often the scheduler looks for a due node when no node was due
+#define BLE_ROTATION_SCHEDULE_PERIOD_MS 1000
+#endif
+#ifdef BLE_AUTO_RECONNECT
+// How often the ble fsm looks for dropped known nodes while waiting for found devices
+#define BLE_AUTO_RECONNECT_CHECK_PERIOD_MS 500
+// Time given to the controller to reconnect the dropped known nodes, scanning
+// for new devices is paused meanwhile
+#define BLE_AUTO_RECONNECT_WINDOW_MS 10000
+#endif
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(ble_m);
@@ -30,10 +47,8 @@ enum ble_state_e
 {
     // First initialize bluetooth
     BLE_INIT_STATE,
-    // Find a device to connect to
+    // Connect to the devices found by the scanner (discovery is done by the ble discovery thread)
     BLE_CONNECT_STATE,
-    // Discover the desired characteristics of the device we just connected to
-    BLE_CHAR_DISCOVER_STATE,
     // Wait here if max ble connections reached
     BLE_WAIT_FOR_DISCONNECT
 };
@@ -42,18 +57,27 @@ enum ble_state_e
 // Scan parameters
 static struct bt_le_scan_param scan_param = {
     .type = BT_LE_SCAN_TYPE_ACTIVE,
+#ifdef BLE_ADV_TELEMETRY_MODE
+    // Advertised records change over time, every advertisement must be reported
     .options = BT_LE_SCAN_OPT_NONE,
+#else
+    // Found devices are deduplicated by the pending devices queue
+    .options = BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+#endif
     .interval = BT_GAP_SCAN_FAST_INTERVAL,
     .window = BT_GAP_SCAN_FAST_WINDOW,
 };
 // Forward declaration of state table
 static const struct smf_state ble_states[];
+// Connected devices waiting for characteristic discovery (a referenced struct bt_conn *)
+K_MSGQ_DEFINE(ble_discovery_msgq, sizeof(struct bt_conn *), BLE_MAX_CONNECTIONS, 4);
 
 // --- variables definitions ---------------------------------------------------
 struct k_sem ble_init_ok_sem;
 struct k_sem ble_connect_ok_sem;
 struct k_sem ble_char_discovery_sem;
 struct k_sem ble_wait_for_disconnect_sem;
+struct k_sem ble_pending_device_sem;
 
 // User defined object
 struct user_object_s
@@ -71,8 +95,13 @@ static void ble_init_state_run(void *o);
 static void ble_init_state_exit(void *o);
 
 static void ble_connect_state_run(void *o);
+#ifdef BLE_AUTO_RECONNECT
+static void reconnect_known_devices(struct user_object_s *user_ctx);
+#endif
+static void hand_over_connected_device(struct user_object_s *user_ctx);
 
-static void ble_char_discover_state_run(void *o);
+static void discover_all_characteristics(struct bt_conn *conn);
+static void discover_connected_device(struct bt_conn *conn);
 
 static void ble_wait_for_disconnect_entry(void *o);
 static void ble_wait_for_disconnect_run(void *o);
@@ -85,6 +114,7 @@ static void ble_init_state_entry(void *o)
     k_sem_init(&ble_connect_ok_sem, 0, 1);
     k_sem_init(&ble_char_discovery_sem, 0, 1);
     k_sem_init(&ble_wait_for_disconnect_sem, 0, 1);
+    k_sem_init(&ble_pending_device_sem, 0, BLE_PENDING_DEVICES_QUEUE_SIZE);
 
     bt_enable(bt_ready);
 }
@@ -97,6 +127,8 @@ static void ble_init_state_run(void *o)
         // TODO: add system reset -> add it as a separate ble fsm state (sfm_set_state(SYSTEM_RESET_STATE))
         LOG_INF("Ble could not start (err %d)", err);
     }
+    // Scanning goes on in the background from now on
+    start_scan(&scan_param);
     smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_CONNECT_STATE]);
 }
 static void ble_init_state_exit(void *o)
@@ -108,59 +140,251 @@ static void ble_init_state_exit(void *o)
 static void ble_connect_state_run(void *o)
 {
     struct user_object_s *user_ctx = (struct user_object_s *)o;
-    // Work
-    user_ctx->active_connection_data = start_scan(&scan_param);
+#ifdef BLE_ROTATION_MODE
+    bt_addr_le_t addr;
+    uint16_t node_index;
+
+    user_ctx->active_connection_data = get_empty_ble_handle();
+    // Every connection slot is serving a node, wait for one of them to disconnect
+    if (user_ctx->active_connection_data == NULL)
+    {
+        smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_WAIT_FOR_DISCONNECT]);
+        return;
+    }
+
+    // Pick the node that waited the longest. If no node is due, wait until the
+    // scanner finds a new node or the next node gets due
+    if (!ble_node_registry_schedule(&addr, &node_index))
+    {
+        k_sem_take(&ble_pending_device_sem, K_MSEC(BLE_ROTATION_SCHEDULE_PERIOD_MS));
+        return;
+    }
+
+    user_ctx->active_connection_data->node_index = node_index;
+    k_sem_reset(&ble_connect_ok_sem);
+    if (connect_to_device(&addr, user_ctx->active_connection_data))
+    {
+        ble_node_registry_set_served(node_index, false);
+        return;
+    }
+#else
+#ifdef BLE_AUTO_RECONNECT
+    // Known nodes that dropped are reconnected by the controller first
+    if (is_auto_reconnect_requested())
+    {
+        reconnect_known_devices(user_ctx);
+        return;
+    }
+
+    // Wait until the scanner queues a device to connect to, look for dropped
+    // known nodes meanwhile
+    if (k_sem_take(&ble_pending_device_sem, K_MSEC(BLE_AUTO_RECONNECT_CHECK_PERIOD_MS)) != 0)
+    {
+        return;
+    }
+#else
+    // Wait until the scanner queues a device to connect to
+    k_sem_take(&ble_pending_device_sem, K_FOREVER);
+#endif
+
+    user_ctx->active_connection_data = get_empty_ble_handle();
     // bluetooth_devices array is full, wait for someone to disconnect
     if (user_ctx->active_connection_data == NULL)
     {
+        // The device stays queued
+        k_sem_give(&ble_pending_device_sem);
         smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_WAIT_FOR_DISCONNECT]);
+        return;
+    }
+
+    k_sem_reset(&ble_connect_ok_sem);
+    if (connect_to_pending_device(user_ctx->active_connection_data))
+    {
+        return;
+    }
+#endif
+
+    // Wait until connection happens. A device that does not answer in time is
+    // dropped, the next queued device is connected instead
+    if (k_sem_take(&ble_connect_ok_sem, K_MSEC(BLE_CONNECT_TIMEOUT_MS)) != 0)
+    {
+        LOG_INF("Connection timed out");
+        cancel_pending_connection();
+        k_sem_take(&ble_connect_ok_sem, K_MSEC(BLE_CONNECT_TIMEOUT_MS));
     }
-    else
+    resume_scan();
+
+    // Go on with the next queued device
+    hand_over_connected_device(user_ctx);
+#ifdef BLE_ROTATION_MODE
+    if (!user_ctx->active_connection_data->is_connected)
     {
-        // Wait until connection happens
-        k_sem_take(&ble_connect_ok_sem, K_FOREVER);
-        // Set next state
-        smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_CHAR_DISCOVER_STATE]);
+        ble_node_registry_set_served(node_index, false);
     }
+#endif
 }
 
-// --- State BLE CHAR DISCOVER
-static void ble_char_discover_state_run(void *o)
+/**
+ * @brief is_connected will only become true if connection is established without errors.
+ *        If connection is established without errors, hand the device over to the
+ *        ble discovery thread
+ *
+ * @param user_ctx ble fsm user object
+ */
+static void hand_over_connected_device(struct user_object_s *user_ctx)
 {
-    struct user_object_s *user_ctx = (struct user_object_s *)o;
+    struct bt_conn *conn;
 
-    // is_connected will only become true if connection is established without errors
-    // if connection is established without errors, proceed with characteristic discovery
     if (user_ctx->active_connection_data->is_connected)
     {
-        // Discover every characteristic of the measurement service
-        for(int measurement_service_characteristic_count = 0; measurement_service_characteristic_count < MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT; measurement_service_characteristic_count++)
+        conn = bt_conn_ref(user_ctx->active_connection_data->ble_connection_handle);
+        if (k_msgq_put(&ble_discovery_msgq, &conn, K_NO_WAIT))
+        {
+            bt_conn_unref(conn);
+        }
+    }
+}
+
+#ifdef BLE_AUTO_RECONNECT
+/**
+ * @brief Let the controller reconnect the known nodes that dropped, one after the
+ *        other (auto connect stops after every connection), until all of them are
+ *        connected or BLE_AUTO_RECONNECT_WINDOW_MS is over. Nodes that are not back
+ *        by then are found by the scanner again, and dropped from the known devices
+ *        after BLE_KNOWN_DEVICE_MAX_MISSES windows (see count_known_devices_misses())
+ *
+ * @param user_ctx ble fsm user object
+ */
+static void reconnect_known_devices(struct user_object_s *user_ctx)
+{
+    int64_t window_end = k_uptime_get() + BLE_AUTO_RECONNECT_WINDOW_MS;
+    int64_t remaining_time;
+
+    while (is_known_device_disconnected())
+    {
+        remaining_time = window_end - k_uptime_get();
+        if (remaining_time <= 0)
+        {
+            count_known_devices_misses();
+            break;
+        }
+        user_ctx->active_connection_data = get_empty_ble_handle();
+        if (user_ctx->active_connection_data == NULL)
+        {
+            break;
+        }
+
+        k_sem_reset(&ble_connect_ok_sem);
+        if (start_auto_connect(user_ctx->active_connection_data))
         {
-            characteristic_discovery_wrapper(user_ctx->active_connection_data->ble_connection_handle, MEASUREMENT_SERVICE_INDEX, measurement_service_characteristic_count);
-            k_sem_take(&ble_char_discovery_sem, K_MSEC(5000));
+            break;
         }
 
-        // Discover every characteristic of the configure service
-        // Configure service characteristic indexes should be offseted by MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT as they are after measurement service characteristics
-        for(int configure_service_char_count = 0 + MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT; configure_service_char_count < CONFIGURE_SERVICE_CHARACTERISTIC_COUNT + MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT; configure_service_char_count++)
+        if (k_sem_take(&ble_connect_ok_sem, K_MSEC(remaining_time)) != 0)
         {
-            characteristic_discovery_wrapper(user_ctx->active_connection_data->ble_connection_handle, CONFIGURE_SERVICE_INDEX, configure_service_char_count);
-            k_sem_take(&ble_char_discovery_sem, K_MSEC(5000));
+            LOG_INF("Known devices did not reconnect in time");
+            stop_auto_connect();
+            k_sem_take(&ble_connect_ok_sem, K_MSEC(BLE_CONNECT_TIMEOUT_MS));
+            hand_over_connected_device(user_ctx);
+            count_known_devices_misses();
+            break;
         }
 
-        LOG_INF("Connection and discovery completed: %s", user_ctx->active_connection_data->mac_address);
-        smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_CONNECT_STATE]);
+        hand_over_connected_device(user_ctx);
     }
-    else
+    resume_scan();
+}
+#endif
+
+// --- State BLE CHAR DISCOVER
+/**
+ * @brief Discover every characteristic of the measurement and configure services,
+ *        as well as the Service Changed characteristic, of a connected device
+ *
+ * @param conn Connection handle
+ */
+static void discover_all_characteristics(struct bt_conn *conn)
+{
+    // Discover every characteristic of the measurement service, then of the configure service
+    // (one pass over the handle range of each service)
+    for(uint8_t service_index = MEASUREMENT_SERVICE_INDEX; service_index <= CONFIGURE_SERVICE_INDEX; service_index++)
     {
-        // Right now we get an error while trying to connect if a node resets for some reason (for example press reset button)
-        // If something like that happens, then we need to wait for central node to be notified that this node disconnected
-        // If we dont wait and keep trying to connect to this node, the connection attempts will always return error
-        // TODO: Waiting for the node to disconnect might not be the best approach but for now it works. It depends on the reason
-        // the connection failed.
-        // TODO: IMPORTANT: this should be handled on CONNECT STATE -> Just move this if check on connect state and DONE!!!
-        smf_set_state(SMF_CTX(&user_object), &ble_states[BLE_WAIT_FOR_DISCONNECT]);
+        characteristic_discovery_wrapper(conn, service_index);
+        k_sem_take(&ble_char_discovery_sem, K_MSEC(5000));
+    }
+
+    // Discover the Service Changed characteristic, to know when cached handles get invalid
+    service_changed_discovery_wrapper(conn);
+    k_sem_take(&ble_char_discovery_sem, K_MSEC(5000));
+}
+
+/**
+ * @brief Discover (or restore from the handle cache) the characteristics of a
+ *        connected device and subscribe to its indications/notifications
+ *
+ * @param conn Connection handle
+ */
+static void discover_connected_device(struct bt_conn *conn)
+{
+    ble_connection_data_t *conn_data = get_device_by_conn_handle(conn);
+    char addr[BT_ADDR_LE_STR_LEN];
+    bool is_cached;
+#ifdef BLE_ROTATION_MODE
+    uint16_t node_index = get_node_index_by_conn_handle(conn);
+    bool is_served;
+#endif
+
+    // Device disconnected while waiting for discovery
+    if (conn_data == NULL || !conn_data->is_connected)
+    {
+#ifdef BLE_ROTATION_MODE
+        ble_node_registry_set_served(node_index, false);
+#endif
+        return;
+    }
+
+    // Faster link first, so that discovery and reads take fewer connection events
+    set_connection_profile(conn, BLE_BURST_PROFILE);
+    update_link_parameters(conn);
+
+    // Nodes that were connected before use their cached handles and skip discovery
+    is_cached = restore_cached_value_handles(conn);
+    if (!is_cached)
+    {
+        discover_all_characteristics(conn);
+    }
+
+    // Cached handles are dropped if the node indicates that its services changed
+    if (subscribe_service_changed(conn) == 0)
+    {
+        k_sem_take(&ble_char_discovery_sem, K_MSEC(5000));
+    }
+
+    if (!is_cached)
+    {
+        save_value_handles_in_cache(conn);
     }
+
+    // The node samples on the sampling epochs of the central from now on
+    write_time_beacon(conn);
+
+#ifdef MEASUREMENTS_PUSH_MODE
+    // Let the sensor node push its measurements from now on
+    subscribe_measurement_notifications(conn);
+#endif
+    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+    LOG_INF("Connection and discovery completed: %s", addr);
+
+#ifndef BLE_ROTATION_MODE
+    // Node is not read before the next cycle (or it pushes its measurements)
+    set_connection_profile(conn, BLE_IDLE_PROFILE);
+#else
+    // The time slice of the node ends after its characteristics are read, so
+    // that its connection slot is given to the next node
+    is_served = rotated_node_measurements(node_index, conn);
+    ble_node_registry_set_served(node_index, is_served);
+    bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+#endif
 }
 
 // --- state BLE WAIT FOR DISCONNECT
@@ -181,7 +405,6 @@ static void ble_wait_for_disconnect_run(void *o)
 static const struct smf_state ble_states[] = {
     [BLE_INIT_STATE] = SMF_CREATE_STATE(ble_init_state_entry, ble_init_state_run, ble_init_state_exit),
     [BLE_CONNECT_STATE] = SMF_CREATE_STATE(NULL, ble_connect_state_run, NULL),
-    [BLE_CHAR_DISCOVER_STATE] = SMF_CREATE_STATE(NULL, ble_char_discover_state_run, NULL),
     [BLE_WAIT_FOR_DISCONNECT] = SMF_CREATE_STATE(ble_wait_for_disconnect_entry, ble_wait_for_disconnect_run, NULL),
 };
 
@@ -211,3 +434,24 @@ void ble_fsm(void)
 
 K_THREAD_DEFINE(ble_fsm_id, STACKSIZE, ble_fsm, NULL, NULL, NULL,
                 PRIORITY, 0, 0);
+
+/**
+ * @brief Bluetooth discovery thread -> Discovers the characteristics of the devices
+ *        connected by the ble fsm, so that connection creation and discovery of
+ *        different devices happen at the same time
+ * 
+ */
+void ble_discovery(void)
+{
+    struct bt_conn *conn;
+
+    while (1)
+    {
+        k_msgq_get(&ble_discovery_msgq, &conn, K_FOREVER);
+        discover_connected_device(conn);
+        bt_conn_unref(conn);
+    }
+}
+
+K_THREAD_DEFINE(ble_discovery_id, STACKSIZE, ble_discovery, NULL, NULL, NULL,
+                PRIORITY, 0, 0);
@@ -12,5 +12,6 @@ extern struct k_sem ble_init_ok_sem;
 extern struct k_sem ble_connect_ok_sem;
 extern struct k_sem ble_char_discovery_sem;
 extern struct k_sem ble_wait_for_disconnect_sem;
+extern struct k_sem ble_pending_device_sem;
 
 #endif // BLE_FSM_H
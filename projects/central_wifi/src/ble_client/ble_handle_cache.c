@@ -0,0 +1,322 @@
+/*
+ * Description:
+ *
+ * Source file that keeps the discovered GATT handles of every sensor node,
+ * keyed by the node address. A node that reconnects uses the cached handles
+ * and skips characteristic discovery. The cache lives in RAM, the most
+ * recently used entries are also kept in flash so that they survive a reboot
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "ble_handle_cache.h"
+#include "flash_system/flash_system.h"
+#include "environment_control/environment_control_config.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+// --- logging settings --------------------------------------------------------
+LOG_MODULE_DECLARE(ble_m);
+
+// --- structs -----------------------------------------------------------------
+// Cache entry as stored in flash
+typedef struct ble_handle_cache_entry_s
+{
+    bt_addr_le_t peer_address;
+    uint16_t temperature_value_handle;
+    uint16_t humidity_value_handle;
+    uint16_t soil_moisture_value_handle;
+    uint16_t light_intensity_value_handle;
+    uint16_t configuration_value_handle;
+    uint16_t battery_value_handle;
+    uint16_t measurement_record_value_handle;
+    uint16_t time_beacon_value_handle;
+    uint16_t service_changed_value_handle;
+    uint16_t service_changed_ccc_handle;
+} ble_handle_cache_entry_t;
+
+// --- defines -----------------------------------------------------------------
+// Cache entry without a flash slot
+#define NO_PERSISTED_SLOT UINT8_MAX
+BUILD_ASSERT(BLE_HANDLE_CACHE_PERSISTED_SIZE < NO_PERSISTED_SLOT, "Too many persisted cache entries");
+// Every record of the NVS: the row control configuration of every row, and the persisted cache entries
+BUILD_ASSERT(MAX_CONFIGURATION_ID * NVS_RECORD_SIZE(sizeof(row_control_t)) +
+             BLE_HANDLE_CACHE_PERSISTED_SIZE * NVS_RECORD_SIZE(sizeof(ble_handle_cache_entry_t)) <= NVS_CAPACITY,
+             "The row control configuration and the handle cache do not fit in NVS");
+
+// --- static function declarations --------------------------------------------
+static void load_cache_entries(void);
+static int find_cache_entry(const bt_addr_le_t *peer_address);
+static int take_cache_entry(void);
+static uint8_t take_persisted_slot(void);
+static void handle_cache_sync_work_handler(struct k_work *work);
+
+// --- static variables definitions --------------------------------------------
+// RAM copy of the cache entries
+static ble_handle_cache_entry_t cache_entries[BLE_HANDLE_CACHE_SIZE];
+static bool is_cache_entry_valid[BLE_HANDLE_CACHE_SIZE];
+// Last use of every entry (use_counter value), the least recently used entries
+// are replaced first
+static uint32_t cache_entry_last_use[BLE_HANDLE_CACHE_SIZE];
+static uint32_t use_counter;
+// Flash slot (NVS id - BLE_HANDLE_CACHE_NVS_ID_BASE) of every entry, NO_PERSISTED_SLOT if
+// the entry is only in RAM. And the entry of every flash slot, -1 if the slot is free
+static uint8_t cache_entry_slot[BLE_HANDLE_CACHE_SIZE];
+static int16_t persisted_slot_entry[BLE_HANDLE_CACHE_PERSISTED_SIZE];
+static bool is_cache_loaded;
+// Cache is used by the ble fsm and the bt callbacks
+static K_MUTEX_DEFINE(handle_cache_mutex);
+// Flash is not written from the bt callbacks, this work item does it instead
+static K_WORK_DEFINE(handle_cache_sync_work, handle_cache_sync_work_handler);
+// Addresses of the nodes invalidated from the bt callbacks. The bt rx thread does not
+// wait on handle_cache_mutex, which is held across flash writes
+static K_MSGQ_DEFINE(handle_cache_invalidate_msgq, sizeof(bt_addr_le_t), BLE_MAX_CONNECTIONS, 4);
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Load the persisted cache entries from flash. Done on the first use of
+ *        the cache, as the flash system is initialized by main
+ *
+ */
+static void load_cache_entries(void)
+{
+    if (is_cache_loaded)
+    {
+        return;
+    }
+
+    for (uint16_t index = 0; index < BLE_HANDLE_CACHE_SIZE; index++)
+    {
+        cache_entry_slot[index] = NO_PERSISTED_SLOT;
+    }
+    // Entry index = flash slot, for the entries read from flash
+    for (uint8_t slot = 0; slot < BLE_HANDLE_CACHE_PERSISTED_SIZE; slot++)
+    {
+        is_cache_entry_valid[slot] = nvs_read(get_file_system_handle(), BLE_HANDLE_CACHE_NVS_ID_BASE + slot,
+                                              &cache_entries[slot], sizeof(cache_entries[slot])) == sizeof(cache_entries[slot]);
+        cache_entry_slot[slot] = is_cache_entry_valid[slot] ? slot : NO_PERSISTED_SLOT;
+        persisted_slot_entry[slot] = is_cache_entry_valid[slot] ? slot : -1;
+    }
+
+    is_cache_loaded = true;
+}
+
+/**
+ * @brief Find the cache entry of a sensor node
+ *
+ * @param peer_address Address of the sensor node
+ * @return index of the entry, -1 if the node is not cached
+ */
+static int find_cache_entry(const bt_addr_le_t *peer_address)
+{
+    for (int index = 0; index < BLE_HANDLE_CACHE_SIZE; index++)
+    {
+        if (is_cache_entry_valid[index] && !bt_addr_le_cmp(&cache_entries[index].peer_address, peer_address))
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Take a cache entry for a node that is not cached: a free entry, or the
+ *        least recently used one when the cache is full. A replaced entry keeps
+ *        its flash slot, the new node is written there
+ *
+ * @return index of the entry
+ */
+static int take_cache_entry(void)
+{
+    int replaced_index = 0;
+
+    for (int index = 0; index < BLE_HANDLE_CACHE_SIZE; index++)
+    {
+        if (!is_cache_entry_valid[index])
+        {
+            return index;
+        }
+        if (cache_entry_last_use[index] < cache_entry_last_use[replaced_index])
+        {
+            replaced_index = index;
+        }
+    }
+
+    return replaced_index;
+}
+
+/**
+ * @brief Take a flash slot for an entry that is only in RAM: a free slot, or the
+ *        slot of the least recently used persisted entry, which stays in RAM only
+ *
+ * @return flash slot
+ */
+static uint8_t take_persisted_slot(void)
+{
+    uint8_t replaced_slot = 0;
+
+    for (uint8_t slot = 0; slot < BLE_HANDLE_CACHE_PERSISTED_SIZE; slot++)
+    {
+        if (persisted_slot_entry[slot] < 0)
+        {
+            return slot;
+        }
+        if (cache_entry_last_use[persisted_slot_entry[slot]] < cache_entry_last_use[persisted_slot_entry[replaced_slot]])
+        {
+            replaced_slot = slot;
+        }
+    }
+
+    cache_entry_slot[persisted_slot_entry[replaced_slot]] = NO_PERSISTED_SLOT;
+    persisted_slot_entry[replaced_slot] = -1;
+
+    return replaced_slot;
+}
+
+/**
+ * @brief Drop the cache entries of the nodes invalidated from the bt callbacks,
+ *        and remove them from flash
+ *
+ * @param work
+ */
+static void handle_cache_sync_work_handler(struct k_work *work)
+{
+    int err;
+    int index;
+    uint8_t slot;
+    bt_addr_le_t peer_address;
+
+    k_mutex_lock(&handle_cache_mutex, K_FOREVER);
+    load_cache_entries();
+    while (k_msgq_get(&handle_cache_invalidate_msgq, &peer_address, K_NO_WAIT) == 0)
+    {
+        index = find_cache_entry(&peer_address);
+        if (index < 0)
+        {
+            continue;
+        }
+
+        is_cache_entry_valid[index] = false;
+        slot = cache_entry_slot[index];
+        if (slot == NO_PERSISTED_SLOT)
+        {
+            continue;
+        }
+
+        cache_entry_slot[index] = NO_PERSISTED_SLOT;
+        persisted_slot_entry[slot] = -1;
+        err = nvs_delete(get_file_system_handle(), BLE_HANDLE_CACHE_NVS_ID_BASE + slot);
+        if (err)
+        {
+            LOG_INF("NVS delete failed (err: %d)", err);
+        }
+    }
+    k_mutex_unlock(&handle_cache_mutex);
+}
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Fill the value handles of a connection from the cache
+ *
+ * @param peer_address Address of the connected sensor node
+ * @param conn_data Connection data of the sensor node
+ * @return true if the node was cached, so discovery can be skipped
+ */
+bool ble_handle_cache_restore(const bt_addr_le_t *peer_address, ble_connection_data_t *conn_data)
+{
+    int index;
+
+    k_mutex_lock(&handle_cache_mutex, K_FOREVER);
+    load_cache_entries();
+    index = find_cache_entry(peer_address);
+    if (index >= 0)
+    {
+        conn_data->temperature_value_handle = cache_entries[index].temperature_value_handle;
+        conn_data->humidity_value_handle = cache_entries[index].humidity_value_handle;
+        conn_data->soil_moisture_value_handle = cache_entries[index].soil_moisture_value_handle;
+        conn_data->light_intensity_value_handle = cache_entries[index].light_intensity_value_handle;
+        conn_data->configuration_value_handle = cache_entries[index].configuration_value_handle;
+        conn_data->battery_value_handle = cache_entries[index].battery_value_handle;
+        conn_data->measurement_record_value_handle = cache_entries[index].measurement_record_value_handle;
+        conn_data->time_beacon_value_handle = cache_entries[index].time_beacon_value_handle;
+        conn_data->service_changed_value_handle = cache_entries[index].service_changed_value_handle;
+        conn_data->service_changed_ccc_handle = cache_entries[index].service_changed_ccc_handle;
+        cache_entry_last_use[index] = ++use_counter;
+    }
+    k_mutex_unlock(&handle_cache_mutex);
+
+    return index >= 0;
+}
+
+/**
+ * @brief Store the discovered value handles of a connection in the cache, and in flash.
+ *        If the cache is full, the least recently used entry is replaced. If every
+ *        flash slot is taken, the least recently used persisted entry gives its slot
+ *
+ * @param peer_address Address of the connected sensor node
+ * @param conn_data Connection data of the sensor node
+ */
+void ble_handle_cache_save(const bt_addr_le_t *peer_address, const ble_connection_data_t *conn_data)
+{
+    int err;
+    int index;
+    uint8_t slot;
+
+    k_mutex_lock(&handle_cache_mutex, K_FOREVER);
+    load_cache_entries();
+    index = find_cache_entry(peer_address);
+    if (index < 0)
+    {
+        index = take_cache_entry();
+    }
+
+    bt_addr_le_copy(&cache_entries[index].peer_address, peer_address);
+    cache_entries[index].temperature_value_handle = conn_data->temperature_value_handle;
+    cache_entries[index].humidity_value_handle = conn_data->humidity_value_handle;
+    cache_entries[index].soil_moisture_value_handle = conn_data->soil_moisture_value_handle;
+    cache_entries[index].light_intensity_value_handle = conn_data->light_intensity_value_handle;
+    cache_entries[index].configuration_value_handle = conn_data->configuration_value_handle;
+    cache_entries[index].battery_value_handle = conn_data->battery_value_handle;
+    cache_entries[index].measurement_record_value_handle = conn_data->measurement_record_value_handle;
+    cache_entries[index].time_beacon_value_handle = conn_data->time_beacon_value_handle;
+    cache_entries[index].service_changed_value_handle = conn_data->service_changed_value_handle;
+    cache_entries[index].service_changed_ccc_handle = conn_data->service_changed_ccc_handle;
+    is_cache_entry_valid[index] = true;
+    cache_entry_last_use[index] = ++use_counter;
+
+    slot = cache_entry_slot[index];
+    if (slot == NO_PERSISTED_SLOT)
+    {
+        slot = take_persisted_slot();
+        cache_entry_slot[index] = slot;
+        persisted_slot_entry[slot] = index;
+    }
+    err = nvs_write(get_file_system_handle(), BLE_HANDLE_CACHE_NVS_ID_BASE + slot, &cache_entries[index], sizeof(cache_entries[index]));
+    if (err < 0)
+    {
+        LOG_INF("NVS write failed (err: %d)", err);
+    }
+    k_mutex_unlock(&handle_cache_mutex);
+}
+
+/**
+ * @brief Drop the cached handles of a sensor node, so that its next connection
+ *        runs characteristic discovery. Called from the bt callbacks after a
+ *        handle error or a Service Changed indication; the entry is dropped by
+ *        the work item, the caller never waits on flash
+ *
+ * @param peer_address Address of the sensor node
+ */
+void ble_handle_cache_invalidate(const bt_addr_le_t *peer_address)
+{
+    if (k_msgq_put(&handle_cache_invalidate_msgq, peer_address, K_NO_WAIT))
+    {
+        // The node stays cached, its next handle error invalidates it again
+        LOG_INF("Handle cache invalidation queue full");
+        return;
+    }
+
+    k_work_submit(&handle_cache_sync_work);
+}
@@ -0,0 +1,31 @@
+#ifndef BLE_HANDLE_CACHE_H
+#define BLE_HANDLE_CACHE_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdbool.h>
+#include "ble_connection_data.h"
+#include "ble_node_registry.h"
+#include <zephyr/bluetooth/addr.h>
+
+// --- defines -----------------------------------------------------------------
+// How many sensor nodes the cache remembers. In rotation mode every node is
+// connected again and again, so all nodes of the registry are cached
+#ifdef BLE_ROTATION_MODE
+#define BLE_HANDLE_CACHE_SIZE BLE_NODE_REGISTRY_SIZE
+#else
+#define BLE_HANDLE_CACHE_SIZE BLE_MAX_CONNECTIONS
+#endif
+// How many of the cached nodes are also kept in flash (the most recently used ones),
+// the others are discovered again after a reboot. The flash shares NVS with the row
+// control configuration, so it is bounded (see NVS_CAPACITY)
+#define BLE_HANDLE_CACHE_PERSISTED_SIZE MIN(BLE_HANDLE_CACHE_SIZE, BLE_MAX_CONNECTIONS)
+// NVS id of the first persisted cache entry. NVS ids 0 to MAX_CONFIGURATION_ID - 1
+// are used by the row control configuration
+#define BLE_HANDLE_CACHE_NVS_ID_BASE 0x100
+
+// --- function declarations ---------------------------------------------------
+bool ble_handle_cache_restore(const bt_addr_le_t *peer_address, ble_connection_data_t *conn_data);
+void ble_handle_cache_save(const bt_addr_le_t *peer_address, const ble_connection_data_t *conn_data);
+void ble_handle_cache_invalidate(const bt_addr_le_t *peer_address);
+
+#endif // BLE_HANDLE_CACHE_H
@@ -0,0 +1,419 @@
+/*
+ * Description:
+ *
+ * Source file that keeps link quality statistics of every sensor node, keyed by
+ * the node address so that they survive reconnections: RSSI and read latency of
+ * the last read cycles, read timeouts and failures, disconnect reasons and
+ * reconnections, and the GATT read latency histograms of every node and of
+ * every kind of read. They are sent to the cloud with the device info, and
+ * printed by the "ble_latency" shell command
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "ble_link_stats.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+// --- logging settings --------------------------------------------------------
+LOG_MODULE_DECLARE(ble_m);
+
+// --- structs -----------------------------------------------------------------
+typedef struct ble_link_stats_entry_s
+{
+    bool is_valid;
+    // Set on disconnection, so that the next connection counts as a reconnection
+    bool is_disconnected;
+    // Latency (ms) of the last completed read sequence, not sampled yet
+    uint16_t read_latency;
+    link_quality_data_t link_quality;
+} ble_link_stats_entry_t;
+
+// --- static function declarations --------------------------------------------
+static ble_link_stats_entry_t *get_link_stats_entry(const bt_addr_le_t *peer_address, bool is_created);
+static int8_t read_connection_rssi(struct bt_conn *conn);
+static uint8_t get_read_latency_bucket(uint32_t read_latency_us);
+
+// --- static variables definitions --------------------------------------------
+static ble_link_stats_entry_t link_stats_entries[BLE_LINK_STATS_SIZE];
+// Entry replaced when the table is full
+static uint16_t next_replaced_entry;
+// Read latency histograms of every kind of read, over every sensor node
+static uint32_t read_latency_histograms[READ_LATENCY_KIND_COUNT][READ_LATENCY_BUCKET_COUNT];
+// Statistics are updated by the bt callbacks, the measurements thread and read by the cloud thread
+static K_MUTEX_DEFINE(link_stats_mutex);
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Find the link statistics entry of a sensor node. Must be called with
+ *        link_stats_mutex locked
+ *
+ * @param peer_address Address of the sensor node
+ * @param is_created Take a new entry (the oldest one if the table is full) when the node has none
+ * @return entry of the node, NULL if it has none
+ */
+static ble_link_stats_entry_t *get_link_stats_entry(const bt_addr_le_t *peer_address, bool is_created)
+{
+    ble_link_stats_entry_t *entry = NULL;
+
+    for (uint16_t index = 0; index < BLE_LINK_STATS_SIZE; index++)
+    {
+        if (link_stats_entries[index].is_valid && !bt_addr_le_cmp(&link_stats_entries[index].link_quality.peer_address, peer_address))
+        {
+            return &link_stats_entries[index];
+        }
+
+        if (entry == NULL && !link_stats_entries[index].is_valid)
+        {
+            entry = &link_stats_entries[index];
+        }
+    }
+
+    if (!is_created)
+    {
+        return NULL;
+    }
+
+    if (entry == NULL)
+    {
+        entry = &link_stats_entries[next_replaced_entry];
+        next_replaced_entry = (next_replaced_entry + 1) % BLE_LINK_STATS_SIZE;
+    }
+
+    memset(entry, 0, sizeof(ble_link_stats_entry_t));
+    bt_addr_le_copy(&entry->link_quality.peer_address, peer_address);
+    entry->is_valid = true;
+
+    return entry;
+}
+
+/**
+ * @brief Read the RSSI of a connection from the controller. Blocks until the
+ *        controller responds, so it must not be called from the bt callbacks
+ *
+ * @param conn Connection handle
+ * @return RSSI (dBm), LINK_QUALITY_RSSI_UNKNOWN if it could not be read
+ */
+static int8_t read_connection_rssi(struct bt_conn *conn)
+{
+    struct bt_hci_cp_read_rssi *cp;
+    struct bt_hci_rp_read_rssi *rp;
+    struct net_buf *buf;
+    struct net_buf *rsp = NULL;
+    uint16_t handle;
+    int8_t rssi;
+    int err;
+
+    if (bt_hci_get_conn_handle(conn, &handle))
+    {
+        return LINK_QUALITY_RSSI_UNKNOWN;
+    }
+
+    buf = bt_hci_cmd_create(BT_HCI_OP_READ_RSSI, sizeof(*cp));
+    if (buf == NULL)
+    {
+        return LINK_QUALITY_RSSI_UNKNOWN;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(handle);
+
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_RSSI, buf, &rsp);
+    if (err)
+    {
+        LOG_INF("Read RSSI failed (err: %d)", err);
+        return LINK_QUALITY_RSSI_UNKNOWN;
+    }
+
+    rp = (struct bt_hci_rp_read_rssi *)rsp->data;
+    rssi = rp->status ? LINK_QUALITY_RSSI_UNKNOWN : rp->rssi;
+    net_buf_unref(rsp);
+
+    return rssi;
+}
+
+/**
+ * @brief Get the histogram bucket of a read latency (log2 of the latency, see
+ *        READ_LATENCY_BUCKET_COUNT)
+ *
+ * @param read_latency_us Read latency (us)
+ * @return bucket index
+ */
+static uint8_t get_read_latency_bucket(uint32_t read_latency_us)
+{
+    uint8_t bucket = 0;
+    uint32_t scaled_latency = read_latency_us >> READ_LATENCY_BUCKET_0_SHIFT;
+
+    while (scaled_latency > 0 && bucket < READ_LATENCY_BUCKET_COUNT - 1)
+    {
+        scaled_latency >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Count the connection of a sensor node. Called from the connected callback
+ *
+ * @param conn Connection handle
+ */
+void ble_link_stats_connected(struct bt_conn *conn)
+{
+    ble_link_stats_entry_t *entry;
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    entry = get_link_stats_entry(bt_conn_get_dst(conn), true);
+    if (entry->is_disconnected)
+    {
+        entry->is_disconnected = false;
+        entry->link_quality.reconnects++;
+    }
+    k_mutex_unlock(&link_stats_mutex);
+}
+
+/**
+ * @brief Store the disconnect reason of a sensor node. Called from the disconnected callback
+ *
+ * @param conn Connection handle
+ * @param reason HCI reason of the disconnection
+ */
+void ble_link_stats_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    ble_link_stats_entry_t *entry;
+    link_quality_data_t *link_quality;
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    entry = get_link_stats_entry(bt_conn_get_dst(conn), true);
+    link_quality = &entry->link_quality;
+    entry->is_disconnected = true;
+    link_quality->disconnects++;
+    link_quality->disconnect_reasons[link_quality->reason_head] = reason;
+    link_quality->reason_head = (link_quality->reason_head + 1) % LINK_QUALITY_REASON_RING_SIZE;
+    if (link_quality->reason_count < LINK_QUALITY_REASON_RING_SIZE)
+    {
+        link_quality->reason_count++;
+    }
+    k_mutex_unlock(&link_stats_mutex);
+}
+
+/**
+ * @brief Store the latency of a completed read sequence, until the read cycle
+ *        is sampled by ble_link_stats_record_read(). Called from the read callbacks
+ *
+ * @param conn Connection handle
+ * @param read_latency Duration of the read sequence (ms)
+ */
+void ble_link_stats_set_read_latency(struct bt_conn *conn, uint32_t read_latency)
+{
+    ble_link_stats_entry_t *entry;
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    entry = get_link_stats_entry(bt_conn_get_dst(conn), false);
+    if (entry != NULL)
+    {
+        // The last value is reserved for timed out reads
+        entry->read_latency = MIN(read_latency, LINK_QUALITY_LATENCY_TIMEOUT - 1);
+    }
+    k_mutex_unlock(&link_stats_mutex);
+}
+
+/**
+ * @brief Add a sample of the read cycle of a sensor node to its ring: the RSSI
+ *        of the connection and the latency of its read sequence
+ *        Called from the measurements thread after the read cycle
+ *
+ * @param conn Connection handle
+ * @param err 0 if every characteristic was read, -ETIMEDOUT if the read sequence
+ *            timed out, error code otherwise
+ */
+void ble_link_stats_record_read(struct bt_conn *conn, int err)
+{
+    ble_link_stats_entry_t *entry;
+    link_quality_data_t *link_quality;
+    // The controller is asked before locking, the bt callbacks use the same mutex
+    int8_t rssi = read_connection_rssi(conn);
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    entry = get_link_stats_entry(bt_conn_get_dst(conn), true);
+    link_quality = &entry->link_quality;
+    if (err == -ETIMEDOUT)
+    {
+        link_quality->read_timeouts++;
+        entry->read_latency = LINK_QUALITY_LATENCY_TIMEOUT;
+    }
+    else if (err)
+    {
+        link_quality->read_failures++;
+    }
+
+    link_quality->rssi[link_quality->sample_head] = rssi;
+    link_quality->read_latency[link_quality->sample_head] = entry->read_latency;
+    link_quality->sample_head = (link_quality->sample_head + 1) % LINK_QUALITY_RING_SIZE;
+    if (link_quality->sample_count < LINK_QUALITY_RING_SIZE)
+    {
+        link_quality->sample_count++;
+    }
+    entry->read_latency = 0;
+    k_mutex_unlock(&link_stats_mutex);
+}
+
+/**
+ * @brief Count the latency of a GATT read on the histogram of the sensor node and
+ *        on the histogram of the kind of read. Called from the read callbacks
+ *
+ * @param conn Connection handle
+ * @param read_kind Takes values like: READ_LATENCY_KIND_RECORD, or a characteristic index
+ * @param read_latency_us Time from the read request to its response (us)
+ */
+void ble_link_stats_record_read_latency(struct bt_conn *conn, uint8_t read_kind, uint32_t read_latency_us)
+{
+    ble_link_stats_entry_t *entry;
+    uint8_t bucket = get_read_latency_bucket(read_latency_us);
+
+    if (read_kind >= READ_LATENCY_KIND_COUNT)
+    {
+        return;
+    }
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    read_latency_histograms[read_kind][bucket]++;
+    entry = get_link_stats_entry(bt_conn_get_dst(conn), false);
+    if (entry != NULL)
+    {
+        entry->link_quality.read_latency_histogram[bucket]++;
+    }
+    k_mutex_unlock(&link_stats_mutex);
+}
+
+/**
+ * @brief Get the link statistics of a sensor node by index
+ *
+ * @param index Index of the statistics entry (0 to BLE_LINK_STATS_SIZE - 1)
+ * @param link_quality Copy of the statistics
+ * @return true if the entry is used by a sensor node
+ */
+bool ble_link_stats_get(uint16_t index, link_quality_data_t *link_quality)
+{
+    bool is_valid = false;
+
+    if (index >= BLE_LINK_STATS_SIZE)
+    {
+        return false;
+    }
+
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    if (link_stats_entries[index].is_valid)
+    {
+        *link_quality = link_stats_entries[index].link_quality;
+        is_valid = true;
+    }
+    k_mutex_unlock(&link_stats_mutex);
+
+    if (is_valid)
+    {
+        // Kept by the node registry (rotation and telemetry modes)
+        link_quality->sampling_period = ble_node_registry_get_sampling_period(&link_quality->peer_address);
+    }
+
+    return is_valid;
+}
+
+/**
+ * @brief Get the read latency histogram of a kind of read, over every sensor node
+ *
+ * @param read_kind Takes values like: READ_LATENCY_KIND_RECORD, or a characteristic index
+ * @param read_latency Copy of the histogram
+ * @return true if at least one read of this kind was counted
+ */
+bool ble_link_stats_get_read_latency(uint8_t read_kind, read_latency_data_t *read_latency)
+{
+    uint32_t read_count = 0;
+
+    if (read_kind >= READ_LATENCY_KIND_COUNT)
+    {
+        return false;
+    }
+
+    read_latency->read_kind = read_kind;
+    k_mutex_lock(&link_stats_mutex, K_FOREVER);
+    for (uint8_t bucket = 0; bucket < READ_LATENCY_BUCKET_COUNT; bucket++)
+    {
+        read_latency->read_latency_histogram[bucket] = read_latency_histograms[read_kind][bucket];
+        read_count += read_latency_histograms[read_kind][bucket];
+    }
+    k_mutex_unlock(&link_stats_mutex);
+
+    return read_count > 0;
+}
+
+#ifdef CONFIG_SHELL
+/**
+ * @brief Print a read latency histogram on the shell, one column per bucket
+ *
+ * @param sh Shell instance
+ * @param name Name of the histogram (kind of read, or node address)
+ * @param histogram Histogram with READ_LATENCY_BUCKET_COUNT buckets
+ */
+static void print_read_latency_histogram(const struct shell *sh, const char *name, const uint32_t *histogram)
+{
+    shell_fprintf(sh, SHELL_NORMAL, "%-30s", name);
+    for (uint8_t bucket = 0; bucket < READ_LATENCY_BUCKET_COUNT; bucket++)
+    {
+        shell_fprintf(sh, SHELL_NORMAL, " %8u", histogram[bucket]);
+    }
+    shell_fprintf(sh, SHELL_NORMAL, "\n");
+}
+
+/**
+ * @brief Shell command that prints the read latency histograms of every kind of
+ *        read and of every sensor node
+ *
+ */
+static int cmd_ble_latency(const struct shell *sh, size_t argc, char **argv)
+{
+    static const char *const read_kind_names[READ_LATENCY_KIND_COUNT] = {
+        "temperature", "humidity", "soil moisture", "light intensity",
+        "configuration", "battery", "measurement record", "read multiple"};
+    read_latency_data_t read_latency;
+    link_quality_data_t link_quality;
+    char addr[BT_ADDR_LE_STR_LEN];
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    // Every bucket counts the reads under its limit, that the previous buckets did not count
+    shell_fprintf(sh, SHELL_NORMAL, "%-30s", "limit (us)");
+    for (uint8_t bucket = 0; bucket < READ_LATENCY_BUCKET_COUNT - 1; bucket++)
+    {
+        shell_fprintf(sh, SHELL_NORMAL, " %8u", (unsigned int)BIT(READ_LATENCY_BUCKET_0_SHIFT + bucket));
+    }
+    shell_fprintf(sh, SHELL_NORMAL, " %8s\n", "-");
+    for (uint8_t read_kind = 0; read_kind < READ_LATENCY_KIND_COUNT; read_kind++)
+    {
+        ble_link_stats_get_read_latency(read_kind, &read_latency);
+        print_read_latency_histogram(sh, read_kind_names[read_kind], read_latency.read_latency_histogram);
+    }
+    for (uint16_t index = 0; index < BLE_LINK_STATS_SIZE; index++)
+    {
+        if (ble_link_stats_get(index, &link_quality))
+        {
+            bt_addr_le_to_str(&link_quality.peer_address, addr, sizeof(addr));
+            print_read_latency_histogram(sh, addr, link_quality.read_latency_histogram);
+        }
+    }
+
+    return 0;
+}
+
+SHELL_CMD_REGISTER(ble_latency, NULL, "Print the GATT read latency histograms", cmd_ble_latency);
+#endif // CONFIG_SHELL
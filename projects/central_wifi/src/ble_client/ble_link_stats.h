@@ -0,0 +1,29 @@
+#ifndef BLE_LINK_STATS_H
+#define BLE_LINK_STATS_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdbool.h>
+#include "common.h"
+#include "ble_connection_data.h"
+#include "ble_node_registry.h"
+#include <zephyr/bluetooth/conn.h>
+
+// --- defines -----------------------------------------------------------------
+// How many sensor nodes have link statistics. In rotation mode every node of the
+// registry is connected in turn
+#ifdef BLE_ROTATION_MODE
+#define BLE_LINK_STATS_SIZE BLE_NODE_REGISTRY_SIZE
+#else
+#define BLE_LINK_STATS_SIZE BLE_MAX_CONNECTIONS
+#endif
+
+// --- function declarations ---------------------------------------------------
+void ble_link_stats_connected(struct bt_conn *conn);
+void ble_link_stats_disconnected(struct bt_conn *conn, uint8_t reason);
+void ble_link_stats_set_read_latency(struct bt_conn *conn, uint32_t read_latency);
+void ble_link_stats_record_read(struct bt_conn *conn, int err);
+bool ble_link_stats_get(uint16_t index, link_quality_data_t *link_quality);
+void ble_link_stats_record_read_latency(struct bt_conn *conn, uint8_t read_kind, uint32_t read_latency_us);
+bool ble_link_stats_get_read_latency(uint8_t read_kind, read_latency_data_t *read_latency);
+
+#endif // BLE_LINK_STATS_H
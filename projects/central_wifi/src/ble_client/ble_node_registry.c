@@ -0,0 +1,298 @@
+/*
+ * Description:
+ *
+ * Source file that keeps every sensor node seen by the scanner when the central
+ * serves more nodes than it can keep connected (rotation mode), or when nodes
+ * advertise their measurements (telemetry mode). The scheduler always picks the
+ * node that waited the longest, so every node is sampled with about the same period
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "ble_node_registry.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+// --- logging settings --------------------------------------------------------
+LOG_MODULE_DECLARE(ble_m);
+
+// --- structs -----------------------------------------------------------------
+typedef struct ble_node_s
+{
+    bt_addr_le_t addr;
+    // Uptime (ms) the node was last reported by the scanner
+    int64_t last_seen_time;
+    // Uptime (ms) of the last connection attempt, used for scheduling
+    int64_t last_attempt_time;
+    // Uptime (ms) the node was last read successfully
+    int64_t last_served_time;
+    // Achieved sampling period (ms), averaged over the last services
+    uint32_t sampling_period;
+    // true from the time the node is scheduled until it is served or failed
+    bool is_in_service;
+    // false for nodes that only advertise their measurements (telemetry mode)
+    bool is_connectable;
+} ble_node_t;
+
+// --- static function declarations --------------------------------------------
+static uint16_t find_node(const bt_addr_le_t *addr);
+static uint16_t find_stale_node(int64_t now);
+
+// --- static variables definitions --------------------------------------------
+static ble_node_t nodes[BLE_NODE_REGISTRY_SIZE];
+static uint16_t nodes_count;
+// Registry is filled by the bt rx thread and used by the ble threads
+static K_MUTEX_DEFINE(node_registry_mutex);
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Find the registry index of a sensor node. Must be called with
+ *        node_registry_mutex locked
+ *
+ * @param addr Address of the sensor node
+ * @return registry index, BLE_NODE_INVALID_INDEX if the node is not registered
+ */
+static uint16_t find_node(const bt_addr_le_t *addr)
+{
+    for (uint16_t index = 0; index < nodes_count; index++)
+    {
+        if (!bt_addr_le_cmp(&nodes[index].addr, addr))
+        {
+            return index;
+        }
+    }
+
+    return BLE_NODE_INVALID_INDEX;
+}
+
+/**
+ * @brief Find the node that was not seen for the longest time, if it is stale
+ *        (not seen for BLE_NODE_STALE_TIMEOUT_MS) and not being served. Must be
+ *        called with node_registry_mutex locked
+ *
+ * @param now Uptime (ms)
+ * @return registry index, BLE_NODE_INVALID_INDEX if no node is stale
+ */
+static uint16_t find_stale_node(int64_t now)
+{
+    uint16_t stale_index = BLE_NODE_INVALID_INDEX;
+
+    for (uint16_t index = 0; index < nodes_count; index++)
+    {
+        if (nodes[index].is_in_service || (now - nodes[index].last_seen_time) <= BLE_NODE_STALE_TIMEOUT_MS)
+        {
+            continue;
+        }
+
+        if (stale_index == BLE_NODE_INVALID_INDEX || nodes[index].last_seen_time < nodes[stale_index].last_seen_time)
+        {
+            stale_index = index;
+        }
+    }
+
+    return stale_index;
+}
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Add a sensor node reported by the scanner to the registry, or refresh
+ *        the time it was last seen if it is already registered. When the registry
+ *        is full, the new node takes the index of the stalest node (not seen for
+ *        BLE_NODE_STALE_TIMEOUT_MS)
+ *
+ * @param addr Address of the sensor node
+ * @param is_connectable true if the node can be scheduled for a connection
+ * @param node_index Filled with the registry index of the node (can be NULL),
+ *        BLE_NODE_INVALID_INDEX if the registry is full of nodes that are not stale
+ * @return true if the node is new to the registry
+ */
+bool ble_node_registry_add(const bt_addr_le_t *addr, bool is_connectable, uint16_t *node_index)
+{
+    int64_t now = k_uptime_get();
+    bool is_new = false;
+    uint16_t index;
+
+    k_mutex_lock(&node_registry_mutex, K_FOREVER);
+    index = find_node(addr);
+    if (index == BLE_NODE_INVALID_INDEX)
+    {
+        if (nodes_count < BLE_NODE_REGISTRY_SIZE)
+        {
+            index = nodes_count++;
+        }
+        else
+        {
+            index = find_stale_node(now);
+        }
+
+        if (index == BLE_NODE_INVALID_INDEX)
+        {
+            k_mutex_unlock(&node_registry_mutex);
+            if (node_index != NULL)
+            {
+                *node_index = BLE_NODE_INVALID_INDEX;
+            }
+            LOG_INF("Node registry is full");
+            return false;
+        }
+
+        // A stale node loses its index (and its measurements slot) to the new one
+        memset(&nodes[index], 0, sizeof(ble_node_t));
+        bt_addr_le_copy(&nodes[index].addr, addr);
+        is_new = true;
+    }
+    nodes[index].last_seen_time = now;
+    nodes[index].is_connectable = is_connectable;
+    k_mutex_unlock(&node_registry_mutex);
+
+    if (node_index != NULL)
+    {
+        *node_index = index;
+    }
+
+    return is_new;
+}
+
+/**
+ * @brief Fairness scheduler: pick the node to connect to next. That is the node
+ *        whose last connection attempt is the oldest, as long as it is connectable,
+ *        not being served already, seen recently and its minimum service period passed
+ *
+ * @param addr Filled with the address of the scheduled node
+ * @param node_index Filled with the registry index of the scheduled node
+ * @return true if a node was scheduled, false if no node is due
+ */
+bool ble_node_registry_schedule(bt_addr_le_t *addr, uint16_t *node_index)
+{
+    int64_t now = k_uptime_get();
+    uint16_t scheduled_index = BLE_NODE_INVALID_INDEX;
+
+    k_mutex_lock(&node_registry_mutex, K_FOREVER);
+    for (uint16_t index = 0; index < nodes_count; index++)
+    {
+        if (!nodes[index].is_connectable || nodes[index].is_in_service ||
+            (now - nodes[index].last_seen_time) > BLE_NODE_STALE_TIMEOUT_MS ||
+            (nodes[index].last_attempt_time != 0 && (now - nodes[index].last_attempt_time) < BLE_NODE_MIN_SERVICE_PERIOD_MS))
+        {
+            continue;
+        }
+
+        if (scheduled_index == BLE_NODE_INVALID_INDEX ||
+            nodes[index].last_attempt_time < nodes[scheduled_index].last_attempt_time)
+        {
+            scheduled_index = index;
+        }
+    }
+
+    if (scheduled_index != BLE_NODE_INVALID_INDEX)
+    {
+        nodes[scheduled_index].is_in_service = true;
+        nodes[scheduled_index].last_attempt_time = now;
+        bt_addr_le_copy(addr, &nodes[scheduled_index].addr);
+        *node_index = scheduled_index;
+    }
+    k_mutex_unlock(&node_registry_mutex);
+
+    return scheduled_index != BLE_NODE_INVALID_INDEX;
+}
+
+/**
+ * @brief Release a scheduled node. If it was read, its achieved sampling period
+ *        is updated
+ *
+ * @param node_index Registry index of the node
+ * @param is_served true if the node was read, false if connection or read failed
+ */
+void ble_node_registry_set_served(uint16_t node_index, bool is_served)
+{
+    int64_t now = k_uptime_get();
+    uint32_t interval;
+
+    if (node_index >= BLE_NODE_REGISTRY_SIZE)
+    {
+        return;
+    }
+
+    k_mutex_lock(&node_registry_mutex, K_FOREVER);
+    nodes[node_index].is_in_service = false;
+    if (is_served)
+    {
+        if (nodes[node_index].last_served_time != 0)
+        {
+            interval = (uint32_t)(now - nodes[node_index].last_served_time);
+            // Moving average over the last services: period = 3/4 period + 1/4 interval
+            nodes[node_index].sampling_period = nodes[node_index].sampling_period == 0 ? interval :
+                                                (3 * nodes[node_index].sampling_period + interval) / 4;
+        }
+        nodes[node_index].last_served_time = now;
+    }
+    k_mutex_unlock(&node_registry_mutex);
+}
+
+/**
+ * @brief Get the number of registered sensor nodes
+ *
+ * @return uint16_t
+ */
+uint16_t ble_node_registry_count(void)
+{
+    return nodes_count;
+}
+
+/**
+ * @brief Get the achieved sampling period of a node
+ *
+ * @param addr Address of the sensor node
+ * @return sampling period in ms, 0 if the node is not registered or was not served twice yet
+ */
+uint32_t ble_node_registry_get_sampling_period(const bt_addr_le_t *addr)
+{
+    uint32_t sampling_period = 0;
+    uint16_t index;
+
+    k_mutex_lock(&node_registry_mutex, K_FOREVER);
+    index = find_node(addr);
+    if (index != BLE_NODE_INVALID_INDEX)
+    {
+        sampling_period = nodes[index].sampling_period;
+    }
+    k_mutex_unlock(&node_registry_mutex);
+
+    return sampling_period;
+}
+
+/**
+ * @brief Log the achieved sampling period of the registered nodes (min, mean, max)
+ *
+ */
+void ble_node_registry_log_sampling_periods(void)
+{
+    uint32_t min_period = UINT32_MAX;
+    uint32_t max_period = 0;
+    uint64_t sum_period = 0;
+    uint16_t sampled_nodes = 0;
+
+    k_mutex_lock(&node_registry_mutex, K_FOREVER);
+    for (uint16_t index = 0; index < nodes_count; index++)
+    {
+        if (nodes[index].sampling_period == 0)
+        {
+            continue;
+        }
+
+        min_period = MIN(min_period, nodes[index].sampling_period);
+        max_period = MAX(max_period, nodes[index].sampling_period);
+        sum_period += nodes[index].sampling_period;
+        sampled_nodes++;
+    }
+    k_mutex_unlock(&node_registry_mutex);
+
+    if (sampled_nodes == 0)
+    {
+        return;
+    }
+
+    LOG_INF("Nodes: %d, sampling period (ms) min: %u, mean: %u, max: %u", nodes_count, min_period,
+            (uint32_t)(sum_period / sampled_nodes), max_period);
+}
@@ -0,0 +1,27 @@
+#ifndef BLE_NODE_REGISTRY_H
+#define BLE_NODE_REGISTRY_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+// --- defines -----------------------------------------------------------------
+// How many sensor nodes a gateway can serve in rotation mode
+#define BLE_NODE_REGISTRY_SIZE 256
+// A node is not connected again before this time passed since its last connection attempt
+#define BLE_NODE_MIN_SERVICE_PERIOD_MS 15000
+// A node that was not seen advertising for this time is not scheduled anymore
+#define BLE_NODE_STALE_TIMEOUT_MS (10 * 60 * 1000)
+// Value returned when a node is not on the registry
+#define BLE_NODE_INVALID_INDEX 0xFFFF
+
+// --- function declarations ---------------------------------------------------
+bool ble_node_registry_add(const bt_addr_le_t *addr, bool is_connectable, uint16_t *node_index);
+bool ble_node_registry_schedule(bt_addr_le_t *addr, uint16_t *node_index);
+void ble_node_registry_set_served(uint16_t node_index, bool is_served);
+uint16_t ble_node_registry_count(void);
+uint32_t ble_node_registry_get_sampling_period(const bt_addr_le_t *addr);
+void ble_node_registry_log_sampling_periods(void);
+
+#endif // BLE_NODE_REGISTRY_H
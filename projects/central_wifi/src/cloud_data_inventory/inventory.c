@@ -1,6 +1,8 @@
 // --- includes ----------------------------------------------------------------
 #include "inventory.h"
 #include "../../common/common.h"
+#include "ble_client/ble_link_stats.h"
+#include "measurements/measurements_data_storage.h"
 #include <stdint.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/logging/log.h>
@@ -8,17 +10,26 @@
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(inventory_m);
 
-// --- defines -----------------------------------------------------------------
-#define BLE_MAX_CONNECTIONS 20
-
 // --- static variables definitions --------------------------------------------
 // Buffer to store measurements from sensor nodes. Size of the buffer ==
-// max simultaneous sensor node connections
-static measurements_data_t measurements_inventory[BLE_MAX_CONNECTIONS];
-static uint8_t measurements_inventory_fill_index = 0;
+// sensor nodes measured by the central (every node of the registry in rotation
+// and telemetry modes)
+static measurements_data_t measurements_inventory[MEASUREMENT_DATA_SIZE];
+static uint16_t measurements_inventory_fill_index = 0;
 // Buffer to store the mean measurements for each row
 // The indexing for this buffer is: row id = 1 -> row_mean_data_inventory[0]
 static row_mean_data_t row_mean_data_inventory[MAX_CONFIGURATION_ID];
+// Rows stored on row_mean_data_inventory (row bitmap)
+static uint8_t row_mean_data_inventory_rows[ROW_BITMAP_SIZE];
+// Buffer to store the link quality statistics of every sensor node (device info)
+static link_quality_data_t link_quality_inventory[BLE_LINK_STATS_SIZE];
+static uint16_t link_quality_inventory_fill_index = 0;
+// Buffer to store the read latency histogram of every kind of read (device info)
+static read_latency_data_t read_latency_inventory[READ_LATENCY_KIND_COUNT];
+static uint8_t read_latency_inventory_fill_index = 0;
+// Buffer to store the rolling window statistics of every row
+// The indexing for this buffer is: row id = 1 -> row_window_inventory[0], row id = 0 if not stored
+static row_window_data_t row_window_inventory[MAX_CONFIGURATION_ID];
 
 // --- functions definitions ---------------------------------------------------
 /**
@@ -26,7 +37,7 @@ static row_mean_data_t row_mean_data_inventory[MAX_CONFIGURATION_ID];
  *        This function fills measurements inventory. If the inventory is full,
  *        we will just log that it is full. This inventory should be erased
  *        after sending it to cloud
- *        52840 can send at most BLE_MAX_CONNECTIONS measurements messages, and
+ *        52840 can send at most MEASUREMENT_DATA_SIZE measurements messages, and
  *        after that, 52840 should notify 9160 to send the data to cloud and reset
  *        the inventory buffer
  *
@@ -36,7 +47,7 @@ static row_mean_data_t row_mean_data_inventory[MAX_CONFIGURATION_ID];
 uint8_t store_measurement_message(message_measurement_data_t *msg_to_store)
 {
     uint8_t ret = GENERIC_ERROR;
-    if (measurements_inventory_fill_index < BLE_MAX_CONNECTIONS)
+    if (measurements_inventory_fill_index < MEASUREMENT_DATA_SIZE)
     {
         memcpy(&measurements_inventory[measurements_inventory_fill_index], &msg_to_store->message_buffer, sizeof(measurements_data_t));
         measurements_inventory_fill_index++;
@@ -67,9 +78,10 @@ uint8_t store_row_mean_data_message(message_row_mean_data_t *msg_to_store)
 {
     uint8_t ret = FAILURE;
 
-    if (msg_to_store->message_buffer.row_id <= MAX_CONFIGURATION_ID || msg_to_store->message_buffer.row_id > 0)
+    if (msg_to_store->message_buffer.row_id <= MAX_CONFIGURATION_ID && msg_to_store->message_buffer.row_id > 0)
     {
         memcpy(&row_mean_data_inventory[msg_to_store->message_buffer.row_id - 1], &msg_to_store->message_buffer, sizeof(row_mean_data_t));
+        ROW_BITMAP_SET(row_mean_data_inventory_rows, msg_to_store->message_buffer.row_id - 1);
         ret = SUCCESS;
     }
     else
@@ -81,6 +93,65 @@ uint8_t store_row_mean_data_message(message_row_mean_data_t *msg_to_store)
     return ret;
 }
 
+/**
+ * @brief Function to store the link quality statistics of a sensor node.
+ *        This inventory should be erased after sending it to cloud
+ *
+ * @param data_to_store
+ * @return error code
+ */
+uint8_t store_link_quality_data(const link_quality_data_t *data_to_store)
+{
+    if (link_quality_inventory_fill_index >= BLE_LINK_STATS_SIZE)
+    {
+        return GENERIC_ERROR;
+    }
+
+    memcpy(&link_quality_inventory[link_quality_inventory_fill_index], data_to_store, sizeof(link_quality_data_t));
+    link_quality_inventory_fill_index++;
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Function to store the read latency histogram of a kind of read.
+ *        This inventory should be erased after sending it to cloud
+ *
+ * @param data_to_store
+ * @return error code
+ */
+uint8_t store_read_latency_data(const read_latency_data_t *data_to_store)
+{
+    if (read_latency_inventory_fill_index >= READ_LATENCY_KIND_COUNT)
+    {
+        return GENERIC_ERROR;
+    }
+
+    memcpy(&read_latency_inventory[read_latency_inventory_fill_index], data_to_store, sizeof(read_latency_data_t));
+    read_latency_inventory_fill_index++;
+
+    return SUCCESS;
+}
+
+/**
+ * @brief Function to store the rolling window statistics of a row.
+ *        This inventory should be erased after sending it to cloud
+ *
+ * @param data_to_store
+ * @return error code
+ */
+uint8_t store_row_window_data(const row_window_data_t *data_to_store)
+{
+    if (data_to_store->row_id == 0 || data_to_store->row_id > MAX_CONFIGURATION_ID)
+    {
+        return FAILURE;
+    }
+
+    memcpy(&row_window_inventory[data_to_store->row_id - 1], data_to_store, sizeof(row_window_data_t));
+
+    return SUCCESS;
+}
+
 /**
  * @brief Get the row mean data inventory object
  * 
@@ -91,6 +162,16 @@ row_mean_data_t *get_row_mean_data_inventory(void)
     return row_mean_data_inventory;
 }
 
+/**
+ * @brief Get the rows stored on the row mean data inventory
+ * 
+ * @return const uint8_t* row bitmap of ROW_BITMAP_SIZE bytes
+ */
+const uint8_t *get_row_mean_data_inventory_rows(void)
+{
+    return row_mean_data_inventory_rows;
+}
+
 /**
  * @brief Get the measurements data inventory object
  * 
@@ -107,7 +188,7 @@ measurements_data_t *get_measurements_data_inventory(void)
  */
 void reset_measurements_inventory(void)
 {
-    memset(measurements_inventory, 0, sizeof(measurements_data_t) * BLE_MAX_CONNECTIONS);
+    memset(measurements_inventory, 0, sizeof(measurements_inventory));
     measurements_inventory_fill_index = 0;
 }
 
@@ -118,4 +199,68 @@ void reset_measurements_inventory(void)
 void reset_row_mean_data_inventory(void)
 {
     memset(row_mean_data_inventory, 0, sizeof(row_mean_data_t) * MAX_CONFIGURATION_ID);
+    memset(row_mean_data_inventory_rows, 0, sizeof(row_mean_data_inventory_rows));
+}
+
+/**
+ * @brief Get the link quality inventory object
+ * 
+ * @param count Number of stored sensor nodes
+ * @return link_quality_data_t* 
+ */
+link_quality_data_t *get_link_quality_inventory(uint16_t *count)
+{
+    *count = link_quality_inventory_fill_index;
+    return link_quality_inventory;
+}
+
+/**
+ * @brief Reset link quality inventory
+ *
+ */
+void reset_link_quality_inventory(void)
+{
+    memset(link_quality_inventory, 0, sizeof(link_quality_inventory));
+    link_quality_inventory_fill_index = 0;
+}
+
+/**
+ * @brief Get the read latency inventory object
+ * 
+ * @param count Number of stored kinds of read
+ * @return read_latency_data_t* 
+ */
+read_latency_data_t *get_read_latency_inventory(uint8_t *count)
+{
+    *count = read_latency_inventory_fill_index;
+    return read_latency_inventory;
+}
+
+/**
+ * @brief Reset read latency inventory
+ *
+ */
+void reset_read_latency_inventory(void)
+{
+    memset(read_latency_inventory, 0, sizeof(read_latency_data_t) * READ_LATENCY_KIND_COUNT);
+    read_latency_inventory_fill_index = 0;
+}
+
+/**
+ * @brief Get the row window inventory object
+ * 
+ * @return row_window_data_t* 
+ */
+row_window_data_t *get_row_window_inventory(void)
+{
+    return row_window_inventory;
+}
+
+/**
+ * @brief Reset row window inventory
+ *
+ */
+void reset_row_window_inventory(void)
+{
+    memset(row_window_inventory, 0, sizeof(row_window_data_t) * MAX_CONFIGURATION_ID);
 }
\ No newline at end of file
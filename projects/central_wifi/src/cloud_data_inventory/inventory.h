@@ -7,9 +7,19 @@
 // --- functions declarations --------------------------------------------------
 uint8_t store_measurement_message(message_measurement_data_t *msg_to_store);
 uint8_t store_row_mean_data_message(message_row_mean_data_t *msg_to_store);
+uint8_t store_link_quality_data(const link_quality_data_t *data_to_store);
+uint8_t store_read_latency_data(const read_latency_data_t *data_to_store);
+uint8_t store_row_window_data(const row_window_data_t *data_to_store);
 void reset_measurements_inventory(void);
 void reset_row_mean_data_inventory(void);
 row_mean_data_t* get_row_mean_data_inventory(void);
+const uint8_t *get_row_mean_data_inventory_rows(void);
 measurements_data_t *get_measurements_data_inventory(void);
+link_quality_data_t *get_link_quality_inventory(uint16_t *count);
+void reset_link_quality_inventory(void);
+read_latency_data_t *get_read_latency_inventory(uint8_t *count);
+void reset_read_latency_inventory(void);
+row_window_data_t *get_row_window_inventory(void);
+void reset_row_window_inventory(void);
 
 #endif // INVENTORY_H
\ No newline at end of file
@@ -31,7 +31,7 @@ enum ble_state_e
     COAP_CLIENT_INIT,
     // Send mean row data to cloud
     COAP_CLIENT_SEND_MEAS,
-    // Send device info to cloud (battery/mac)
+    // Send device info to cloud (battery/mac/link quality)
     COAP_CLIENT_SEND_DEV_INFO,
     // FSM sleep and wait for event
     COAP_CLIENT_WAIT,
@@ -69,7 +69,12 @@ struct user_object_s
     // This must be first
     struct smf_ctx ctx;
     row_mean_data_t *row_mean_data_inventory;
+    row_window_data_t *row_window_inventory;
     measurements_data_t *measurements_data_inventory;
+    link_quality_data_t *link_quality_inventory;
+    uint16_t link_quality_count;
+    read_latency_data_t *read_latency_inventory;
+    uint8_t read_latency_count;
 } coap_fsm_user_object;
 
 // --- static function definitions ---------------------------------------------
@@ -112,6 +117,7 @@ static void coap_client_send_meas_entry(void *o)
     struct user_object_s *user_ctx = (struct user_object_s *)o;
     // Get latest row mean data inventory
     user_ctx->row_mean_data_inventory = get_row_mean_data_inventory();
+    user_ctx->row_window_inventory = get_row_window_inventory();
 }
 static void coap_client_send_meas_run(void *o)
 {
@@ -121,22 +127,27 @@ static void coap_client_send_meas_run(void *o)
     struct user_object_s *user_ctx = (struct user_object_s *)o;
     // Define the coap resource to send the data
     char resource[] = "rowmeandata";
+    char row_window_resource[] = "rowwindow";
 
     message_coap_row_mean_data_t coap_msg_buffer = {0};
+    message_coap_row_window_t coap_row_window_msg_buffer = {0};
+    uint16_t index;
 
-    // Go through the row mean data inventory and for every registered row
+    // Go through the row mean data inventory and for every stored (registered) row
     // send the data to cloud. A row will be registered if 52840 sent data for it
     LOG_INF("SEND_TO_CLOUD --- %d", log_counter);
-    for (int index = 0; index < MAX_CONFIGURATION_ID; index++)
+    ROW_BITMAP_FOR_EACH(get_row_mean_data_inventory_rows(), index)
     {
-        // Check if row is registered
-        if (user_ctx->row_mean_data_inventory[index].is_row_registered)
+        // Construct the coap message
+        create_coap_row_mean_data_message(&user_ctx->row_mean_data_inventory[index], &coap_msg_buffer, get_timestamp());
+        LOG_INF("row_num: %d; temperature: %d; idx: %d", user_ctx->row_mean_data_inventory[index].row_id,user_ctx->row_mean_data_inventory[index].mean.temperature, log_counter);
+        // Send the coap message to coap server
+        coap_put((uint8_t *)resource, strlen(resource), (uint8_t *)&coap_msg_buffer, sizeof(message_coap_row_mean_data_t));
+        // And the statistics of its recent row values, if they were stored
+        if (user_ctx->row_window_inventory[index].row_id != 0)
         {
-            // Construct the coap message
-            create_coap_row_mean_data_message(&user_ctx->row_mean_data_inventory[index], &coap_msg_buffer, get_timestamp());
-            LOG_INF("row_num: %d; temperature: %d; idx: %d", user_ctx->row_mean_data_inventory[index].row_id,user_ctx->row_mean_data_inventory[index].mean_row_temp, log_counter);
-            // Send the coap message to coap server
-            coap_put((uint8_t *)resource, strlen(resource), (uint8_t *)&coap_msg_buffer, sizeof(message_coap_row_mean_data_t));
+            create_coap_row_window_message(&user_ctx->row_window_inventory[index], &coap_row_window_msg_buffer, get_timestamp());
+            coap_put((uint8_t *)row_window_resource, strlen(row_window_resource), (uint8_t *)&coap_row_window_msg_buffer, sizeof(message_coap_row_window_t));
         }
     }
     log_counter++;
@@ -147,6 +158,7 @@ static void coap_client_send_meas_exit(void *o)
 {
     // After sending the data to coap cloud server, clear the inventories
     reset_row_mean_data_inventory();
+    reset_row_window_inventory();
 }
 
 // --- State COAP_CLIENT_SEND_DEV_INFO
@@ -155,17 +167,39 @@ static void coap_client_send_dev_info_entry(void *o)
     struct user_object_s *user_ctx = (struct user_object_s *)o;
     // Get latest row mean data inventory
     user_ctx->measurements_data_inventory = get_measurements_data_inventory();
+    user_ctx->link_quality_inventory = get_link_quality_inventory(&user_ctx->link_quality_count);
+    user_ctx->read_latency_inventory = get_read_latency_inventory(&user_ctx->read_latency_count);
 }
 static void coap_client_send_dev_info_run(void *o)
 {
-    // if(send)
-    // send
+    struct user_object_s *user_ctx = (struct user_object_s *)o;
+    // Define the coap resource to send the data
+    char resource[] = "deviceinfo";
+    char read_latency_resource[] = "readlatency";
+
+    message_coap_device_info_t coap_msg_buffer = {0};
+    message_coap_read_latency_t coap_read_latency_msg_buffer = {0};
+
+    // Send the link quality of every sensor node, to spot badly placed nodes
+    for (int index = 0; index < user_ctx->link_quality_count; index++)
+    {
+        create_coap_device_info_message(&user_ctx->link_quality_inventory[index], &coap_msg_buffer, get_timestamp());
+        coap_put((uint8_t *)resource, strlen(resource), (uint8_t *)&coap_msg_buffer, sizeof(message_coap_device_info_t));
+    }
+    // And where the read cycle time goes, by kind of read
+    for (int index = 0; index < user_ctx->read_latency_count; index++)
+    {
+        create_coap_read_latency_message(&user_ctx->read_latency_inventory[index], &coap_read_latency_msg_buffer, get_timestamp());
+        coap_put((uint8_t *)read_latency_resource, strlen(read_latency_resource), (uint8_t *)&coap_read_latency_msg_buffer, sizeof(message_coap_read_latency_t));
+    }
     smf_set_state(SMF_CTX(&coap_fsm_user_object), &coap_client_states[COAP_CLIENT_WAIT]);
 }
 static void coap_client_send_dev_info_exit(void *o)
 {
     // This should be cleared on the coap client send dev info state
     reset_measurements_inventory();
+    reset_link_quality_inventory();
+    reset_read_latency_inventory();
 }
 
 // --- State COAP_CLIENT_WAIT
@@ -28,7 +28,7 @@ uint8_t process_coap_rx_message(const uint8_t *rx_buf)
     case MESSAGE_COAP_ROW_CONTROL_USER_DATA:
         p_msg_coap_row_control_user_data = (message_coap_row_control_user_data_t *)rx_buf;
         // Set the user data on the environment control module
-        // NOTE: p_msg_coap_row_user_data->row_id - 1 is used as user will send the message with row ids from 1 to 5
+        // NOTE: p_msg_coap_row_user_data->row_id - 1 is used as user will send the message with row ids from 1 to MAX_CONFIGURATION_ID
         // but the following functions use this row id to index the row_control_config[]
         set_row_automatic_control(p_msg_coap_row_control_user_data->is_automatic_control, p_msg_coap_row_control_user_data->row_id - 1);
         set_row_fan_switch(p_msg_coap_row_control_user_data->is_fan_active, p_msg_coap_row_control_user_data->row_id - 1);
@@ -17,7 +17,31 @@ LOG_MODULE_DECLARE(environment_control_m);
 // All of this data are evaluated by environment_control_fsm which in turn will
 // call the necessary functions in order to turn on/off the fan/light/water for
 // each row
-static row_status_t row_control_config[MAX_CONFIGURATION_ID];
+// The rows are stored as a structure of arrays (indexed by row id - 1) and the
+// switches as row bitmaps, so that many rows stay compact and a pass over the
+// registered rows skips the others cheaply
+static struct row_status_table_s
+{
+    // mean measurements of every row
+    int32_t temp[MAX_CONFIGURATION_ID];
+    int32_t hum[MAX_CONFIGURATION_ID];
+    int32_t soil_moisture[MAX_CONFIGURATION_ID];
+    int32_t light_exposure[MAX_CONFIGURATION_ID];
+    // trend of the row values over the last measurement cycles
+    row_window_data_t window[MAX_CONFIGURATION_ID];
+    // user thresholds for automatic control
+    int32_t temp_threshold[MAX_CONFIGURATION_ID];
+    int32_t humidity_threshold[MAX_CONFIGURATION_ID];
+    int32_t light_threshold[MAX_CONFIGURATION_ID];
+    int32_t soil_moisture_threshold[MAX_CONFIGURATION_ID];
+    // rows with at least one sensor node
+    uint8_t registered[ROW_BITMAP_SIZE];
+    // user switches, and automatic/manual control
+    uint8_t fan_switch[ROW_BITMAP_SIZE];
+    uint8_t water_switch[ROW_BITMAP_SIZE];
+    uint8_t light_switch[ROW_BITMAP_SIZE];
+    uint8_t automatic_control[ROW_BITMAP_SIZE];
+} row_status_table;
 // It is initialized inside of initialize_row_control_configuration
 static struct k_work store_row_config_params_work;
 // index to know which row id params changed
@@ -26,6 +50,8 @@ static uint8_t row_id_params_changed;
 // --- static functions declarations ------------------------------------------
 static void store_row_config_params_handler(struct k_work *work);
 static void store_row_config_params_in_nvs(uint8_t row_id);
+static void get_row_control(uint8_t row_id, row_control_t *row_control);
+static void set_row_control(uint8_t row_id, const row_control_t *row_control);
 
 // --- static functions definitions --------------------------------------------
 /**
@@ -39,6 +65,42 @@ static void store_row_config_params_handler(struct k_work *work)
     store_row_config_params_in_nvs(row_id_params_changed);
 }
 
+/**
+ * @brief Gather the user parameters of a row, as they are stored in flash
+ *
+ * @param row_id Row index
+ * @param row_control
+ */
+static void get_row_control(uint8_t row_id, row_control_t *row_control)
+{
+    row_control->fan_switch = ROW_BITMAP_TEST(row_status_table.fan_switch, row_id);
+    row_control->water_switch = ROW_BITMAP_TEST(row_status_table.water_switch, row_id);
+    row_control->light_switch = ROW_BITMAP_TEST(row_status_table.light_switch, row_id);
+    row_control->automatic_control = ROW_BITMAP_TEST(row_status_table.automatic_control, row_id);
+    row_control->temp_threshold = row_status_table.temp_threshold[row_id];
+    row_control->humidity_threshold = row_status_table.humidity_threshold[row_id];
+    row_control->light_threshold = row_status_table.light_threshold[row_id];
+    row_control->soil_moisture_threshold = row_status_table.soil_moisture_threshold[row_id];
+}
+
+/**
+ * @brief Spread the user parameters of a row (as stored in flash) over the row table
+ *
+ * @param row_id Row index
+ * @param row_control
+ */
+static void set_row_control(uint8_t row_id, const row_control_t *row_control)
+{
+    ROW_BITMAP_ASSIGN(row_status_table.fan_switch, row_id, row_control->fan_switch);
+    ROW_BITMAP_ASSIGN(row_status_table.water_switch, row_id, row_control->water_switch);
+    ROW_BITMAP_ASSIGN(row_status_table.light_switch, row_id, row_control->light_switch);
+    ROW_BITMAP_ASSIGN(row_status_table.automatic_control, row_id, row_control->automatic_control);
+    row_status_table.temp_threshold[row_id] = row_control->temp_threshold;
+    row_status_table.humidity_threshold[row_id] = row_control->humidity_threshold;
+    row_status_table.light_threshold[row_id] = row_control->light_threshold;
+    row_status_table.soil_moisture_threshold[row_id] = row_control->soil_moisture_threshold;
+}
+
 /**
  * @brief Function to store the updated row control config params in flash
  *        It is triggered every time user updates those parameters
@@ -48,8 +110,10 @@ static void store_row_config_params_handler(struct k_work *work)
 static void store_row_config_params_in_nvs(uint8_t row_id)
 {
     int err;
+    row_control_t row_control;
 
-    err = nvs_write(get_file_system_handle(), row_id, &row_control_config[row_id].row_control, sizeof(row_control_config[row_id].row_control));
+    get_row_control(row_id, &row_control);
+    err = nvs_write(get_file_system_handle(), ROW_CONTROL_CONFIGURATION_NVS_ID(row_id), &row_control, sizeof(row_control));
     if (err < 0)
     {
         LOG_INF("NVS write failed (err: %d)", err);
@@ -64,7 +128,7 @@ static void store_row_config_params_in_nvs(uint8_t row_id)
 /**
  * @brief function to initialize row_control object. Loads default environment control
  *        parameters.
- *        row_control_config[].row_control is stored in flash. those are the parameters
+ *        The row_control_t of every row is stored in flash. those are the parameters
  *        set by the user in order to control each row
  *
  */
@@ -78,20 +142,21 @@ void initialize_row_control_configuration(void)
     for (int row_id = 0; row_id < MAX_CONFIGURATION_ID; row_id++)
     {
         // Check if row control config params exist already in flash
-        if (nvs_read(get_file_system_handle(), row_id, &row_control_config_params, sizeof(row_control_config_params)) != sizeof(row_control_config_params))
+        if (nvs_read(get_file_system_handle(), ROW_CONTROL_CONFIGURATION_NVS_ID(row_id), &row_control_config_params, sizeof(row_control_config_params)) != sizeof(row_control_config_params))
         {
             // load default thresholds - control parameters
-            row_control_config[row_id].row_control.temp_threshold = DEFAULT_TEMPERATURE_THRESHOLD;
-            row_control_config[row_id].row_control.humidity_threshold = DEFAULT_HUMIDITY_THRESHOLD;
-            row_control_config[row_id].row_control.light_threshold = DEFAULT_LIGHT_EXPOSURE_THRESHOLD;
-            row_control_config[row_id].row_control.soil_moisture_threshold = DEFAULT_SOIL_MOISTURE_THRESHOLD;
-            row_control_config[row_id].row_control.fan_switch = false;
-            row_control_config[row_id].row_control.light_switch = false;
-            row_control_config[row_id].row_control.water_switch = false;
+            row_control_config_params.temp_threshold = DEFAULT_TEMPERATURE_THRESHOLD;
+            row_control_config_params.humidity_threshold = DEFAULT_HUMIDITY_THRESHOLD;
+            row_control_config_params.light_threshold = DEFAULT_LIGHT_EXPOSURE_THRESHOLD;
+            row_control_config_params.soil_moisture_threshold = DEFAULT_SOIL_MOISTURE_THRESHOLD;
+            row_control_config_params.fan_switch = false;
+            row_control_config_params.light_switch = false;
+            row_control_config_params.water_switch = false;
             // Automatic control is enabled by default -> User must set it to false
-            row_control_config[row_id].row_control.automatic_control = true;
+            row_control_config_params.automatic_control = true;
+            set_row_control(row_id, &row_control_config_params);
             // Store those parameters in flash
-            err = nvs_write(get_file_system_handle(), row_id, &row_control_config[row_id].row_control, sizeof(row_control_config[row_id].row_control));
+            err = nvs_write(get_file_system_handle(), ROW_CONTROL_CONFIGURATION_NVS_ID(row_id), &row_control_config_params, sizeof(row_control_config_params));
             if (err < 0)
             {
                 LOG_INF("NVS write failed (err: %d)", err);
@@ -100,18 +165,10 @@ void initialize_row_control_configuration(void)
         else
         {
             // Load row config params from flash
-            memcpy(&row_control_config[row_id].row_control, &row_control_config_params, sizeof(row_control_config_params));
+            set_row_control(row_id, &row_control_config_params);
             LOG_INF("Loaded default row control config params from flash, row_id = %d", row_id + 1);
         }
-        // Row id gets values from 1 to MAX_CONFIGURATION_ID
-        row_control_config[row_id].row_id = row_id + 1;
-        row_control_config[row_id].row_hum = 0;
-        row_control_config[row_id].row_light_exposure = 0;
-        row_control_config[row_id].row_soil_moisture = 0;
-        row_control_config[row_id].row_temp = 0;
-        // By default, no registered row. This flag will be set to true if a measurement
-        // is taken from a sensor node existing on the corresponding row id
-        row_control_config[row_id].row_registered = false;
+        reset_row_status(row_id);
     }
 }
 
@@ -126,7 +183,7 @@ void set_row_current_temperature(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_temp = value;
+        row_status_table.temp[index] = value;
     }
     else
     {
@@ -146,7 +203,7 @@ int32_t get_row_current_temperature(uint8_t index)
     {
         // temperature is like 20.32 C -> 2032 we lose precision but its ok
         // TODO: fix the precision for all gets of this source file
-        return row_control_config[index].row_temp / 100;
+        return row_status_table.temp[index] / 100;
     }
     else
     {
@@ -166,7 +223,7 @@ void set_row_current_humidity(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_hum = value;
+        row_status_table.hum[index] = value;
     }
     else
     {
@@ -184,7 +241,7 @@ int32_t get_row_current_humidity(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_hum  / 100;
+        return row_status_table.hum[index]  / 100;
     }
     else
     {
@@ -204,7 +261,7 @@ void set_row_current_soil_moisture(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_soil_moisture = value;
+        row_status_table.soil_moisture[index] = value;
     }
     else
     {
@@ -222,7 +279,7 @@ int32_t get_row_current_soil_moisture(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_soil_moisture / 100;
+        return row_status_table.soil_moisture[index] / 100;
     }
     else
     {
@@ -242,7 +299,7 @@ void set_row_current_light_exposure(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_light_exposure = value;
+        row_status_table.light_exposure[index] = value;
     }
     else
     {
@@ -260,7 +317,7 @@ int32_t get_row_current_light_exposure(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_light_exposure / 100;
+        return row_status_table.light_exposure[index] / 100;
     }
     else
     {
@@ -270,6 +327,45 @@ int32_t get_row_current_light_exposure(uint8_t index)
     return 0;
 }
 
+/**
+ * @brief Set the row window statistics object (moving average, min, max and
+ *        slope of the recent row values)
+ *
+ * @param value
+ * @param index
+ */
+void set_row_window(const row_window_data_t *value, uint8_t index)
+{
+    if (index < MAX_CONFIGURATION_ID)
+    {
+        memcpy(&row_status_table.window[index], value, sizeof(row_window_data_t));
+    }
+    else
+    {
+        LOG_INF("Wrong row control config indexing %d", index);
+    }
+}
+
+/**
+ * @brief Get the row window statistics object
+ *
+ * @param index
+ * @return const row_window_data_t*, NULL on wrong indexing
+ */
+const row_window_data_t *get_row_window(uint8_t index)
+{
+    if (index < MAX_CONFIGURATION_ID)
+    {
+        return &row_status_table.window[index];
+    }
+    else
+    {
+        LOG_INF("Wrong row control config indexing %d", index);
+    }
+
+    return NULL;
+}
+
 /**
  * @brief Set the row registered object
  *
@@ -279,7 +375,7 @@ void set_row_registered(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_registered = true;
+        ROW_BITMAP_SET(row_status_table.registered, index);
     }
     else
     {
@@ -297,7 +393,7 @@ void set_row_temp_threshold(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.temp_threshold = value;
+        row_status_table.temp_threshold[index] = value;
     }
     else
     {
@@ -315,7 +411,7 @@ int32_t get_row_temp_threshold(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.temp_threshold;
+        return row_status_table.temp_threshold[index];
     }
     else
     {
@@ -335,7 +431,7 @@ void set_row_hum_threshold(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.humidity_threshold = value;
+        row_status_table.humidity_threshold[index] = value;
     }
     else
     {
@@ -353,7 +449,7 @@ int32_t get_row_hum_threshold(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.humidity_threshold;
+        return row_status_table.humidity_threshold[index];
     }
     else
     {
@@ -373,7 +469,7 @@ void set_row_light_threshold(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.light_threshold = value;
+        row_status_table.light_threshold[index] = value;
     }
     else
     {
@@ -391,7 +487,7 @@ int32_t get_row_light_threshold(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.light_threshold;
+        return row_status_table.light_threshold[index];
     }
     else
     {
@@ -411,7 +507,7 @@ void set_row_soil_moisture_threshold(int32_t value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.soil_moisture_threshold = value;
+        row_status_table.soil_moisture_threshold[index] = value;
     }
     else
     {
@@ -429,7 +525,7 @@ int32_t get_row_soil_moisture_threshold(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.soil_moisture_threshold;
+        return row_status_table.soil_moisture_threshold[index];
     }
     else
     {
@@ -449,7 +545,7 @@ void set_row_water_switch(bool value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.water_switch = value;
+        ROW_BITMAP_ASSIGN(row_status_table.water_switch, index, value);
     }
     else
     {
@@ -468,7 +564,7 @@ bool get_row_water_switch(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.water_switch;
+        return ROW_BITMAP_TEST(row_status_table.water_switch, index);
     }
     else
     {
@@ -488,7 +584,7 @@ void set_row_fan_switch(bool value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.fan_switch = value;
+        ROW_BITMAP_ASSIGN(row_status_table.fan_switch, index, value);
     }
     else
     {
@@ -507,7 +603,7 @@ bool get_row_fan_switch(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.fan_switch;
+        return ROW_BITMAP_TEST(row_status_table.fan_switch, index);
     }
     else
     {
@@ -527,7 +623,7 @@ void set_row_light_switch(bool value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.light_switch = value;
+        ROW_BITMAP_ASSIGN(row_status_table.light_switch, index, value);
     }
     else
     {
@@ -546,7 +642,7 @@ bool get_row_light_switch(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.light_switch;
+        return ROW_BITMAP_TEST(row_status_table.light_switch, index);
     }
     else
     {
@@ -566,7 +662,7 @@ void set_row_automatic_control(bool value, uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        row_control_config[index].row_control.automatic_control = value;
+        ROW_BITMAP_ASSIGN(row_status_table.automatic_control, index, value);
     }
     else
     {
@@ -585,7 +681,7 @@ bool get_row_automatic_control(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_control.automatic_control;
+        return ROW_BITMAP_TEST(row_status_table.automatic_control, index);
     }
     else
     {
@@ -606,7 +702,7 @@ bool get_row_registered(uint8_t index)
 {
     if (index < MAX_CONFIGURATION_ID)
     {
-        return row_control_config[index].row_registered;
+        return ROW_BITMAP_TEST(row_status_table.registered, index);
     }
     else
     {
@@ -616,6 +712,17 @@ bool get_row_registered(uint8_t index)
     return false;
 }
 
+/**
+ * @brief Get the bitmap of the registered rows, to loop over them only
+ *        (see ROW_BITMAP_FOR_EACH)
+ *
+ * @return const uint8_t* row bitmap of ROW_BITMAP_SIZE bytes
+ */
+const uint8_t *get_row_registered_bitmap(void)
+{
+    return row_status_table.registered;
+}
+
 /**
  * @brief Reset row status
  *
@@ -623,11 +730,12 @@ bool get_row_registered(uint8_t index)
  */
 void reset_row_status(uint8_t index)
 {
-    row_control_config[index].row_hum = 0;
-    row_control_config[index].row_light_exposure = 0;
-    row_control_config[index].row_soil_moisture = 0;
-    row_control_config[index].row_temp = 0;
-    row_control_config[index].row_registered = false;
+    row_status_table.hum[index] = 0;
+    row_status_table.light_exposure[index] = 0;
+    row_status_table.soil_moisture[index] = 0;
+    row_status_table.temp[index] = 0;
+    memset(&row_status_table.window[index], 0, sizeof(row_window_data_t));
+    ROW_BITMAP_CLEAR(row_status_table.registered, index);
 }
 
 /**
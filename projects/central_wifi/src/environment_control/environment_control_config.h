@@ -4,17 +4,16 @@
 // --- includes ----------------------------------------------------------------
 #include <stdint.h>
 #include <stdbool.h>
+#include "common.h"
 
 // --- defines -----------------------------------------------------------------
 #define DEFAULT_TEMPERATURE_THRESHOLD 2800 // 2842 = 28.42 oC
 #define DEFAULT_HUMIDITY_THRESHOLD    7000 // 7212 = 72.12%
 #define DEFAULT_SOIL_MOISTURE_THRESHOLD 6000 // 6213 = 62.13%
 #define DEFAULT_LIGHT_EXPOSURE_THRESHOLD 100 // TODO: Random number, TBD after light sensor is functional
-#define ROW_1_CONTROL_CONFIGURATION_FLASH_KEY 0
-#define ROW_2_CONTROL_CONFIGURATION_FLASH_KEY 1
-#define ROW_3_CONTROL_CONFIGURATION_FLASH_KEY 2
-#define ROW_4_CONTROL_CONFIGURATION_FLASH_KEY 3
-#define ROW_5_CONTROL_CONFIGURATION_FLASH_KEY 4
+// NVS id of the row control configuration of a row (row index 0 is stored on NVS id 0)
+#define ROW_CONTROL_CONFIGURATION_NVS_ID_BASE 0
+#define ROW_CONTROL_CONFIGURATION_NVS_ID(row_index) (ROW_CONTROL_CONFIGURATION_NVS_ID_BASE + (row_index))
 
 // --- structs -----------------------------------------------------------------
 // this struct is about user row configuration
@@ -22,6 +21,7 @@
 // about the automatic/manual control of fan/water/light
 // and the thresholds for hum/temp/soil/light on which fan/water/light will turn
 // on  in case of automatic control
+// It is the record stored in flash for every row (see ROW_CONTROL_CONFIGURATION_NVS_ID)
 typedef struct row_control_s
 {
     // switches
@@ -37,20 +37,6 @@ typedef struct row_control_s
     int32_t soil_moisture_threshold;
 }row_control_t;
 
-typedef struct row_status_s
-{
-    // store the mean measurements for the row
-    int32_t row_temp;
-    int32_t row_hum;
-    int32_t row_soil_moisture;
-    int32_t row_light_exposure;
-    uint8_t row_id;
-    // this field indicates if the row has at least one sensor node
-    bool    row_registered;
-    // user sets those parameters
-    row_control_t row_control;
-}row_status_t;
-
 // --- functions declarations --------------------------------------------------
 void initialize_row_control_configuration(void);
 
@@ -67,8 +53,12 @@ int32_t get_row_current_soil_moisture(uint8_t index);
 void set_row_current_light_exposure(int32_t value, uint8_t index);
 int32_t get_row_current_light_exposure(uint8_t index);
 
+void set_row_window(const row_window_data_t *value, uint8_t index);
+const row_window_data_t *get_row_window(uint8_t index);
+
 void set_row_registered(uint8_t index);
 bool get_row_registered(uint8_t index);
+const uint8_t *get_row_registered_bitmap(void);
 void reset_row_status(uint8_t index);
 
 // --- getters / setters for user config parameters
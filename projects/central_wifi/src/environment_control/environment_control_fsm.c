@@ -12,6 +12,8 @@
 // 10% offset of the user requested soil moisture threshold
 #define SOIL_MOISTURE_OFFSET 0.1
 #define ONE_HUNDRED_PERCENT 100
+// Row values the window of a row needs before the fan follows its moving average
+#define ROW_TREND_MIN_SAMPLES 3
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(environment_control_m);
 
@@ -33,6 +35,8 @@ struct user_object_s
 } env_control_fsm_user_object;
 
 // --- static function declarations --------------------------------------------
+static int32_t get_row_trend_value(uint16_t row_index, uint8_t row_field, int32_t current_value);
+
 static void env_control_init_run(void *o);
 
 static void env_control_run(void *o);
@@ -51,6 +55,28 @@ static const struct smf_state env_control_states[] = {
 struct k_event env_control_event;
 
 // --- static function definitions ---------------------------------------------
+/**
+ * @brief Get the value of a row field the fan is controlled with: the moving average
+ *        of the recent row values once the window of the row holds enough of them,
+ *        so that a single noisy cycle does not toggle the fan
+ *
+ * @param row_index Row id - 1
+ * @param row_field Field of the row window (see ROW_WINDOW_FIELD_TEMPERATURE)
+ * @param current_value Row value of the last cycle
+ * @return value to compare with the threshold of the field
+ */
+static int32_t get_row_trend_value(uint16_t row_index, uint8_t row_field, int32_t current_value)
+{
+    const row_window_data_t *row_window = get_row_window(row_index);
+
+    if (row_window == NULL || row_window->fields[row_field].sample_count < ROW_TREND_MIN_SAMPLES)
+    {
+        return current_value;
+    }
+
+    return row_window->fields[row_field].ewma;
+}
+
 // --- ENV_CONTROL_INIT state ---
 static void env_control_init_run(void *o)
 {
@@ -64,6 +90,8 @@ static void env_control_init_run(void *o)
 // --- ENV_CONTROL state ---
 static void env_control_run(void *o)
 {
+    uint16_t row_index;
+
     // Construct the message to be sent to 9160 in order to control GPIOs
     message_control_gpios_t message_control_gpios = {0};
     message_control_gpios.type = MESSAGE_CONTROL_GPIOS;
@@ -72,106 +100,96 @@ static void env_control_run(void *o)
     // Check if automatic control is enabled -> if enabled, check the threshold
     // and control fan/light/water
     // If automatic control is disabled, blindly do what user has set for fan/light/water
-    for (uint8_t row_index = 0; row_index < MAX_CONFIGURATION_ID; row_index++)
+    // Rows that are not registered are skipped, their fan/light/water bits stay off
+    ROW_BITMAP_FOR_EACH(get_row_registered_bitmap(), row_index)
     {
-        // Check if row is registered, if not, turn fan/light/water off
-        if (get_row_registered(row_index))
+        // Check if manual control for the corresponding row is enabled
+        if (!get_row_automatic_control(row_index))
         {
-            // Check if manual control for the corresponding row is enabled
-            if (!get_row_automatic_control(row_index))
+            // Control the fan
+            if (get_row_fan_switch(row_index))
+            {
+                ROW_BITMAP_SET(message_control_gpios.row_fan_control, row_index);
+                // Set fan on for row index
+                LOG_INF("Manual fan on for %d", row_index + 1);
+            }
+            else
+            {
+                ROW_BITMAP_CLEAR(message_control_gpios.row_fan_control, row_index);
+                // Set fan off for row index
+                LOG_INF("Manual fan off for %d", row_index + 1);
+            }
+
+            // Control the water
+            if (get_row_water_switch(row_index))
+            {
+                ROW_BITMAP_SET(message_control_gpios.row_water_control, row_index);
+                // Set water on for row index
+                LOG_INF("Manual water on for %d", row_index + 1);
+            }
+            else
+            {
+                ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
+                // Set water off for row index
+                LOG_INF("Manual water off for %d", row_index + 1);
+            }
+
+            // Control the lights
+            if (get_row_light_switch(row_index))
             {
-                // Control the fan
-                if (get_row_fan_switch(row_index))
-                {
-                    message_control_gpios.row_fan_control[row_index] = true;
-                    // Set fan on for row index
-                    LOG_INF("Manual fan on for %d", row_index + 1);
-                }
-                else
-                {
-                    message_control_gpios.row_fan_control[row_index] = false;
-                    // Set fan off for row index
-                    LOG_INF("Manual fan off for %d", row_index + 1);
-                }
-
-                // Control the water
-                if (get_row_water_switch(row_index))
-                {
-                    message_control_gpios.row_water_control[row_index] = true;
-                    // Set water on for row index
-                    LOG_INF("Manual water on for %d", row_index + 1);
-                }
-                else
-                {
-                    message_control_gpios.row_water_control[row_index] = false;
-                    // Set water off for row index
-                    LOG_INF("Manual water off for %d", row_index + 1);
-                }
-
-                // Control the lights
-                if (get_row_light_switch(row_index))
-                {
-                    message_control_gpios.row_lights_control[row_index] = true;
-                    // Set lights on for row index
-                    LOG_INF("Manual lights on for %d", row_index + 1);
-                }
-                else
-                {
-                    message_control_gpios.row_lights_control[row_index] = false;
-                    // Set lights off for row index
-                    LOG_INF("Manual lights off for %d", row_index + 1);
-                }
+                ROW_BITMAP_SET(message_control_gpios.row_lights_control, row_index);
+                // Set lights on for row index
+                LOG_INF("Manual lights on for %d", row_index + 1);
             }
-            else // if automatic control
+            else
             {
-                // Control the fan
-                if ((get_row_current_temperature(row_index) > get_row_temp_threshold(row_index)) || (get_row_current_humidity(row_index) > get_row_hum_threshold(row_index)))
-                {
-                    message_control_gpios.row_fan_control[row_index] = true;
-                    // Set fan on for row index
-                    LOG_INF("Auto fan on for %d", row_index + 1);
-                }
-                else
-                {
-                    message_control_gpios.row_fan_control[row_index] = false;
-                    // Set fan off for row index
-                    LOG_INF("Auto fan off for %d", row_index + 1);
-                }
-
-                // Control the water
-                if (get_row_current_soil_moisture(row_index) < get_row_soil_moisture_threshold(row_index))
-                {
-                    message_control_gpios.row_water_control[row_index] = true;
-                    // Set water on for row index
-                    LOG_INF("Auto water on for %d", row_index + 1);
-                }
-                // Water will be turned off after we exceed the threshold 10% of the user requested limit
-                else if (get_row_current_soil_moisture(row_index) > get_row_soil_moisture_threshold(row_index) + SOIL_MOISTURE_OFFSET * get_row_soil_moisture_threshold(row_index))
-                {
-                    message_control_gpios.row_water_control[row_index] = false;
-                    // Set water off for row index
-                    LOG_INF("Auto water off for %d", row_index + 1);
-                }
-                // if soil moisture reaches 100%, water must be turned off TODO: Check if 100 should be lower, like 90%
-                else if (get_row_current_soil_moisture(row_index) >= ONE_HUNDRED_PERCENT)
-                {
-                    message_control_gpios.row_water_control[row_index] = false;
-                    // Set water off for row index
-                    LOG_INF("Auto water off for %d", row_index + 1);
-                }
-                // Lights will be on as long as the row is registered
-                message_control_gpios.row_lights_control[row_index] = true;
-                    // Set lights on for row index
-                LOG_INF("Auto lights on for %d", row_index + 1);
+                ROW_BITMAP_CLEAR(message_control_gpios.row_lights_control, row_index);
+                // Set lights off for row index
+                LOG_INF("Manual lights off for %d", row_index + 1);
             }
         }
-        else
+        else // if automatic control
         {
-            message_control_gpios.row_fan_control[row_index] = false;
-            message_control_gpios.row_water_control[row_index] = false;
-            message_control_gpios.row_lights_control[row_index] = false;
-            // Set fan/water/light off
-            LOG_INF("Row not registered, so all off %d", row_index + 1);
+            // Control the fan, with the trend of the row rather than its last values
+            if ((get_row_trend_value(row_index, ROW_WINDOW_FIELD_TEMPERATURE, get_row_current_temperature(row_index)) > get_row_temp_threshold(row_index)) ||
+                (get_row_trend_value(row_index, ROW_WINDOW_FIELD_HUMIDITY, get_row_current_humidity(row_index)) > get_row_hum_threshold(row_index)))
+            {
+                ROW_BITMAP_SET(message_control_gpios.row_fan_control, row_index);
+                // Set fan on for row index
+                LOG_INF("Auto fan on for %d", row_index + 1);
+            }
+            else
+            {
+                ROW_BITMAP_CLEAR(message_control_gpios.row_fan_control, row_index);
+                // Set fan off for row index
+                LOG_INF("Auto fan off for %d", row_index + 1);
+            }
+
+            // Control the water
+            if (get_row_current_soil_moisture(row_index) < get_row_soil_moisture_threshold(row_index))
+            {
+                ROW_BITMAP_SET(message_control_gpios.row_water_control, row_index);
+                // Set water on for row index
+                LOG_INF("Auto water on for %d", row_index + 1);
+            }
+            // Water will be turned off after we exceed the threshold 10% of the user requested limit
+            else if (get_row_current_soil_moisture(row_index) > get_row_soil_moisture_threshold(row_index) + SOIL_MOISTURE_OFFSET * get_row_soil_moisture_threshold(row_index))
+            {
+                ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
+                // Set water off for row index
+                LOG_INF("Auto water off for %d", row_index + 1);
+            }
+            // if soil moisture reaches 100%, water must be turned off TODO: Check if 100 should be lower, like 90%
+            else if (get_row_current_soil_moisture(row_index) >= ONE_HUNDRED_PERCENT)
+            {
+                ROW_BITMAP_CLEAR(message_control_gpios.row_water_control, row_index);
+                // Set water off for row index
+                LOG_INF("Auto water off for %d", row_index + 1);
+            }
+            // Lights will be on as long as the row is registered
+            ROW_BITMAP_SET(message_control_gpios.row_lights_control, row_index);
+                // Set lights on for row index
+            LOG_INF("Auto lights on for %d", row_index + 1);
         }
     }
     message_control_gpios.message_crc = crc16_ansi((uint8_t*)&message_control_gpios, sizeof(message_control_gpios_t) - sizeof(message_control_gpios.message_crc));
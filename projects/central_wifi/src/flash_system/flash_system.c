@@ -16,7 +16,7 @@ void flash_system_init(void)
 
 	/* define the nvs file system by settings with:
 	 *	sector_size equal to the pagesize,
-	 *	3 sectors
+	 *	every page of the partition (NVS_SECTOR_COUNT)
 	 *	starting at NVS_PARTITION_OFFSET
 	 */
 	fs.flash_device = NVS_PARTITION_DEVICE;
@@ -31,7 +31,10 @@ void flash_system_init(void)
 		return;
 	}
 	fs.sector_size = info.size;
-	fs.sector_count = 3U;
+	fs.sector_count = NVS_PARTITION_SIZE / info.size;
+	if (info.size != NVS_SECTOR_SIZE) {
+		printk("Unexpected flash page size %zu, NVS capacity differs from NVS_CAPACITY\n", info.size);
+	}
 
 	rc = nvs_mount(&fs);
 	if (rc) {
@@ -14,6 +14,18 @@
 #define NVS_PARTITION		storage_partition
 #define NVS_PARTITION_DEVICE	FIXED_PARTITION_DEVICE(NVS_PARTITION)
 #define NVS_PARTITION_OFFSET	FIXED_PARTITION_OFFSET(NVS_PARTITION)
+#define NVS_PARTITION_SIZE	FIXED_PARTITION_SIZE(NVS_PARTITION)
+// Flash page size of the partition, every NVS sector is one page
+#define NVS_SECTOR_SIZE		4096
+// Every page of the partition is an NVS sector
+#define NVS_SECTOR_COUNT	(NVS_PARTITION_SIZE / NVS_SECTOR_SIZE)
+// Allocation table entry of NVS, one per record and two per sector (close and gc done)
+#define NVS_ATE_SIZE		8
+// Flash a record takes: its data (aligned to the ATE size, the largest write block) and its ATE
+#define NVS_RECORD_SIZE(data_size)	(ROUND_UP(data_size, NVS_ATE_SIZE) + NVS_ATE_SIZE)
+// Flash the records can take. One sector is kept empty for garbage collection, so
+// every record stored in NVS must fit in the other ones (see the BUILD_ASSERT of the users)
+#define NVS_CAPACITY	((NVS_SECTOR_COUNT - 1) * (NVS_SECTOR_SIZE - 2 * NVS_ATE_SIZE))
 
 // --- functions declarations --------------------------------------------------
 void flash_system_init(void);
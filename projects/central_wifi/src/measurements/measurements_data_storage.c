@@ -1,22 +1,346 @@
 // --- includes ----------------------------------------------------------------
 #include <stdint.h>
+#include <errno.h>
 #include "measurements_data_storage.h"
 #include "measurements_fsm.h"
 #include "ble_client/ble_connection_data.h"
 #include "ble_client/ble_characteristic_control.h"
+#include "ble_client/ble_conn_control.h"
+#include "ble_client/ble_link_stats.h"
+#include "measurements_fsm_timer.h"
+#include "measurements_ingest_ring.h"
 
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_DECLARE(measurements_m);
 
+// --- defines -----------------------------------------------------------------
+// Time given to a sensor node to respond to a single characteristic read
+#define CHARACTERISTIC_READ_TIMEOUT_MS 1500
+// Every node reads its characteristics one after the other, but all nodes are
+// read at the same time. So the whole cycle is bounded by the slowest node, plus
+// the time it takes to wake up from the idle connection parameters
+#define READ_CYCLE_TIMEOUT_MS (CHARACTERISTIC_READ_TIMEOUT_MS * (MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT + CONFIGURE_SERVICE_CHARACTERISTIC_COUNT) + \
+                               BLE_IDLE_CONNECTION_WAKEUP_MS)
+#ifdef BLE_ROTATION_MODE
+// A rotated node measurement older than this is not used (the node was not served
+// for a long time, or it is not seen by the scanner anymore)
+#define INGESTED_MEASUREMENT_MAX_AGE_MS BLE_NODE_STALE_TIMEOUT_MS
+// Time given to a rotated node to complete its read sequence
+#define ROTATED_READ_TIMEOUT_MS READ_CYCLE_TIMEOUT_MS
+#elif defined(MEASUREMENTS_ASYNC_INGEST)
+// A pushed (or advertised) measurement older than this is not used (the node
+// missed several notify periods)
+#define INGESTED_MEASUREMENT_MAX_AGE_MS (3 * MEASUREMENT_PERIOD_IN_SEC * 1000)
+#endif
+#ifdef BLE_ADV_TELEMETRY_MODE
+// Samples an advertised measurement record is stored as (values, battery, row id, epoch)
+#define ADVERTISED_RECORD_SAMPLE_COUNT 7
+#endif
+
 // --- static variables definitions --------------------------------------------
 // measurement_data will store all measurements from each sensor node
+static measurements_data_t measurement_data[MEASUREMENT_DATA_SIZE];
+// Connection handle of every measurement_data slot. The handle only has a meaning on
+// this device, so it is kept out of measurements_data_t (nodes are identified by address)
 // get_all_ble_connection_handles() function fills this array with conenction handles only
 // if a connection gets invalid, measurement_data will not be updated
-static measurements_data_t measurement_data[BLE_MAX_CONNECTIONS];
+static struct bt_conn *measurement_connection_handle[MEASUREMENT_DATA_SIZE];
+// References taken on the connections by get_all_ble_connection_handles(), so that a
+// node that disconnects during the read cycle does not leave its connection object
+// to another node before the cycle is done with it
+static struct bt_conn *cycle_connection_refs[BLE_MAX_CONNECTIONS];
 // mean_row_measurements will store mean measurement values for every row
 static row_mean_data_t mean_row_measurements[MAX_CONFIGURATION_ID];
+// Rows of mean_row_measurements that are registered on this cycle (row bitmap)
+static uint8_t registered_rows[ROW_BITMAP_SIZE];
+// Slots (measurement_data indexes) whose read sequence has not completed yet
+static ATOMIC_DEFINE(read_pending_slots, BLE_MAX_CONNECTIONS);
+// Slots whose read sequence completed with an error
+static ATOMIC_DEFINE(read_failed_slots, BLE_MAX_CONNECTIONS);
+// Slots that are not read on the current cycle (the node is not due), they keep
+// the measurements of their last read
+static bool is_read_held[BLE_MAX_CONNECTIONS];
+// Sampling epoch of the measurements of every node (see set_sampling_epoch_value())
+static uint16_t measurement_epoch[MEASUREMENT_DATA_SIZE];
+// Sampling epoch the current read cycle belongs to
+static uint16_t cycle_epoch = MEASUREMENT_EPOCH_UNSYNCHRONIZED;
+// Uptime (ms) since when the samples of every slot are stored. Older samples on the
+// ingest ring (late responses of a previous cycle, or samples of a previous owner
+// of the slot) are dropped
+static uint32_t measurement_slot_start_time[MEASUREMENT_DATA_SIZE];
+// Dropped samples of the ingest ring that were already reported
+static uint32_t reported_dropped_samples;
+// Guards the owner of every slot (measurement_connection_handle, measurement_slot_start_time
+// and measurement_slot_address), assigned by the bt threads and read by the measurements thread
+static struct k_spinlock measurement_slot_lock;
+#ifdef MEASUREMENTS_ASYNC_INGEST
+// Uptime (ms) of the last measurement stored for every node
+static uint32_t measurement_update_time[MEASUREMENT_DATA_SIZE];
+// Slots whose stored measurements are used on the current cycle
+static bool is_ingested_measurement_valid[MEASUREMENT_DATA_SIZE];
+// Address of the node every slot is assigned to. Slots are assigned by the bt threads,
+// while measurement_data is only written by the measurements thread
+static bt_addr_le_t measurement_slot_address[MEASUREMENT_DATA_SIZE];
+#endif
+#ifdef BLE_ADV_TELEMETRY_MODE
+// Sequence number of the last record advertised by every node (bt rx thread only)
+static uint8_t advertised_sequence_number[MEASUREMENT_DATA_SIZE];
+static bool is_advertised_sequence_valid[MEASUREMENT_DATA_SIZE];
+#endif
+#ifdef BLE_ROTATION_MODE
+// Connection slot (bluetooth_devices index) of the rotated node being read
+static uint8_t rotated_read_slot = UINT8_MAX;
+static int rotated_read_result;
+K_SEM_DEFINE(rotated_read_sem, 0, 1);
+#endif
+
+// --- static function declarations --------------------------------------------
+static int get_measurement_data_index(struct bt_conn *conn);
+static void set_measurement_update_time(uint16_t device_index, uint32_t timestamp);
+#ifndef MEASUREMENTS_ASYNC_INGEST
+static void reset_measurement_slot(uint16_t device_index, struct bt_conn *conn);
+#endif
+static void register_measurement_row(uint8_t row_id);
+static void push_measurement_sample(struct bt_conn *conn, measurement_field_t field, int32_t value);
+static void apply_measurement_sample(const measurement_sample_t *sample);
+static void drain_measurement_samples(void);
+#ifdef MEASUREMENTS_ASYNC_INGEST
+static void refresh_measurement_slot_owner(uint16_t device_index);
+#endif
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Get the measurement_data index of a connection. measurement_data shares
+ *        its indexes with bluetooth_devices (or with the node registry in rotation
+ *        mode), so this is a constant-time lookup
+ *
+ * @param conn Ble connection handle
+ * @return index on measurement_data, -1 if the connection is not measured on this cycle
+ */
+static int get_measurement_data_index(struct bt_conn *conn)
+{
+#ifdef BLE_ROTATION_MODE
+    uint16_t node_index = get_node_index_by_conn_handle(conn);
+    int index = (node_index < MEASUREMENT_DATA_SIZE) ? node_index : -1;
+#else
+    int index = get_device_index_by_conn_handle(conn);
+#endif
+
+    if (index < 0 || get_measurement_connection_handle(index) != conn)
+    {
+        return -1;
+    }
+
+    return index;
+}
+
+/**
+ * @brief Keep the time a measurement of a node was received. The time is only used
+ *        in push and rotation modes, where measurements arrive whenever the node is
+ *        served. A measurement stored on its own has no sampling epoch, the epoch
+ *        of a measurement record is set after its measurements
+ *
+ * @param device_index Index of the node on measurement_data
+ * @param timestamp Uptime (ms) the measurement was received
+ */
+static void set_measurement_update_time(uint16_t device_index, uint32_t timestamp)
+{
+    measurement_epoch[device_index] = MEASUREMENT_EPOCH_UNSYNCHRONIZED;
+#ifdef MEASUREMENTS_ASYNC_INGEST
+    measurement_update_time[device_index] = timestamp;
+#else
+    ARG_UNUSED(timestamp);
+#endif
+}
+
+#ifndef MEASUREMENTS_ASYNC_INGEST
+/**
+ * @brief Clear the measurements of a measurement_data slot and assign it to a connection
+ *
+ * @param device_index Index of the node on measurement_data
+ * @param conn Ble connection handle
+ */
+static void reset_measurement_slot(uint16_t device_index, struct bt_conn *conn)
+{
+    k_spinlock_key_t key;
+
+    memset(&measurement_data[device_index], 0, sizeof(measurements_data_t));
+    key = k_spin_lock(&measurement_slot_lock);
+    measurement_connection_handle[device_index] = conn;
+    measurement_slot_start_time[device_index] = k_uptime_get_32();
+    k_spin_unlock(&measurement_slot_lock, key);
+    if (conn != NULL)
+    {
+        bt_addr_le_copy(&measurement_data[device_index].peer_address, bt_conn_get_dst(conn));
+    }
+}
+#endif
+
+/**
+ * @brief Register the row of a node whose stored measurements are used on the
+ *        current cycle, without reading its configuration id again
+ *
+ * @param row_id Row id (configuration id) of the node
+ */
+static void register_measurement_row(uint8_t row_id)
+{
+    if (row_id > 0 && row_id <= MAX_CONFIGURATION_ID)
+    {
+        mean_row_measurements[row_id - 1].is_row_registered = true;
+        mean_row_measurements[row_id - 1].row_id = row_id;
+        ROW_BITMAP_SET(registered_rows, row_id - 1);
+    }
+}
+
+/**
+ * @brief Hand a value received from a sensor node over to the measurements thread.
+ *        Called from the bt callbacks, measurement_data is not touched here
+ *
+ * @param conn Ble connection handle
+ * @param field Field the value is stored on
+ * @param value Value as received from the sensor node
+ */
+static void push_measurement_sample(struct bt_conn *conn, measurement_field_t field, int32_t value)
+{
+    int index = get_measurement_data_index(conn);
+
+    if (index >= 0)
+    {
+        measurements_ingest_ring_push(index, field, value);
+    }
+}
+
+/**
+ * @brief Store a sample of the ingest ring on measurement_data
+ *
+ * @param sample Sample taken from the ingest ring
+ */
+static void apply_measurement_sample(const measurement_sample_t *sample)
+{
+    measurements_data_t *node;
+    uint32_t slot_start_time;
+    k_spinlock_key_t key;
+
+    if (sample->slot >= MEASUREMENT_DATA_SIZE)
+    {
+        return;
+    }
+
+    key = k_spin_lock(&measurement_slot_lock);
+    slot_start_time = measurement_slot_start_time[sample->slot];
+    k_spin_unlock(&measurement_slot_lock, key);
+    if ((int32_t)(sample->timestamp - slot_start_time) < 0)
+    {
+        return;
+    }
+
+#ifdef MEASUREMENTS_ASYNC_INGEST
+    refresh_measurement_slot_owner(sample->slot);
+#endif
+    node = &measurement_data[sample->slot];
+    switch (sample->field)
+    {
+    case MEASUREMENT_FIELD_TEMPERATURE:
+        node->values.temperature = (int16_t)sample->value;
+        node->valid_fields |= MEASUREMENT_TEMPERATURE_VALID;
+        set_measurement_update_time(sample->slot, sample->timestamp);
+        break;
+    case MEASUREMENT_FIELD_HUMIDITY:
+        node->values.humidity = (uint16_t)sample->value;
+        node->valid_fields |= MEASUREMENT_HUMIDITY_VALID;
+        set_measurement_update_time(sample->slot, sample->timestamp);
+        break;
+    case MEASUREMENT_FIELD_SOIL_MOISTURE:
+        node->values.soil_moisture = (uint16_t)sample->value;
+        node->valid_fields |= MEASUREMENT_SOIL_MOISTURE_VALID;
+        set_measurement_update_time(sample->slot, sample->timestamp);
+        break;
+    case MEASUREMENT_FIELD_LIGHT_INTENSITY:
+        node->values.light_intensity = (uint16_t)sample->value;
+        node->valid_fields |= MEASUREMENT_LIGHT_VALID;
+        set_measurement_update_time(sample->slot, sample->timestamp);
+        break;
+    case MEASUREMENT_FIELD_ROW_ID:
+        node->row_id = (uint8_t)sample->value;
+        node->valid_fields |= MEASUREMENT_ROW_ID_VALID;
+        if (node->row_id > 0 && node->row_id <= MAX_CONFIGURATION_ID)
+        {
+            // Set row to registered
+            register_measurement_row(node->row_id);
+        }
+        else
+        {
+            LOG_INF("Configuration id issue: %d", node->row_id);
+        }
+        break;
+    case MEASUREMENT_FIELD_BATTERY_LEVEL:
+        node->battery_level = (uint8_t)sample->value;
+        node->valid_fields |= MEASUREMENT_BATTERY_VALID;
+        break;
+    case MEASUREMENT_FIELD_SAMPLING_EPOCH:
+        measurement_epoch[sample->slot] = (uint16_t)sample->value;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Store every sample waiting on the ingest ring on measurement_data, a batch
+ *        at a time. Only the measurements thread writes measurement_data
+ *
+ */
+static void drain_measurement_samples(void)
+{
+    measurement_sample_t samples[MEASUREMENTS_INGEST_BATCH_SIZE];
+    uint16_t count;
+    uint32_t dropped_samples;
+
+    do
+    {
+        count = measurements_ingest_ring_pop(samples, MEASUREMENTS_INGEST_BATCH_SIZE);
+        for (uint16_t index = 0; index < count; index++)
+        {
+            apply_measurement_sample(&samples[index]);
+        }
+    } while (count == MEASUREMENTS_INGEST_BATCH_SIZE);
+
+    dropped_samples = measurements_ingest_ring_get_dropped();
+    if (dropped_samples != reported_dropped_samples)
+    {
+        LOG_INF("Ingest ring full, samples dropped: %d", dropped_samples - reported_dropped_samples);
+        reported_dropped_samples = dropped_samples;
+    }
+}
+
+#ifdef MEASUREMENTS_ASYNC_INGEST
+/**
+ * @brief Clear a measurement_data slot that was assigned to another node since
+ *        its measurements were stored
+ *
+ * @param device_index Index of the node on measurement_data
+ */
+static void refresh_measurement_slot_owner(uint16_t device_index)
+{
+    bt_addr_le_t slot_address;
+    k_spinlock_key_t key;
+
+    key = k_spin_lock(&measurement_slot_lock);
+    bt_addr_le_copy(&slot_address, &measurement_slot_address[device_index]);
+    k_spin_unlock(&measurement_slot_lock, key);
+    if (bt_addr_le_cmp(&measurement_data[device_index].peer_address, &slot_address))
+    {
+        memset(&measurement_data[device_index], 0, sizeof(measurements_data_t));
+        bt_addr_le_copy(&measurement_data[device_index].peer_address, &slot_address);
+        measurement_update_time[device_index] = 0;
+        measurement_epoch[device_index] = MEASUREMENT_EPOCH_UNSYNCHRONIZED;
+    }
+}
+#endif
 
 // --- functions definitions ---------------------------------------------------
 measurements_data_t *get_measurements_data(void)
@@ -30,58 +354,137 @@ row_mean_data_t *get_row_mean_data(void)
 }
 
 /**
- * @brief function to clear measurement_data, this is called
- *        every time we take measurements
+ * @brief Get the rows that are registered on this cycle, to loop over them only
+ *        (see ROW_BITMAP_FOR_EACH)
+ *
+ * @return const uint8_t* row bitmap of ROW_BITMAP_SIZE bytes
+ */
+const uint8_t *get_registered_rows(void)
+{
+    return registered_rows;
+}
+
+/**
+ * @brief Get the connection handle of a measurement_data slot
+ *
+ * @param device_index Index of the node on measurement_data
+ * @return connection handle, NULL if the node is not connected (or not measured on this cycle)
+ */
+struct bt_conn *get_measurement_connection_handle(uint16_t device_index)
+{
+    struct bt_conn *conn;
+    k_spinlock_key_t key;
+
+    if (device_index >= MEASUREMENT_DATA_SIZE)
+    {
+        return NULL;
+    }
+
+    key = k_spin_lock(&measurement_slot_lock);
+    conn = measurement_connection_handle[device_index];
+    k_spin_unlock(&measurement_slot_lock, key);
+
+    return conn;
+}
+
+/**
+ * @brief function to clear only the row mean measurement values
  *
  */
-void clear_measurement_data(void)
+void clear_row_mean_data(void)
 {
-    // Clean measurement_data array
-    memset(measurement_data, 0, sizeof(measurements_data_t) * BLE_MAX_CONNECTIONS);
-    memset(mean_row_measurements, 0, sizeof(row_mean_data_t) * MAX_CONFIGURATION_ID);
+    uint16_t row_index;
+
+    // Only the registered rows hold values
+    ROW_BITMAP_FOR_EACH(registered_rows, row_index)
+    {
+        memset(&mean_row_measurements[row_index], 0, sizeof(row_mean_data_t));
+    }
+    memset(registered_rows, 0, sizeof(registered_rows));
 }
 
 /**
  * @brief Get all connection handles from connected sensor nodes and store them
- *        on measurement_data.ble_connection_handle member
+ *        on measurement_connection_handle. A reference is kept on every connection
+ *        until release_all_ble_connection_handles()
  *
  */
 void get_all_ble_connection_handles(void)
 {
-    char *mac_address;
-    // store all connection handles on the local variable measurement_data
+    struct bt_conn *conn;
+    k_spinlock_key_t key;
+
+    release_all_ble_connection_handles();
+    // store all connection handles on the local variable measurement_connection_handle
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        // TODO: make sure ble_connection_handle is null if device is not connected
-        measurement_data[i].ble_connection_handle = get_ble_conn_handles(i);
-        mac_address = get_mac_address_by_conn_handle(measurement_data[i].ble_connection_handle);
-        if(mac_address != NULL)
+        conn = get_ble_conn_handles(i);
+        // NULL if the connection was released in the meantime
+        cycle_connection_refs[i] = (conn != NULL) ? bt_conn_ref(conn) : NULL;
+        key = k_spin_lock(&measurement_slot_lock);
+        measurement_connection_handle[i] = cycle_connection_refs[i];
+        k_spin_unlock(&measurement_slot_lock, key);
+        if (measurement_connection_handle[i] != NULL)
         {
-            memcpy(measurement_data[i].mac_address, mac_address, MAC_ADDRESS_LENGTH * sizeof(char));
+            bt_addr_le_copy(&measurement_data[i].peer_address, bt_conn_get_dst(measurement_connection_handle[i]));
         }
     }
 }
 
 /**
- * @brief Store the measured temperature on the measurement_data
- *        This function is called from the read_characteristic_cb
+ * @brief Release the connection references taken by get_all_ble_connection_handles(),
+ *        once the read cycle is done with the connections. The handles are then only
+ *        compared, never used
  *
- * @param conn Ble connection handle
- * @param measured_temperature Measured temp
  */
-void set_temperature_measurement_value(struct bt_conn *conn, int32_t measured_temperature)
+void release_all_ble_connection_handles(void)
 {
     for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
+        if (cycle_connection_refs[i] != NULL)
         {
-            measurement_data[i].ambient_temp_measurement = measured_temperature;
-            k_sem_give(&read_response_sem);
-            break;
+            bt_conn_unref(cycle_connection_refs[i]);
+            cycle_connection_refs[i] = NULL;
         }
     }
 }
 
+#ifndef MEASUREMENTS_ASYNC_INGEST
+/**
+ * @brief Select if a connected node is read on the current cycle (see the polling
+ *        schedule of the measurements fsm). A node that is not due keeps the
+ *        measurements of its last read. Called after get_all_ble_connection_handles()
+ *
+ * @param device_index Index of the node on measurement_data (same as bluetooth_devices)
+ * @param is_due true if the node is read on this cycle
+ */
+void schedule_measurement_read(uint16_t device_index, bool is_due)
+{
+    if (device_index >= BLE_MAX_CONNECTIONS)
+    {
+        return;
+    }
+
+    is_read_held[device_index] = !is_due;
+    if (is_due)
+    {
+        reset_measurement_slot(device_index, measurement_connection_handle[device_index]);
+    }
+}
+#endif
+
+/**
+ * @brief Store the measured temperature on the measurement_data
+ *        This function is called from the read_characteristic_cb
+ *
+ * @param conn Ble connection handle
+ * @param measured_temperature Measured temp
+ */
+void set_temperature_measurement_value(struct bt_conn *conn, int16_t measured_temperature)
+{
+    push_measurement_sample(conn, MEASUREMENT_FIELD_TEMPERATURE, measured_temperature);
+}
+
 /**
  * @brief Store the measured humidity on the measurement_data
  *        This function is called from the read_characteristic_cb
@@ -89,17 +492,9 @@ void set_temperature_measurement_value(struct bt_conn *conn, int32_t measured_te
  * @param conn Ble connection handle
  * @param measured_humidity Measured humidity
  */
-void set_humidity_measurement_value(struct bt_conn *conn, int32_t measured_humidity)
+void set_humidity_measurement_value(struct bt_conn *conn, uint16_t measured_humidity)
 {
-    for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
-    {
-        if (measurement_data[i].ble_connection_handle == conn)
-        {
-            measurement_data[i].ambient_hum_measurement = measured_humidity;
-            k_sem_give(&read_response_sem);
-            break;
-        }
-    }
+    push_measurement_sample(conn, MEASUREMENT_FIELD_HUMIDITY, measured_humidity);
 }
 
 /**
@@ -109,17 +504,9 @@ void set_humidity_measurement_value(struct bt_conn *conn, int32_t measured_humid
  * @param conn 
  * @param soil_moisture 
  */
-void set_soil_moisture_measurement_value(struct bt_conn *conn, int32_t soil_moisture)
+void set_soil_moisture_measurement_value(struct bt_conn *conn, uint16_t soil_moisture)
 {
-    for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
-    {
-        if (measurement_data[i].ble_connection_handle == conn)
-        {
-            measurement_data[i].soil_moisture_measurement = soil_moisture;
-            k_sem_give(&read_response_sem);
-            break;
-        }
-    }
+    push_measurement_sample(conn, MEASUREMENT_FIELD_SOIL_MOISTURE, soil_moisture);
 }
 
 /**
@@ -129,17 +516,9 @@ void set_soil_moisture_measurement_value(struct bt_conn *conn, int32_t soil_mois
  * @param conn 
  * @param light_intensity 
  */
-void set_light_intensity_measurement_value(struct bt_conn *conn, int32_t light_intensity)
+void set_light_intensity_measurement_value(struct bt_conn *conn, uint16_t light_intensity)
 {
-    for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
-    {
-        if (measurement_data[i].ble_connection_handle == conn)
-        {
-            measurement_data[i].light_measurement = light_intensity;
-            k_sem_give(&read_response_sem);
-            break;
-        }
-    }
+    push_measurement_sample(conn, MEASUREMENT_FIELD_LIGHT_INTENSITY, light_intensity);
 }
 
 /**
@@ -151,26 +530,14 @@ void set_light_intensity_measurement_value(struct bt_conn *conn, int32_t light_i
  */
 void set_configuration_id_value(struct bt_conn *conn, uint8_t configuration_id)
 {
-    for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
+    push_measurement_sample(conn, MEASUREMENT_FIELD_ROW_ID, configuration_id);
+#ifdef BLE_AUTO_RECONNECT
+    if (get_measurement_data_index(conn) >= 0 && configuration_id > 0 && configuration_id <= MAX_CONFIGURATION_ID)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
-        {
-            measurement_data[i].row_id = configuration_id;
-            if (configuration_id > 0 && configuration_id <= MAX_CONFIGURATION_ID)
-            {
-                // Set row to registered
-                mean_row_measurements[configuration_id - 1].is_row_registered = true;
-                mean_row_measurements[configuration_id - 1].row_id = configuration_id;
-            }
-            else
-            {
-                LOG_INF("Configuration id issue: %d", configuration_id);
-            }
-
-            k_sem_give(&read_response_sem);
-            break;
-        }
+        // Row assigned nodes are reconnected by the controller when they drop
+        add_known_device(bt_conn_get_dst(conn));
     }
+#endif
 }
 
 /**
@@ -182,20 +549,68 @@ void set_configuration_id_value(struct bt_conn *conn, uint8_t configuration_id)
  */
 void set_battery_level_value(struct bt_conn *conn, uint8_t battery_level)
 {
-    for (int i = 0; i < BLE_MAX_CONNECTIONS; i++)
+    push_measurement_sample(conn, MEASUREMENT_FIELD_BATTERY_LEVEL, battery_level);
+}
+
+/**
+ * @brief Store the sampling epoch of the measurements of a sensor node
+ *        This function is called from the read_characteristic_cb, after the
+ *        measurements of a measurement record were stored
+ *
+ * @param conn Ble connection handle
+ * @param epoch Sampling epoch of the record
+ */
+void set_sampling_epoch_value(struct bt_conn *conn, uint16_t epoch)
+{
+    push_measurement_sample(conn, MEASUREMENT_FIELD_SAMPLING_EPOCH, epoch);
+}
+
+/**
+ * @brief Store the result of the read sequence of a sensor node
+ *        This function is called from the read_characteristic_cb after every
+ *        characteristic of the node was read, or after a read failed
+ *
+ * @param device_index Index of the node on measurement_data (same as bluetooth_devices)
+ * @param err 0 if all characteristics were read, error code otherwise
+ */
+void set_read_sequence_result(uint8_t device_index, int err)
+{
+    if (device_index >= BLE_MAX_CONNECTIONS)
     {
-        if (measurement_data[i].ble_connection_handle == conn)
-        {
-            measurement_data[i].battery_level = battery_level;
-            k_sem_give(&read_response_sem);
-            break;
-        }
+        return;
+    }
+
+#ifdef BLE_ROTATION_MODE
+    // Rotated nodes are read by the ble discovery thread, one node at a time
+    if (device_index == rotated_read_slot)
+    {
+        rotated_read_slot = UINT8_MAX;
+        rotated_read_result = err;
+        k_sem_give(&rotated_read_sem);
+        return;
+    }
+#endif
+
+    // Results that arrive after the cycle timed out are ignored
+    if (!atomic_test_and_clear_bit(read_pending_slots, device_index))
+    {
+        return;
+    }
+
+    if (err)
+    {
+        atomic_set_bit(read_failed_slots, device_index);
     }
+
+    k_sem_give(&read_response_sem);
 }
 
 /**
  * @brief function to take measurements from every connected device (sensor node)
- *        It actually reads every characteristic of the measurement service
+ *        It actually reads every characteristic of the measurement service.
+ *        A read sequence is started on every due connected node at once, then the
+ *        function waits until every node reports its result or the cycle times out.
+ *        Nodes that are not due keep the measurements of their last read
  *
  *
  * @return true if at least one measurement was taken, false if no measurements taken
@@ -205,48 +620,371 @@ bool measurements_and_device_data(void)
 {
     int err;
     uint8_t measurement_taken = 0;
-    // Take measurements from every connected sensor node
+    uint8_t reads_in_flight = 0;
+    int64_t remaining_time;
+    int64_t cycle_deadline;
+    k_spinlock_key_t key;
+
+    k_sem_reset(&read_response_sem);
     for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
     {
-        if (measurement_data[index].ble_connection_handle != NULL)
+        atomic_clear_bit(read_pending_slots, index);
+        atomic_clear_bit(read_failed_slots, index);
+    }
+    // The nodes sampled at the start of this epoch
+    cycle_epoch = get_sampling_epoch();
+    // Late responses of the previous cycle, only kept for the nodes that are not read again
+    drain_measurement_samples();
+
+    // Start a read sequence on every connected sensor node that is due
+    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        if (measurement_connection_handle[index] != NULL)
         {
-            measurement_taken++;
-            for (int char_index = 0; char_index < MEASUREMENT_SERVICE_CHARACTERISTIC_COUNT + CONFIGURE_SERVICE_CHARACTERISTIC_COUNT; char_index++)
+            // Nodes that are not due keep the measurements of their last read
+            if (is_read_held[index])
             {
-                // Reading every characteristic value from measurement service. (As measurement service gets bigger, we will not need to change this function)
-                read_characteristic_wrapper(measurement_data[index].ble_connection_handle, char_index);
-                err = k_sem_take(&read_response_sem, K_MSEC(1500));
-                if(err != 0)
+                if (is_measurement_data_valid(index))
                 {
-                    LOG_INF("Error in characteristics read:%d", err);
-                    measurement_data[index].ble_connection_handle = NULL;
-                    // Measurement was invalid, so reduce measurement counter
-                    measurement_taken--;
-                    break;
+                    register_measurement_row(measurement_data[index].row_id);
                 }
+                continue;
             }
+
+            // Short connection interval while reading, the nodes relax again after the cycle
+            set_connection_profile(measurement_connection_handle[index], BLE_BURST_PROFILE);
+            atomic_set_bit(read_pending_slots, index);
+            // Reading every characteristic value from measurement service. (As measurement service gets bigger, we will not need to change this function)
+            err = read_all_characteristics_wrapper(measurement_connection_handle[index]);
+            if (err)
+            {
+                LOG_INF("Error in characteristics read:%d", err);
+                atomic_clear_bit(read_pending_slots, index);
+                key = k_spin_lock(&measurement_slot_lock);
+                measurement_connection_handle[index] = NULL;
+                k_spin_unlock(&measurement_slot_lock, key);
+                continue;
+            }
+            reads_in_flight++;
+        }
+    }
+
+    // Wait for every sensor node to complete its read sequence
+    cycle_deadline = k_uptime_get() + READ_CYCLE_TIMEOUT_MS;
+    while (reads_in_flight > 0)
+    {
+        remaining_time = cycle_deadline - k_uptime_get();
+        if (remaining_time <= 0 || k_sem_take(&read_response_sem, K_MSEC(remaining_time)) != 0)
+        {
+            break;
+        }
+        reads_in_flight--;
+        // The values of a node are on the ingest ring before its read sequence result
+        drain_measurement_samples();
+    }
+    set_all_connections_profile(BLE_IDLE_PROFILE);
+    drain_measurement_samples();
+
+    // Nodes that timed out or failed keep the fields that were read (see valid_fields)
+    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        err = 0;
+        if (atomic_test_and_clear_bit(read_pending_slots, index))
+        {
+            LOG_INF("Characteristics read timed out, slot: %d", index);
+            err = -ETIMEDOUT;
+        }
+        else if (atomic_test_bit(read_failed_slots, index))
+        {
+            LOG_INF("Some characteristics were not read, slot: %d", index);
+            err = -EIO;
+        }
+
+        // Link quality of every node read on this cycle
+        if (measurement_connection_handle[index] != NULL && !is_read_held[index])
+        {
+            ble_link_stats_record_read(measurement_connection_handle[index], err);
+        }
+
+        if (is_measurement_data_valid(index))
+        {
+            measurement_taken++;
+        }
+    }
+
+    return (measurement_taken > 0) ? true : false;
+}
+
+/**
+ * @brief Tells if the data of a measurement_data slot can be used on the current cycle
+ *        Only the fields flagged on valid_fields should be used then
+ *
+ * @param device_index Index of the node on measurement_data
+ * @return true if at least one measurement of the node was read (poll mode),
+ *         pushed recently (push mode) or read on its last service (rotation mode)
+ */
+bool is_measurement_data_valid(uint16_t device_index)
+{
+    if (device_index >= MEASUREMENT_DATA_SIZE ||
+        (measurement_data[device_index].valid_fields & MEASUREMENT_VALUES_VALID_MASK) == 0)
+    {
+        return false;
+    }
+
+#ifdef MEASUREMENTS_ASYNC_INGEST
+    // Rotated nodes are disconnected after their service, only their age matters
+    return is_ingested_measurement_valid[device_index];
+#else
+    return measurement_connection_handle[device_index] != NULL;
+#endif
+}
+
+/**
+ * @brief Tells if the measurements of a node were sampled on the epoch of the
+ *        current cycle, so that row means combine measurements of the same instant
+ *
+ * @param device_index Index of the node on measurement_data
+ * @return true if the node sampled on the cycle epoch, or has no time base. Always
+ *         true in push, rotation and telemetry modes, where the nodes are sampled
+ *         on different epochs by design
+ */
+bool is_measurement_in_cycle_epoch(uint16_t device_index)
+{
+#ifdef MEASUREMENTS_ASYNC_INGEST
+    ARG_UNUSED(device_index);
+    return true;
+#else
+    if (device_index >= MEASUREMENT_DATA_SIZE)
+    {
+        return false;
+    }
+
+    // Nodes that were not due on this cycle are used with their last measurements
+    return is_read_held[device_index] ||
+           measurement_epoch[device_index] == MEASUREMENT_EPOCH_UNSYNCHRONIZED ||
+           measurement_epoch[device_index] == cycle_epoch;
+#endif
+}
+
+#ifdef MEASUREMENTS_ASYNC_INGEST
+/**
+ * @brief Assign a measurement_data slot to a sensor node that is about to push
+ *        its measurements (or to be read, in rotation mode). The measurements of
+ *        a previous node of the slot are cleared by the measurements thread
+ *
+ * @param device_index Index of the node on measurement_data (same as bluetooth_devices,
+ *        or the node registry in rotation mode)
+ * @param conn Ble connection handle
+ */
+void set_measurement_connection_handle(uint16_t device_index, struct bt_conn *conn)
+{
+    k_spinlock_key_t key;
+
+    if (device_index >= MEASUREMENT_DATA_SIZE)
+    {
+        return;
+    }
+
+    key = k_spin_lock(&measurement_slot_lock);
+    if (conn != NULL && bt_addr_le_cmp(&measurement_slot_address[device_index], bt_conn_get_dst(conn)))
+    {
+        bt_addr_le_copy(&measurement_slot_address[device_index], bt_conn_get_dst(conn));
+        measurement_slot_start_time[device_index] = k_uptime_get_32();
+    }
+    measurement_connection_handle[device_index] = conn;
+    k_spin_unlock(&measurement_slot_lock, key);
+}
+
+/**
+ * @brief Push and rotation mode counterpart of measurements_and_device_data().
+ *        Nothing is read, the measurements received by the bt threads are taken
+ *        from the ingest ring. Only the recent ones are used, and their rows are registered
+ *
+ * @return true if at least one node has recent measurements, false otherwise
+ */
+bool ingested_measurements_and_device_data(void)
+{
+    uint16_t measurement_taken = 0;
+    uint32_t now;
+
+    drain_measurement_samples();
+    now = k_uptime_get_32();
+    for (int index = 0; index < MEASUREMENT_DATA_SIZE; index++)
+    {
+        refresh_measurement_slot_owner(index);
+        is_ingested_measurement_valid[index] = measurement_update_time[index] != 0 &&
+                                               (now - measurement_update_time[index]) <= INGESTED_MEASUREMENT_MAX_AGE_MS;
+#ifdef MEASUREMENTS_PUSH_MODE
+        is_ingested_measurement_valid[index] &= get_measurement_connection_handle(index) != NULL;
+#endif
+        if (!is_ingested_measurement_valid[index])
+        {
+            continue;
         }
+
+        register_measurement_row(measurement_data[index].row_id);
+        measurement_taken++;
     }
 
     return (measurement_taken > 0) ? true : false;
 }
+#endif // MEASUREMENTS_ASYNC_INGEST
+
+#ifdef MEASUREMENTS_PUSH_MODE
+/**
+ * @brief Release the measurement_data slots of nodes that are no longer connected
+ *        (or whose slot is now used by another connection)
+ *
+ */
+void refresh_pushed_measurement_slots(void)
+{
+    struct bt_conn *conn;
+
+    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        conn = get_measurement_connection_handle(index);
+        if (conn != NULL && conn != get_ble_conn_handles(index))
+        {
+            memset(&measurement_data[index], 0, sizeof(measurements_data_t));
+            measurement_update_time[index] = 0;
+        }
+    }
+}
+#endif // MEASUREMENTS_PUSH_MODE
+
+#ifdef BLE_ROTATION_MODE
+/**
+ * @brief Read every characteristic of a rotated sensor node, during its time slice.
+ *        Called by the ble discovery thread once the node is discovered. The node
+ *        keeps its measurement_data slot (its registry index) between services,
+ *        the values it sends replace its previous ones when the measurements
+ *        thread drains the ingest ring (the fields that failed keep their last value)
+ *
+ * @param node_index Registry index of the node
+ * @param conn Ble connection handle
+ * @return true if every characteristic of the node was read
+ */
+bool rotated_node_measurements(uint16_t node_index, struct bt_conn *conn)
+{
+    int slot_index = get_device_index_by_conn_handle(conn);
+    bool is_read = false;
+
+    if (slot_index < 0 || node_index >= MEASUREMENT_DATA_SIZE)
+    {
+        return false;
+    }
+
+    set_measurement_connection_handle(node_index, conn);
+
+    k_sem_reset(&rotated_read_sem);
+    rotated_read_slot = slot_index;
+    if (read_all_characteristics_wrapper(conn))
+    {
+        LOG_INF("Rotated node read failed, node: %d", node_index);
+        rotated_read_slot = UINT8_MAX;
+    }
+    else if (k_sem_take(&rotated_read_sem, K_MSEC(ROTATED_READ_TIMEOUT_MS)) != 0)
+    {
+        LOG_INF("Rotated node read failed, node: %d", node_index);
+        rotated_read_slot = UINT8_MAX;
+        ble_link_stats_record_read(conn, -ETIMEDOUT);
+    }
+    else
+    {
+        if (rotated_read_result)
+        {
+            LOG_INF("Some characteristics were not read, node: %d", node_index);
+        }
+        ble_link_stats_record_read(conn, rotated_read_result);
+        is_read = rotated_read_result == 0;
+    }
+
+    // The node is disconnected after its service, the connection handle is not kept
+    set_measurement_connection_handle(node_index, NULL);
+
+    return is_read;
+}
+#endif // BLE_ROTATION_MODE
+
+#ifdef BLE_ADV_TELEMETRY_MODE
+/**
+ * @brief Store the measurement record advertised by a sensor node (connectionless
+ *        telemetry mode). This function is called from the scanner callback;
+ *        repeated advertisements of the same record are skipped
+ *
+ * @param node_index Registry index of the node
+ * @param addr Address of the node
+ * @param record Advertised record (already checked for company id and version)
+ * @return true if the record is new
+ */
+bool set_advertised_measurements(uint16_t node_index, const bt_addr_le_t *addr, const measurement_record_t *record)
+{
+    k_spinlock_key_t key;
+
+    if (node_index >= MEASUREMENT_DATA_SIZE)
+    {
+        return false;
+    }
+
+    key = k_spin_lock(&measurement_slot_lock);
+    if (bt_addr_le_cmp(&measurement_slot_address[node_index], addr))
+    {
+        // The registry index was given to another node
+        bt_addr_le_copy(&measurement_slot_address[node_index], addr);
+        measurement_slot_start_time[node_index] = k_uptime_get_32();
+        is_advertised_sequence_valid[node_index] = false;
+    }
+    k_spin_unlock(&measurement_slot_lock, key);
+
+    if (is_advertised_sequence_valid[node_index] &&
+        advertised_sequence_number[node_index] == record->sequence_number)
+    {
+        return false;
+    }
+
+    // The record is stored whole or not at all, a record split by a full ring would leave
+    // its measurements with the epoch of the previous one. A dropped record is taken
+    // again from the next advertisement of the node
+    if (!measurements_ingest_ring_reserve(ADVERTISED_RECORD_SAMPLE_COUNT))
+    {
+        return false;
+    }
+
+    advertised_sequence_number[node_index] = record->sequence_number;
+    is_advertised_sequence_valid[node_index] = true;
+    // Every field is advertised at once, the epoch of the record is set after its measurements
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_TEMPERATURE, (int16_t)sys_le16_to_cpu(record->values.temperature));
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_HUMIDITY, sys_le16_to_cpu(record->values.humidity));
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_SOIL_MOISTURE, sys_le16_to_cpu(record->values.soil_moisture));
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_LIGHT_INTENSITY, sys_le16_to_cpu(record->values.light_intensity));
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_BATTERY_LEVEL, record->battery_level);
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_ROW_ID, record->row_id);
+    measurements_ingest_ring_push(node_index, MEASUREMENT_FIELD_SAMPLING_EPOCH, sys_le16_to_cpu(record->epoch));
+
+    return true;
+}
+#endif // BLE_ADV_TELEMETRY_MODE
 
 // TODO: just for debug
 void print_all_measurements_and_connection_handles(void)
 {
+    char addr[BT_ADDR_LE_STR_LEN];
+
     // Take measurements from every connected sensor node
-    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    for (int index = 0; index < MEASUREMENT_DATA_SIZE; index++)
     {
-        if (measurement_data[index].ble_connection_handle != NULL)
+        if (measurement_connection_handle[index] != NULL)
         {
+            bt_addr_le_to_str(&measurement_data[index].peer_address, addr, sizeof(addr));
             LOG_INF("-----------------");
-            LOG_INF("Temperature is: %d.%d C", measurement_data[index].ambient_temp_measurement / 100, measurement_data[index].ambient_temp_measurement % 100);
-            LOG_INF("Humidity is: %d.%d percent", measurement_data[index].ambient_hum_measurement / 100, measurement_data[index].ambient_hum_measurement % 100);
-            LOG_INF("Soil moisture is: %d percent", measurement_data[index].soil_moisture_measurement);
-            LOG_INF("Light intensity is: %d", measurement_data[index].light_measurement);
+            LOG_INF("Address: %s", addr);
+            LOG_INF("Temperature is: %d.%d C", measurement_data[index].values.temperature / MEASUREMENT_VALUE_SCALE, measurement_data[index].values.temperature % MEASUREMENT_VALUE_SCALE);
+            LOG_INF("Humidity is: %d.%d percent", measurement_data[index].values.humidity / MEASUREMENT_VALUE_SCALE, measurement_data[index].values.humidity % MEASUREMENT_VALUE_SCALE);
+            LOG_INF("Soil moisture is: %d percent", measurement_data[index].values.soil_moisture / MEASUREMENT_VALUE_SCALE);
+            LOG_INF("Light intensity is: %d", measurement_data[index].values.light_intensity);
             LOG_INF("Battery level is: %d percent", measurement_data[index].battery_level);
             LOG_INF("Configuration id is: %d", measurement_data[index].row_id);
-            LOG_INF("Conn handle: %d", (int)measurement_data[index].ble_connection_handle);
+            LOG_INF("Conn handle: %d", (int)measurement_connection_handle[index]);
             LOG_INF("-----------------");
         }
     }
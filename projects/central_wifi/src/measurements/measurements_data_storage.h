@@ -5,24 +5,68 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "common.h"
+#include "ble_client/ble_node_registry.h"
+
+// --- defines -----------------------------------------------------------------
+#if defined(MEASUREMENTS_PUSH_MODE) && (defined(BLE_ROTATION_MODE) || defined(BLE_ADV_TELEMETRY_MODE))
+#error "MEASUREMENTS_PUSH_MODE can not be used with BLE_ROTATION_MODE or BLE_ADV_TELEMETRY_MODE"
+#endif
+// In rotation and telemetry modes measurement_data keeps one slot per registered
+// node, otherwise one slot per connection
+#if defined(BLE_ROTATION_MODE) || defined(BLE_ADV_TELEMETRY_MODE)
+#define MEASUREMENTS_NODE_REGISTRY_SLOTS
+#endif
+// Measurements are stored by the bt threads whenever they arrive, instead of
+// being read by the measurements fsm on every cycle
+#if defined(MEASUREMENTS_PUSH_MODE) || defined(MEASUREMENTS_NODE_REGISTRY_SLOTS)
+#define MEASUREMENTS_ASYNC_INGEST
+#endif
+#ifdef MEASUREMENTS_NODE_REGISTRY_SLOTS
+#define MEASUREMENT_DATA_SIZE BLE_NODE_REGISTRY_SIZE
+#else
+#define MEASUREMENT_DATA_SIZE BLE_MAX_CONNECTIONS
+#endif
 
 // --- functions declartations -------------------------------------------------
-void set_temperature_measurement_value(struct bt_conn *conn, int32_t measured_temperature);
-void set_humidity_measurement_value(struct bt_conn *conn, int32_t measured_humidity);
-void set_soil_moisture_measurement_value(struct bt_conn *conn, int32_t soil_moisture);
-void set_light_intensity_measurement_value(struct bt_conn *conn, int32_t light_intensity);
+void set_temperature_measurement_value(struct bt_conn *conn, int16_t measured_temperature);
+void set_humidity_measurement_value(struct bt_conn *conn, uint16_t measured_humidity);
+void set_soil_moisture_measurement_value(struct bt_conn *conn, uint16_t soil_moisture);
+void set_light_intensity_measurement_value(struct bt_conn *conn, uint16_t light_intensity);
 
 void set_configuration_id_value(struct bt_conn *conn, uint8_t configuration_id);
 void set_battery_level_value(struct bt_conn *conn, uint8_t battery_level);
+void set_sampling_epoch_value(struct bt_conn *conn, uint16_t epoch);
+void set_read_sequence_result(uint8_t device_index, int err);
 
 bool measurements_and_device_data(void);
+bool is_measurement_data_valid(uint16_t device_index);
+bool is_measurement_in_cycle_epoch(uint16_t device_index);
+#ifndef MEASUREMENTS_ASYNC_INGEST
+void schedule_measurement_read(uint16_t device_index, bool is_due);
+#endif
+#ifdef MEASUREMENTS_ASYNC_INGEST
+void set_measurement_connection_handle(uint16_t device_index, struct bt_conn *conn);
+bool ingested_measurements_and_device_data(void);
+#endif
+#ifdef MEASUREMENTS_PUSH_MODE
+void refresh_pushed_measurement_slots(void);
+#endif
+#ifdef BLE_ROTATION_MODE
+bool rotated_node_measurements(uint16_t node_index, struct bt_conn *conn);
+#endif
+#ifdef BLE_ADV_TELEMETRY_MODE
+bool set_advertised_measurements(uint16_t node_index, const bt_addr_le_t *addr, const measurement_record_t *record);
+#endif
 
-void clear_measurement_data(void);
+void clear_row_mean_data(void);
 void get_all_ble_connection_handles(void);
+void release_all_ble_connection_handles(void);
 
 void print_all_measurements_and_connection_handles(void);
 
 measurements_data_t* get_measurements_data(void);
 row_mean_data_t* get_row_mean_data(void);
+const uint8_t *get_registered_rows(void);
+struct bt_conn *get_measurement_connection_handle(uint16_t device_index);
 
 #endif // MEASUREMENTS_DATA_STORAGE_H
\ No newline at end of file
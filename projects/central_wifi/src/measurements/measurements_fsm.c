@@ -8,7 +8,10 @@
 // --- includes ----------------------------------------------------------------
 #include "measurements_fsm.h"
 #include "measurements_data_storage.h"
+#include "row_estimator.h"
+#include "row_window.h"
 #include "ble_client/ble_connection_data.h"
+#include "ble_client/ble_link_stats.h"
 #include "common.h"
 #include "com_protocol/com_protocol.h"
 #include "environment_control/environment_control_config.h"
@@ -20,10 +23,28 @@
 #include <zephyr/smf.h>
 #include <zephyr/logging/log.h>
 #include <coap_client/coap_fsm.h>
+#include <stdlib.h>
+#include <string.h>
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(measurements_m);
 
+// --- defines -----------------------------------------------------------------
+#ifndef MEASUREMENTS_ASYNC_INGEST
+// Polling schedule of every node: its polling period is a multiple of
+// MEASUREMENT_PERIOD_IN_SEC, stretched while its readings are stable and on low battery
+#define NODE_POLL_MAX_PERIOD_MULTIPLIER 8
+#define NODE_POLL_MAX_STABLE_MULTIPLIER 4
+// Battery levels (%) under which the polling period is doubled, or multiplied by 4
+#define NODE_POLL_LOW_BATTERY_LEVEL 50
+#define NODE_POLL_CRITICAL_BATTERY_LEVEL 20
+// Readings changed quickly if one of them moved more than this since the last poll
+#define NODE_POLL_TEMPERATURE_CHANGE 50 // 0.5 C
+#define NODE_POLL_HUMIDITY_CHANGE 200 // 2 %
+#define NODE_POLL_SOIL_MOISTURE_CHANGE 300 // 3 %
+#define NODE_POLL_LIGHT_CHANGE_PERCENT 10
+#endif
+
 // --- enums -------------------------------------------------------------------
 // List of states
 enum ble_state_e
@@ -35,6 +56,20 @@ enum ble_state_e
     THREAD_SLEEP
 };
 
+// Measurement fields that are averaged per row. The index of a field is also the
+// bit of its valid flag (see MEASUREMENT_TEMPERATURE_VALID)
+enum row_field_e
+{
+    ROW_FIELD_TEMPERATURE = 0,
+    ROW_FIELD_HUMIDITY,
+    ROW_FIELD_SOIL_MOISTURE,
+    ROW_FIELD_LIGHT,
+    ROW_FIELD_COUNT
+};
+BUILD_ASSERT(BIT(ROW_FIELD_TEMPERATURE) == MEASUREMENT_TEMPERATURE_VALID && BIT(ROW_FIELD_HUMIDITY) == MEASUREMENT_HUMIDITY_VALID &&
+             BIT(ROW_FIELD_SOIL_MOISTURE) == MEASUREMENT_SOIL_MOISTURE_VALID && BIT(ROW_FIELD_LIGHT) == MEASUREMENT_LIGHT_VALID,
+             "Row fields must follow the measurement valid flags");
+
 // --- structs -----------------------------------------------------------------
 // User defined object
 struct user_object_s
@@ -46,8 +81,33 @@ struct user_object_s
     measurements_data_t *measurements_data;
     // will get the memory location of row_mean_data_t mean_row_measurements
     row_mean_data_t *row_mean_data;
+    // Mean values of every row that were calculated on this cycle (see MEASUREMENT_TEMPERATURE_VALID)
+    uint8_t row_valid_fields[MAX_CONFIGURATION_ID];
+    // Rows with mean values on this cycle, and rows that had mean values on the
+    // previous cycle but not on this one (row bitmaps)
+    uint8_t registered_rows[ROW_BITMAP_SIZE];
+    uint8_t dropped_rows[ROW_BITMAP_SIZE];
 } measurements_fsm_user_object;
 
+#ifndef MEASUREMENTS_ASYNC_INGEST
+// Polling schedule of a node (same indexing as measurement_data)
+typedef struct node_schedule_s
+{
+    // Node the schedule belongs to, a node that is new on the slot is polled right away.
+    // Connection objects and slots are reused, so the node is told by its address
+    bt_addr_le_t peer_address;
+    bool has_owner;
+    // Uptime (ms) the node is due to be polled again
+    int64_t next_due_time;
+    // Doubled on every poll with stable readings, reset when they change quickly
+    uint8_t stable_multiplier;
+    // true if the node is polled on the current cycle
+    bool is_polled;
+    // Readings of the last poll
+    measurements_data_t last_readings;
+} node_schedule_t;
+#endif
+
 // --- static function declarations --------------------------------------------
 static void take_measurements_entry(void *o);
 static void take_measurements_run(void *o);
@@ -62,6 +122,17 @@ static void send_data_to_cloud_run(void *o);
 
 static void thread_sleep_run(void *o);
 
+static int32_t get_node_field_value(const measurements_data_t *node, uint8_t row_field);
+static bool is_node_in_row_means(uint16_t measurement_data_index, const row_mean_data_t *row_mean_data);
+static void bucket_nodes_by_row(const measurements_data_t *measurements_data, const row_mean_data_t *row_mean_data);
+
+#ifndef MEASUREMENTS_ASYNC_INGEST
+static bool is_node_due(uint16_t index, int64_t now);
+static bool is_schedule_owner(const node_schedule_t *schedule, struct bt_conn *conn);
+static bool are_readings_changed(const measurements_data_t *node, const measurements_data_t *last_readings);
+static void update_node_schedule(uint16_t index, const measurements_data_t *node, int64_t now);
+#endif
+
 // --- static variables definitions --------------------------------------------
 // Populate state table
 static const struct smf_state measurement_states[] = {
@@ -71,9 +142,20 @@ static const struct smf_state measurement_states[] = {
     [send_data_to_cloud] = SMF_CREATE_STATE(send_data_to_cloud_entry, send_data_to_cloud_run, NULL),
     [THREAD_SLEEP] = SMF_CREATE_STATE(NULL, thread_sleep_run, NULL),
 };
+#ifndef MEASUREMENTS_ASYNC_INGEST
+static node_schedule_t node_schedule[BLE_MAX_CONNECTIONS];
+#endif
+// Nodes (measurement_data indexes) of every row, bucketed on every cycle. The nodes of
+// row id = 1 + r are row_nodes[row_node_offset[r]] to row_nodes[row_node_offset[r] + row_node_count[r] - 1]
+static uint16_t row_node_count[MAX_CONFIGURATION_ID];
+static uint16_t row_node_offset[MAX_CONFIGURATION_ID];
+static uint16_t row_nodes[MEASUREMENT_DATA_SIZE];
+// Measurements of a field by the nodes of a row, given to the row estimator
+static int32_t row_field_values[MEASUREMENT_DATA_SIZE];
 
 // --- variables definitions ---------------------------------------------------
-// Semaphore to know when a characteristic read process is completed
+// Semaphore to know when the read sequence of a sensor node is completed
+// (given once per node, so it counts up to BLE_MAX_CONNECTIONS)
 struct k_sem read_response_sem;
 // This semaphore is meant to be increased and decreased only by ble connected and disconnected cb functions
 struct k_sem at_least_one_active_connection_sem;
@@ -81,20 +163,271 @@ extern struct k_event env_control_event;
 struct k_event measurements_fsm_event;
 
 // --- static function definitions ---------------------------------------------
+/**
+ * @brief Get a measurement of a node by row field
+ *
+ * @param node Measurements of the node
+ * @param row_field Takes values like: ROW_FIELD_TEMPERATURE
+ * @return measurement value
+ */
+static int32_t get_node_field_value(const measurements_data_t *node, uint8_t row_field)
+{
+    switch (row_field)
+    {
+    case ROW_FIELD_TEMPERATURE:
+        return node->values.temperature;
+    case ROW_FIELD_HUMIDITY:
+        return node->values.humidity;
+    case ROW_FIELD_SOIL_MOISTURE:
+        return node->values.soil_moisture;
+    case ROW_FIELD_LIGHT:
+        return node->values.light_intensity;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Tells if a node is used for the row means of this cycle: it was measured
+ *        on this cycle (at the same instant as the other nodes) and belongs to a
+ *        registered row
+ *
+ * @param measurement_data_index Index of the node on measurement_data
+ * @param row_mean_data Row mean data of every row
+ * @return true if the measurements of the node are used
+ */
+static bool is_node_in_row_means(uint16_t measurement_data_index, const row_mean_data_t *row_mean_data)
+{
+    uint8_t row_id = get_measurements_data()[measurement_data_index].row_id;
+
+    return is_measurement_data_valid(measurement_data_index) &&
+           is_measurement_in_cycle_epoch(measurement_data_index) &&
+           row_id > 0 && row_id <= MAX_CONFIGURATION_ID &&
+           row_mean_data[row_id - 1].is_row_registered;
+}
+
+/**
+ * @brief Bucket the nodes by row (counting sort on the row id): one pass counts the
+ *        nodes of every row, one pass places them after the nodes of the previous rows
+ *
+ * @param measurements_data Measurements of every node
+ * @param row_mean_data Row mean data of every row
+ */
+static void bucket_nodes_by_row(const measurements_data_t *measurements_data, const row_mean_data_t *row_mean_data)
+{
+    uint16_t row_fill[MAX_CONFIGURATION_ID] = {0};
+    uint16_t offset = 0;
+    uint8_t row_index;
+
+    memset(row_node_count, 0, sizeof(row_node_count));
+    for (uint16_t index = 0; index < MEASUREMENT_DATA_SIZE; index++)
+    {
+        if (is_node_in_row_means(index, row_mean_data))
+        {
+            row_node_count[measurements_data[index].row_id - 1]++;
+        }
+    }
+
+    for (row_index = 0; row_index < MAX_CONFIGURATION_ID; row_index++)
+    {
+        row_node_offset[row_index] = offset;
+        offset += row_node_count[row_index];
+    }
+
+    for (uint16_t index = 0; index < MEASUREMENT_DATA_SIZE; index++)
+    {
+        if (is_node_in_row_means(index, row_mean_data))
+        {
+            row_index = measurements_data[index].row_id - 1;
+            row_nodes[row_node_offset[row_index] + row_fill[row_index]] = index;
+            row_fill[row_index]++;
+        }
+    }
+}
+
+#ifndef MEASUREMENTS_ASYNC_INGEST
+/**
+ * @brief Tells if a node must be polled on the current cycle
+ *
+ * @param index Index of the node on measurement_data
+ * @param now Uptime (ms) of the cycle
+ * @return true if the next due time of the node passed, or the node is new on the slot
+ */
+static bool is_node_due(uint16_t index, int64_t now)
+{
+    if (!is_schedule_owner(&node_schedule[index], get_ble_conn_handles(index)))
+    {
+        return true;
+    }
+
+    // Half a period of tolerance, so the timer jitter does not skip a cycle
+    return now >= node_schedule[index].next_due_time - SAMPLING_EPOCH_PERIOD_MS / 2;
+}
+
+/**
+ * @brief Tells if the readings of a node changed quickly since its last poll. Only
+ *        fields that were read on both polls are compared
+ *
+ * @param node Readings of this cycle
+ * @param last_readings Readings of the last poll
+ * @return true if at least one reading moved more than its change threshold
+ */
+static bool are_readings_changed(const measurements_data_t *node, const measurements_data_t *last_readings)
+{
+    uint8_t valid_fields = node->valid_fields & last_readings->valid_fields;
+
+    if ((valid_fields & MEASUREMENT_TEMPERATURE_VALID) &&
+        abs(node->values.temperature - last_readings->values.temperature) > NODE_POLL_TEMPERATURE_CHANGE)
+    {
+        return true;
+    }
+    if ((valid_fields & MEASUREMENT_HUMIDITY_VALID) &&
+        abs(node->values.humidity - last_readings->values.humidity) > NODE_POLL_HUMIDITY_CHANGE)
+    {
+        return true;
+    }
+    if ((valid_fields & MEASUREMENT_SOIL_MOISTURE_VALID) &&
+        abs(node->values.soil_moisture - last_readings->values.soil_moisture) > NODE_POLL_SOIL_MOISTURE_CHANGE)
+    {
+        return true;
+    }
+    // Light changes are relative to the last reading (lux range is wide)
+    if ((valid_fields & MEASUREMENT_LIGHT_VALID) &&
+        abs(node->values.light_intensity - last_readings->values.light_intensity) * 100 >
+            last_readings->values.light_intensity * NODE_POLL_LIGHT_CHANGE_PERCENT)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Tells if the schedule of a slot belongs to the node of a connection
+ *
+ * @param schedule Schedule of the slot
+ * @param conn Connection of the slot, can be NULL
+ * @return true if the schedule was set for the same node (address)
+ */
+static bool is_schedule_owner(const node_schedule_t *schedule, struct bt_conn *conn)
+{
+    return conn != NULL && schedule->has_owner &&
+           bt_addr_le_cmp(&schedule->peer_address, bt_conn_get_dst(conn)) == 0;
+}
+
+/**
+ * @brief Set the next due time of a node that was polled on this cycle. The polling
+ *        period tightens back to MEASUREMENT_PERIOD_IN_SEC when the readings change
+ *        quickly, and it is stretched while they are stable or the battery is low
+ *
+ * @param index Index of the node on measurement_data
+ * @param node Readings of this cycle
+ * @param now Uptime (ms) of the cycle
+ */
+static void update_node_schedule(uint16_t index, const measurements_data_t *node, int64_t now)
+{
+    node_schedule_t *schedule = &node_schedule[index];
+    struct bt_conn *conn = get_measurement_connection_handle(index);
+    uint8_t multiplier;
+
+    // A node that was not read is polled again on the next cycle
+    if (!is_measurement_data_valid(index) || conn == NULL)
+    {
+        schedule->has_owner = false;
+        return;
+    }
+
+    if (!is_schedule_owner(schedule, conn) || are_readings_changed(node, &schedule->last_readings))
+    {
+        schedule->stable_multiplier = 1;
+    }
+    else
+    {
+        schedule->stable_multiplier = MIN(schedule->stable_multiplier * 2, NODE_POLL_MAX_STABLE_MULTIPLIER);
+    }
+
+    multiplier = schedule->stable_multiplier;
+    if (node->valid_fields & MEASUREMENT_BATTERY_VALID)
+    {
+        if (node->battery_level < NODE_POLL_CRITICAL_BATTERY_LEVEL)
+        {
+            multiplier *= 4;
+        }
+        else if (node->battery_level < NODE_POLL_LOW_BATTERY_LEVEL)
+        {
+            multiplier *= 2;
+        }
+    }
+    multiplier = MIN(multiplier, NODE_POLL_MAX_PERIOD_MULTIPLIER);
+
+    bt_addr_le_copy(&schedule->peer_address, bt_conn_get_dst(conn));
+    schedule->has_owner = true;
+    schedule->next_due_time = now + multiplier * SAMPLING_EPOCH_PERIOD_MS;
+    schedule->last_readings = *node;
+}
+#endif // MEASUREMENTS_ASYNC_INGEST
+
 // --- TAKE_MEASUREMENTS state ---
 static void take_measurements_entry(void *o)
 {
-    // First clean measurement data as well as row mean measurement values
-    clear_measurement_data();
+#ifdef MEASUREMENTS_PUSH_MODE
+    // Measurement data is kept up to date by the nodes, only clean row mean values
+    clear_row_mean_data();
+    // And forget the nodes that disconnected
+    refresh_pushed_measurement_slots();
+#elif defined(MEASUREMENTS_NODE_REGISTRY_SLOTS)
+    // Measurement data is kept up to date by the node rotation (or the advertised
+    // records), only clean row mean values
+    clear_row_mean_data();
+    ble_node_registry_log_sampling_periods();
+#else
+    int64_t now = k_uptime_get();
+    uint8_t polled_nodes = 0;
+
+    // First clean row mean measurement values
+    clear_row_mean_data();
     // Then get the conn handles from all connected devices
     get_all_ble_connection_handles();
+    // Only the nodes that are due are read, the others keep their last measurements
+    for (uint16_t index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        node_schedule[index].is_polled = is_node_due(index, now);
+        schedule_measurement_read(index, node_schedule[index].is_polled);
+        if (node_schedule[index].is_polled && get_ble_conn_handles(index) != NULL)
+        {
+            polled_nodes++;
+        }
+    }
+    LOG_INF("Nodes polled on this cycle: %d", polled_nodes);
+#endif
 }
 
 static void take_measurements_run(void *o)
 {
     bool measurements_taken = false;
+#ifdef MEASUREMENTS_ASYNC_INGEST
+    // Use the measurements pushed or advertised by the nodes (or read during their rotation time slice)
+    measurements_taken = ingested_measurements_and_device_data();
+#else
+    int64_t now = k_uptime_get();
+
     // Take measurements and device data
     measurements_taken = measurements_and_device_data();
+    // Next due time of the nodes that were polled
+    for (uint16_t index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    {
+        if (node_schedule[index].is_polled)
+        {
+            update_node_schedule(index, &get_measurements_data()[index], now);
+        }
+    }
+    // Link parameters and read throughput of every node, for the link benchmark
+    log_link_throughput();
+    // The cycle is done with the connections of the nodes
+    release_all_ble_connection_handles();
+#endif
+    // Estimated radio duty cycle of the connections (burst and idle connection parameters)
+    log_radio_duty_cycle();
 
     if (measurements_taken)
     {
@@ -123,71 +456,88 @@ static void calculate_mean_measurements_entry(void *o)
 static void calculate_mean_measurements_run(void *o)
 {
     struct user_object_s *user_ctx = (struct user_object_s *)o;
-
-    // Go through all rows
-    for (int row_index = 0; row_index < MAX_CONFIGURATION_ID; row_index++)
+    const measurements_data_t *node;
+    row_mean_data_t *row;
+    int32_t row_values[ROW_FIELD_COUNT];
+    uint16_t value_count;
+    uint16_t rejected_count;
+    uint16_t row_index;
+
+    // Group the nodes of every row
+    bucket_nodes_by_row(user_ctx->measurements_data, user_ctx->row_mean_data);
+
+    // The rows of the previous cycle are dropped, unless they get mean values again
+    memcpy(user_ctx->dropped_rows, user_ctx->registered_rows, sizeof(user_ctx->dropped_rows));
+    memset(user_ctx->registered_rows, 0, sizeof(user_ctx->registered_rows));
+
+    // Then estimate the value of every field of every registered row (see ROW_ESTIMATOR)
+    ROW_BITMAP_FOR_EACH(get_registered_rows(), row_index)
     {
-        // Counter to know how many sensor nodes exist on a specific row
-        // will be used as: mean_humidity = (humidity_node1 + humidity_node2 +...) / measurements_counter
-        uint8_t measurements_counter = 0;
-
-        // Temporary variables to calculate mean measurement values
-        int32_t mean_ambient_humidity = 0;
-        int32_t mean_ambient_temperature = 0;
-        int32_t mean_soil_moisture = 0;
-        int32_t mean_light_intensity = 0;
+        row = &user_ctx->row_mean_data[row_index];
+        user_ctx->row_valid_fields[row_index] = 0;
+        rejected_count = 0;
 
-        // Check if row is registered/active (if at least one sensor node exist on this row), if not, skip
-        if (user_ctx->row_mean_data[row_index].is_row_registered)
+        for (uint8_t row_field = 0; row_field < ROW_FIELD_COUNT; row_field++)
         {
-            // If row is registered/active, grab all measurements from the nodes that belong to this particular row
-            // We are going through all connected sensor nodes and check on which row they belong
-            for (uint8_t measurement_data_index = 0; measurement_data_index < BLE_MAX_CONNECTIONS; measurement_data_index++)
+            // Only the fields that were read on this cycle are used
+            value_count = 0;
+            for (uint16_t node_index = 0; node_index < row_node_count[row_index]; node_index++)
             {
-                // Check if a sensor node belonds to the desired row
-                if (user_ctx->measurements_data[measurement_data_index].row_id == user_ctx->row_mean_data[row_index].row_id)
+                node = &user_ctx->measurements_data[row_nodes[row_node_offset[row_index] + node_index]];
+                if (node->valid_fields & BIT(row_field))
                 {
-                    // Mean row humidity
-                    mean_ambient_humidity += user_ctx->measurements_data[measurement_data_index].ambient_hum_measurement;
-                    // Mean row temp
-                    mean_ambient_temperature += user_ctx->measurements_data[measurement_data_index].ambient_temp_measurement;
-                    // Mean light intensity
-                    mean_light_intensity += user_ctx->measurements_data[measurement_data_index].light_measurement;
-                    // Mean soil moisture
-                    mean_soil_moisture += user_ctx->measurements_data[measurement_data_index].soil_moisture_measurement;
-                    // Increment measurement counter every time we find a node that exists on the row that is being currently referenced (row_index)
-                    measurements_counter++;
+                    row_field_values[value_count++] = get_node_field_value(node, row_field);
                 }
             }
-            // Calculate means (devide the measurement sum by the sensor nodes number)
-            mean_ambient_humidity /= measurements_counter;
-            mean_ambient_temperature /= measurements_counter;
-            mean_light_intensity /= measurements_counter;
-            mean_soil_moisture /= measurements_counter;
-            measurements_counter = 0;
-            // Save mean values for the corresponding row
-            user_ctx->row_mean_data[row_index].mean_row_humidity = mean_ambient_humidity;
-            user_ctx->row_mean_data[row_index].mean_row_light = mean_light_intensity;
-            user_ctx->row_mean_data[row_index].mean_row_soil_moisture = mean_soil_moisture;
-            user_ctx->row_mean_data[row_index].mean_row_temp = mean_ambient_temperature;
-            // Update the status of fan/water/lights for the corresponding row
-            user_ctx->row_mean_data[row_index].is_fan_active = get_row_fan_switch(row_index);
-            user_ctx->row_mean_data[row_index].is_watering_active = get_row_water_switch(row_index);
-            user_ctx->row_mean_data[row_index].are_lights_active = get_row_light_switch(row_index);
+
+            // A field that no node of the row measured on this cycle is not valid for the row
+            row_values[row_field] = estimate_row_value(row_field_values, value_count, &rejected_count);
+            if (value_count > 0)
+            {
+                user_ctx->row_valid_fields[row_index] |= BIT(row_field);
+                // The row value also joins the recent row values of the field
+                row_window_add(row_index, row_field, row_values[row_field]);
+            }
         }
+        // Every node of the row failed on this cycle, nothing to calculate
+        if (user_ctx->row_valid_fields[row_index] == 0)
+        {
+            row->is_row_registered = false;
+            continue;
+        }
+        // Save mean values for the corresponding row
+        row->mean.humidity = (uint16_t)row_values[ROW_FIELD_HUMIDITY];
+        row->mean.light_intensity = (uint16_t)row_values[ROW_FIELD_LIGHT];
+        row->mean.soil_moisture = (uint16_t)row_values[ROW_FIELD_SOIL_MOISTURE];
+        row->mean.temperature = (int16_t)row_values[ROW_FIELD_TEMPERATURE];
+        // Measurements left out by the estimator (outliers), over every field
+        row->rejected_readings = MIN(rejected_count, UINT8_MAX);
+        // Update the status of fan/water/lights for the corresponding row
+        row->is_fan_active = get_row_fan_switch(row_index);
+        row->is_watering_active = get_row_water_switch(row_index);
+        row->are_lights_active = get_row_light_switch(row_index);
+        ROW_BITMAP_SET(user_ctx->registered_rows, row_index);
+    }
+
+    // A row that is no longer registered forgets its recent row values
+    for (uint8_t byte_index = 0; byte_index < ROW_BITMAP_SIZE; byte_index++)
+    {
+        user_ctx->dropped_rows[byte_index] &= ~user_ctx->registered_rows[byte_index];
+    }
+    ROW_BITMAP_FOR_EACH(user_ctx->dropped_rows, row_index)
+    {
+        row_window_reset(row_index);
     }
 
     // TODO: just for debug
-    for (uint8_t index = 0; index < MAX_CONFIGURATION_ID; index++)
+    ROW_BITMAP_FOR_EACH(user_ctx->registered_rows, row_index)
     {
-        if (user_ctx->row_mean_data[index].is_row_registered)
-        {
-            LOG_INF(" ------- MEAN DATA --------- row id: %d", user_ctx->row_mean_data[index].row_id);
-            LOG_INF("Mean Temperature is: %d.%d C", user_ctx->row_mean_data[index].mean_row_temp / 100, user_ctx->row_mean_data[index].mean_row_temp % 100);
-            LOG_INF("Mean Humidity is: %d.%d percent", user_ctx->row_mean_data[index].mean_row_humidity / 100, user_ctx->row_mean_data[index].mean_row_humidity % 100);
-            LOG_INF("Mean Soil moisture is: %d percent", user_ctx->row_mean_data[index].mean_row_soil_moisture / 100);
-            LOG_INF("Mean Light intensity is: %d", user_ctx->row_mean_data[index].mean_row_light);
-        }
+        LOG_INF(" ------- MEAN DATA --------- row id: %d", user_ctx->row_mean_data[row_index].row_id);
+        LOG_INF("Mean Temperature is: %d.%d C", user_ctx->row_mean_data[row_index].mean.temperature / MEASUREMENT_VALUE_SCALE, user_ctx->row_mean_data[row_index].mean.temperature % MEASUREMENT_VALUE_SCALE);
+        LOG_INF("Mean Humidity is: %d.%d percent", user_ctx->row_mean_data[row_index].mean.humidity / MEASUREMENT_VALUE_SCALE, user_ctx->row_mean_data[row_index].mean.humidity % MEASUREMENT_VALUE_SCALE);
+        LOG_INF("Mean Soil moisture is: %d percent", user_ctx->row_mean_data[row_index].mean.soil_moisture / MEASUREMENT_VALUE_SCALE);
+        LOG_INF("Mean Light intensity is: %d", user_ctx->row_mean_data[row_index].mean.light_intensity);
+        LOG_INF("Rejected readings: %d", user_ctx->row_mean_data[row_index].rejected_readings);
     }
 
     smf_set_state(SMF_CTX(&measurements_fsm_user_object), &measurement_states[ENVIRONMENT_CONTROL]);
@@ -198,28 +548,45 @@ static void environment_control_run(void *o)
 {
 
     struct user_object_s *user_ctx = (struct user_object_s *)o;
+    row_window_data_t row_window;
+    uint16_t row_index;
     // Send measurements to cloud once every 10 minutes. This is a multiplier of measurements period.
     // Initialize it so that it sends the first measurement immediately
     static uint16_t measurements_ctr = MEASUREMENTS_SEND_TO_CLOUD_PERIOD_IN_SEC / MEASUREMENT_PERIOD_IN_SEC + 1;
     // Store the mean row measurements on the environment control module
     // environment control module will check what we set here to control the airflow/water/lights
-    for(uint8_t row_id = 0; row_id < MAX_CONFIGURATION_ID; row_id++)
+    // TODO: this should be moved to environment control fsm side with getters
+    // on measurements data storage side
+    ROW_BITMAP_FOR_EACH(user_ctx->registered_rows, row_index)
     {
-        // TODO: this should be moved to environment control fsm side with getters
-        // on measurements data storage side
-        if(user_ctx->row_mean_data[row_id].is_row_registered)
+        // A value that was not measured on this cycle keeps its previous value
+        if (user_ctx->row_valid_fields[row_index] & MEASUREMENT_HUMIDITY_VALID)
         {
-            set_row_current_humidity(user_ctx->row_mean_data[row_id].mean_row_humidity, row_id);
-            set_row_current_temperature(user_ctx->row_mean_data[row_id].mean_row_temp, row_id);
-            set_row_current_light_exposure(user_ctx->row_mean_data[row_id].mean_row_light, row_id);
-            set_row_current_soil_moisture(user_ctx->row_mean_data[row_id].mean_row_soil_moisture, row_id);
-            set_row_registered(row_id);
+            set_row_current_humidity(user_ctx->row_mean_data[row_index].mean.humidity, row_index);
         }
-        else
+        if (user_ctx->row_valid_fields[row_index] & MEASUREMENT_TEMPERATURE_VALID)
         {
-            // if a row at a point is not registered, reset its status
-            reset_row_status(row_id);
+            set_row_current_temperature(user_ctx->row_mean_data[row_index].mean.temperature, row_index);
         }
+        if (user_ctx->row_valid_fields[row_index] & MEASUREMENT_LIGHT_VALID)
+        {
+            set_row_current_light_exposure(user_ctx->row_mean_data[row_index].mean.light_intensity, row_index);
+        }
+        if (user_ctx->row_valid_fields[row_index] & MEASUREMENT_SOIL_MOISTURE_VALID)
+        {
+            set_row_current_soil_moisture(user_ctx->row_mean_data[row_index].mean.soil_moisture, row_index);
+        }
+        // And the trend of the row values over the last cycles
+        if (row_window_get(row_index, &row_window))
+        {
+            set_row_window(&row_window, row_index);
+        }
+        set_row_registered(row_index);
+    }
+    // if a row at a point is not registered, reset its status
+    ROW_BITMAP_FOR_EACH(user_ctx->dropped_rows, row_index)
+    {
+        reset_row_status(row_index);
     }
 
     // Notify environment control fsm that new measurements were taken
@@ -254,28 +621,51 @@ static void send_data_to_cloud_run(void *o)
     // Message buffers
     message_measurement_data_t msg_measurement_data = {0};
     message_row_mean_data_t msg_row_mean_data = {0};
+    link_quality_data_t link_quality;
+    read_latency_data_t read_latency;
+    row_window_data_t row_window;
+    uint16_t row_index;
 
     k_sleep(K_MSEC(100));
     LOG_INF(" ------- SENDING TO CLOUD --------- ");
     // TODO: To be done with workqueues
     // Send all measurement data
-    for (int index = 0; index < BLE_MAX_CONNECTIONS; index++)
+    for (int index = 0; index < MEASUREMENT_DATA_SIZE; index++)
     {
-        if (user_ctx->measurements_data[index].ble_connection_handle != NULL)
+        if (is_measurement_data_valid(index))
         {
             create_measurements_data_tx_message(&user_ctx->measurements_data[index], &msg_measurement_data);
             store_measurement_message(&msg_measurement_data);
         }
     }
 
-    // Send row mean data
-    for (int index = 0; index < MAX_CONFIGURATION_ID; index++)
+    // Send row mean data of the registered rows
+    ROW_BITMAP_FOR_EACH(user_ctx->registered_rows, row_index)
+    {
+        // The creation of message is not needed in wifi. Keeping it as it is though to port the firmware faster
+        create_row_mean_data_tx_message(&user_ctx->row_mean_data[row_index], &msg_row_mean_data);
+        store_row_mean_data_message(&msg_row_mean_data);
+        // With the statistics of the row values since the previous upload
+        if (row_window_get(row_index, &row_window))
+        {
+            store_row_window_data(&row_window);
+        }
+    }
+
+    // Send the link quality of the sensor nodes (device info)
+    for (uint16_t index = 0; index < BLE_LINK_STATS_SIZE; index++)
+    {
+        if (ble_link_stats_get(index, &link_quality))
+        {
+            store_link_quality_data(&link_quality);
+        }
+    }
+    // And the read latency of every kind of read, to find the slow characteristics
+    for (uint8_t read_kind = 0; read_kind < READ_LATENCY_KIND_COUNT; read_kind++)
     {
-        if (user_ctx->row_mean_data[index].is_row_registered)
+        if (ble_link_stats_get_read_latency(read_kind, &read_latency))
         {
-            // The creation of message is not needed in wifi. Keeping it as it is though to port the firmware faster
-            create_row_mean_data_tx_message(&user_ctx->row_mean_data[index], &msg_row_mean_data);
-            store_row_mean_data_message(&msg_row_mean_data);
+            store_read_latency_data(&read_latency);
         }
     }
     
@@ -291,12 +681,19 @@ static void thread_sleep_run(void *o)
     bool is_anyone_connected = false;
     uint32_t events = 0;
     static bool no_devices_connected_reset_needed = false;
+    uint16_t row_index;
     // LOG_INF("---------------------------------------");
     // Measurements are taken with a specific period
     events = k_event_wait(&measurements_fsm_event, MEASUREMENTS_FSM_RUN_EVT, true, K_FOREVER);
 
     // After thread wakes up, check if at least one sensor node is connected. If not, go back to sleep state
+#ifdef MEASUREMENTS_NODE_REGISTRY_SLOTS
+    // Registered nodes are connected only during their time slice (or never, if
+    // they advertise their measurements), any registered node counts
+    is_anyone_connected = ble_node_registry_count() > 0 ? true : false;
+#else
     is_anyone_connected = k_sem_count_get(&at_least_one_active_connection_sem) > 0 ? true : false;
+#endif
 
     if (is_anyone_connected)
     {
@@ -309,9 +706,9 @@ static void thread_sleep_run(void *o)
         // check if data reset needed after everyone disconnecting: TODO: this is really bad, needs to be fixed in a proper way
         if(no_devices_connected_reset_needed)
         {
-            for(uint8_t index = 0; index < MAX_CONFIGURATION_ID; index++)
+            ROW_BITMAP_FOR_EACH(get_row_registered_bitmap(), row_index)
             {
-                reset_row_status(index);
+                reset_row_status(row_index);
             }
             k_event_post(&env_control_event, ENV_CONTROL_MEASUREMENTS_TAKEN_EVT);
         }
@@ -323,7 +720,7 @@ void measurements_fsm(void)
 {
     int32_t ret;
 
-    k_sem_init(&read_response_sem, 0, 1);
+    k_sem_init(&read_response_sem, 0, BLE_MAX_CONNECTIONS);
     k_sem_init(&at_least_one_active_connection_sem, 0, BLE_MAX_CONNECTIONS);
     k_event_init(&measurements_fsm_event);
 
@@ -334,10 +731,12 @@ void measurements_fsm(void)
     // Run the state machine
     while (1)
     {
+#ifndef MEASUREMENTS_NODE_REGISTRY_SLOTS
         // Wait for at least one connection to be active in order to start measurement fsm
         k_sem_take(&at_least_one_active_connection_sem, K_FOREVER);
         // give back the semaphore.
         k_sem_give(&at_least_one_active_connection_sem);
+#endif
         // State machine terminates if a non-zero value is returned
         ret = smf_run_state(SMF_CTX(&measurements_fsm_user_object));
         if (ret)
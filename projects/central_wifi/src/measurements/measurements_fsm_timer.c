@@ -1,6 +1,7 @@
 // --- includes ----------------------------------------------------------------
 #include "measurements_fsm_timer.h"
 #include "measurements_fsm.h"
+#include "common.h"
 #include <zephyr/kernel.h>
 
 // --- static variables definitions --------------------------------------------
@@ -21,5 +22,29 @@ void init_measurements_fsm_timer(void)
 
 void start_measurements_fsm_timer(void)
 {
-    k_timer_start(&measurements_fsm_timer, K_SECONDS(0), K_SECONDS(MEASUREMENT_PERIOD_IN_SEC));
+    // Run the fsm a bit after the start of every sampling epoch, when the nodes
+    // have sampled their sensors
+    k_timer_start(&measurements_fsm_timer, K_MSEC(SAMPLING_EPOCH_PERIOD_MS - get_sampling_epoch_time() + SAMPLING_EPOCH_READ_DELAY_MS),
+                  K_SECONDS(MEASUREMENT_PERIOD_IN_SEC));
+}
+
+/**
+ * @brief Get the current sampling epoch. Epochs are counted from boot, every
+ *        MEASUREMENT_PERIOD_IN_SEC
+ *
+ * @return uint16_t epoch (modulo MEASUREMENT_EPOCH_WRAP)
+ */
+uint16_t get_sampling_epoch(void)
+{
+    return (k_uptime_get() / SAMPLING_EPOCH_PERIOD_MS) % MEASUREMENT_EPOCH_WRAP;
+}
+
+/**
+ * @brief Get the time elapsed since the start of the current sampling epoch
+ *
+ * @return uint32_t time in ms
+ */
+uint32_t get_sampling_epoch_time(void)
+{
+    return k_uptime_get() % SAMPLING_EPOCH_PERIOD_MS;
 }
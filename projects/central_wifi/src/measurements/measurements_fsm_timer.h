@@ -8,9 +8,15 @@
 // TODO: Probably set it from html page
 #define MEASUREMENT_PERIOD_IN_SEC 15
 #define MEASUREMENTS_SEND_TO_CLOUD_PERIOD_IN_SEC 300 // 5 minutes period to send data to cloud
+// Sensor nodes sample at the start of every measurement period (sampling epoch),
+// the measurements are read this long after it
+#define SAMPLING_EPOCH_PERIOD_MS (MEASUREMENT_PERIOD_IN_SEC * 1000)
+#define SAMPLING_EPOCH_READ_DELAY_MS 2000
 
 // --- functions declarations --------------------------------------------------
 void init_measurements_fsm_timer(void);
 void start_measurements_fsm_timer(void);
+uint16_t get_sampling_epoch(void);
+uint32_t get_sampling_epoch_time(void);
 
 #endif /* MEASUREMENTS_FSM_TIMER */
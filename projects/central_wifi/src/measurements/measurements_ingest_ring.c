@@ -0,0 +1,119 @@
+/*
+ * Description:
+ *
+ * Source file of the ring that hands the measurements received by the bt
+ * callbacks over to the measurements thread. There is one producer (the bt rx
+ * thread, where the read, notify and scan callbacks run) and one consumer (the
+ * measurements thread), so the ring needs no lock: the producer only moves the
+ * head and the consumer only moves the tail
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "measurements_ingest_ring.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+// --- defines -----------------------------------------------------------------
+BUILD_ASSERT((MEASUREMENTS_INGEST_RING_SIZE & (MEASUREMENTS_INGEST_RING_SIZE - 1)) == 0,
+             "MEASUREMENTS_INGEST_RING_SIZE must be a power of two");
+#define MEASUREMENTS_INGEST_RING_MASK (MEASUREMENTS_INGEST_RING_SIZE - 1)
+
+// --- static variables definitions --------------------------------------------
+static measurement_sample_t ingest_ring[MEASUREMENTS_INGEST_RING_SIZE];
+// Free running counters, the ring index is the counter masked with the ring size.
+// The head is written only by the producer, the tail only by the consumer
+static atomic_t ingest_ring_head;
+static atomic_t ingest_ring_tail;
+// Samples that did not fit on the ring
+static atomic_t dropped_samples;
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Add a sample to the ring. Called only from the bt rx thread
+ *
+ * @param slot Index of the node on measurement_data
+ * @param field Field the value is stored on
+ * @param value Value as received from the sensor node
+ * @return true if the sample was added, false if the ring is full (the sample is dropped)
+ */
+bool measurements_ingest_ring_push(uint16_t slot, measurement_field_t field, int32_t value)
+{
+    uint32_t head = (uint32_t)atomic_get(&ingest_ring_head);
+    uint32_t tail = (uint32_t)atomic_get(&ingest_ring_tail);
+    measurement_sample_t *sample;
+
+    if (head - tail >= MEASUREMENTS_INGEST_RING_SIZE)
+    {
+        atomic_inc(&dropped_samples);
+        return false;
+    }
+
+    sample = &ingest_ring[head & MEASUREMENTS_INGEST_RING_MASK];
+    sample->slot = slot;
+    sample->field = field;
+    sample->value = value;
+    sample->timestamp = k_uptime_get_32();
+    // The sample is visible to the consumer only after the head moves
+    atomic_set(&ingest_ring_head, (atomic_val_t)(head + 1));
+
+    return true;
+}
+
+/**
+ * @brief Check that the ring has room for several samples that must be added together.
+ *        Called only from the bt rx thread, before the samples are pushed: the consumer
+ *        only frees entries, so the room is still there when they are pushed
+ *
+ * @param count Number of samples that will be pushed
+ * @return true if every sample fits, false if the ring is too full (the samples are
+ *         counted as dropped and must not be pushed)
+ */
+bool measurements_ingest_ring_reserve(uint16_t count)
+{
+    uint32_t head = (uint32_t)atomic_get(&ingest_ring_head);
+    uint32_t tail = (uint32_t)atomic_get(&ingest_ring_tail);
+
+    if (MEASUREMENTS_INGEST_RING_SIZE - (head - tail) < count)
+    {
+        atomic_add(&dropped_samples, count);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Take the oldest samples from the ring. Called only from the measurements thread
+ *
+ * @param samples Buffer for the samples
+ * @param max_count Size of the buffer
+ * @return number of samples taken, 0 if the ring is empty
+ */
+uint16_t measurements_ingest_ring_pop(measurement_sample_t *samples, uint16_t max_count)
+{
+    uint32_t tail = (uint32_t)atomic_get(&ingest_ring_tail);
+    uint32_t head = (uint32_t)atomic_get(&ingest_ring_head);
+    uint16_t count = (uint16_t)MIN(head - tail, max_count);
+
+    for (uint16_t index = 0; index < count; index++)
+    {
+        samples[index] = ingest_ring[(tail + index) & MEASUREMENTS_INGEST_RING_MASK];
+    }
+    // The entries are given back to the producer only after they were copied
+    atomic_set(&ingest_ring_tail, (atomic_val_t)(tail + count));
+
+    return count;
+}
+
+/**
+ * @brief Get how many samples were dropped since boot because the ring was full
+ *
+ * @return number of dropped samples
+ */
+uint32_t measurements_ingest_ring_get_dropped(void)
+{
+    return (uint32_t)atomic_get(&dropped_samples);
+}
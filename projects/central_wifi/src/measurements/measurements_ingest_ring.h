@@ -0,0 +1,51 @@
+#ifndef MEASUREMENTS_INGEST_RING_H
+#define MEASUREMENTS_INGEST_RING_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- defines -----------------------------------------------------------------
+// Samples the ring can hold (power of two). The ring is drained on every measurements
+// cycle, so it holds every field of every node that is read (or pushes, or advertises)
+// during a measurement period
+#if defined(BLE_ROTATION_MODE) || defined(BLE_ADV_TELEMETRY_MODE)
+#define MEASUREMENTS_INGEST_RING_SIZE 2048
+#else
+#define MEASUREMENTS_INGEST_RING_SIZE 256
+#endif
+// Samples taken from the ring at once by the measurements thread
+#define MEASUREMENTS_INGEST_BATCH_SIZE 32
+
+// --- enums -------------------------------------------------------------------
+// Field of measurements_data_t a sample is stored on
+typedef enum measurement_field_e
+{
+    MEASUREMENT_FIELD_TEMPERATURE = 0,
+    MEASUREMENT_FIELD_HUMIDITY,
+    MEASUREMENT_FIELD_SOIL_MOISTURE,
+    MEASUREMENT_FIELD_LIGHT_INTENSITY,
+    MEASUREMENT_FIELD_ROW_ID,
+    MEASUREMENT_FIELD_BATTERY_LEVEL,
+    MEASUREMENT_FIELD_SAMPLING_EPOCH,
+} measurement_field_t;
+
+// --- structs -----------------------------------------------------------------
+typedef struct measurement_sample_s
+{
+    // Index of the node on measurement_data
+    uint16_t slot;
+    // Takes values like: MEASUREMENT_FIELD_TEMPERATURE
+    uint8_t field;
+    int32_t value;
+    // Uptime (ms) the sample was received
+    uint32_t timestamp;
+} measurement_sample_t;
+
+// --- function declarations ---------------------------------------------------
+bool measurements_ingest_ring_push(uint16_t slot, measurement_field_t field, int32_t value);
+bool measurements_ingest_ring_reserve(uint16_t count);
+uint16_t measurements_ingest_ring_pop(measurement_sample_t *samples, uint16_t max_count);
+uint32_t measurements_ingest_ring_get_dropped(void);
+
+#endif // MEASUREMENTS_INGEST_RING_H
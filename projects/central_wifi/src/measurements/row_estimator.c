@@ -0,0 +1,157 @@
+/*
+ * Description:
+ *
+ * Source file that estimates the row value of a measurement field from the
+ * measurements of the nodes of the row. Robust estimators keep a single node
+ * with a faulty sensor (e.g. a shorted soil probe) from moving the row value,
+ * which drives the environment control of the row. Measurements are fixed
+ * point integers (e.g. 0.01 C), so is every estimator
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "row_estimator.h"
+#include "ble_client/ble_connection_data.h"
+#include "measurements_data_storage.h"
+
+#include <stdlib.h>
+#include <zephyr/sys/util.h>
+
+// --- static function declarations --------------------------------------------
+static int compare_values(const void *a, const void *b);
+static int32_t get_mean(const int32_t *values, uint16_t count);
+static int32_t get_sorted_median(const int32_t *values, uint16_t count);
+static int32_t get_mad_mean(int32_t *values, uint16_t count, uint16_t *rejected_count);
+
+// --- static variables definitions --------------------------------------------
+// Absolute deviations from the median, for the MAD estimator
+static int32_t deviations[MEASUREMENT_DATA_SIZE];
+
+// --- static function definitions ---------------------------------------------
+static int compare_values(const void *a, const void *b)
+{
+    int32_t value_a = *(const int32_t *)a;
+    int32_t value_b = *(const int32_t *)b;
+
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * @brief Get the mean of measurements (truncated, like every estimator)
+ *
+ * @param values Measurements
+ * @param count Number of measurements, at least 1
+ * @return mean value
+ */
+static int32_t get_mean(const int32_t *values, uint16_t count)
+{
+    int64_t sum = 0;
+
+    for (uint16_t index = 0; index < count; index++)
+    {
+        sum += values[index];
+    }
+
+    return (int32_t)(sum / count);
+}
+
+/**
+ * @brief Get the median of sorted measurements. With an even number of measurements
+ *        it is the mean of the two middle ones
+ *
+ * @param values Sorted measurements
+ * @param count Number of measurements, at least 1
+ * @return median value
+ */
+static int32_t get_sorted_median(const int32_t *values, uint16_t count)
+{
+    if (count % 2)
+    {
+        return values[count / 2];
+    }
+
+    return (int32_t)(((int64_t)values[count / 2 - 1] + values[count / 2]) / 2);
+}
+
+/**
+ * @brief Get the mean of the measurements that are close to their median. The
+ *        spread of the measurements is their median absolute deviation (MAD),
+ *        at least 1 so that equal measurements do not reject every other one
+ *
+ * @param values Sorted measurements
+ * @param count Number of measurements, at least ROW_ESTIMATOR_MAD_MIN_COUNT
+ * @param rejected_count Incremented by the number of rejected measurements
+ * @return mean of the measurements that were not rejected
+ */
+static int32_t get_mad_mean(int32_t *values, uint16_t count, uint16_t *rejected_count)
+{
+    int32_t median = get_sorted_median(values, count);
+    int64_t mad;
+    int64_t sum = 0;
+    uint16_t accepted_count = 0;
+
+    for (uint16_t index = 0; index < count; index++)
+    {
+        deviations[index] = abs(values[index] - median);
+    }
+    qsort(deviations, count, sizeof(int32_t), compare_values);
+    mad = MAX(get_sorted_median(deviations, count), 1);
+
+    for (uint16_t index = 0; index < count; index++)
+    {
+        // |value - median| > threshold * MAD, in Q8
+        if ((int64_t)abs(values[index] - median) * 256 > ROW_ESTIMATOR_MAD_THRESHOLD_Q8 * mad)
+        {
+            (*rejected_count)++;
+            continue;
+        }
+        sum += values[index];
+        accepted_count++;
+    }
+
+    // At least half of the deviations are not above the MAD, so at least half of the values are kept
+    return (int32_t)(sum / accepted_count);
+}
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Estimate the row value of a field with the ROW_ESTIMATOR estimator
+ *
+ * @param values Measurements of the field by the nodes of the row. Sorted by the
+ *        robust estimators
+ * @param count Number of measurements
+ * @param rejected_count Incremented by the number of measurements that the estimator
+ *        did not use (trimmed or rejected as outliers)
+ * @return row value, 0 if there are no measurements
+ */
+int32_t estimate_row_value(int32_t *values, uint16_t count, uint16_t *rejected_count)
+{
+    uint16_t trimmed_count;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if (ROW_ESTIMATOR == ROW_ESTIMATOR_MEAN)
+    {
+        return get_mean(values, count);
+    }
+
+    qsort(values, count, sizeof(int32_t), compare_values);
+    switch (ROW_ESTIMATOR)
+    {
+    case ROW_ESTIMATOR_MEDIAN:
+        return get_sorted_median(values, count);
+    case ROW_ESTIMATOR_TRIMMED_MEAN:
+        trimmed_count = (count * ROW_ESTIMATOR_TRIM_PERCENT) / 100;
+        *rejected_count += 2 * trimmed_count;
+        return get_mean(&values[trimmed_count], count - 2 * trimmed_count);
+    default:
+        if (count < ROW_ESTIMATOR_MAD_MIN_COUNT)
+        {
+            return get_mean(values, count);
+        }
+        return get_mad_mean(values, count, rejected_count);
+    }
+}
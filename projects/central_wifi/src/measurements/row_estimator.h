@@ -0,0 +1,29 @@
+#ifndef ROW_ESTIMATOR_H
+#define ROW_ESTIMATOR_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdint.h>
+
+// --- defines -----------------------------------------------------------------
+// Estimators of the row value of a field, over the measurements of the nodes of the row
+#define ROW_ESTIMATOR_MEAN 0
+#define ROW_ESTIMATOR_MEDIAN 1
+#define ROW_ESTIMATOR_TRIMMED_MEAN 2
+// Mean of the measurements that are close to the median (Median Absolute Deviation)
+#define ROW_ESTIMATOR_MAD 3
+// Estimator used for every row and field (can be selected from CMakeLists.txt)
+#ifndef ROW_ESTIMATOR
+#define ROW_ESTIMATOR ROW_ESTIMATOR_MAD
+#endif
+// Trimmed mean: measurements dropped from each end of the sorted measurements (%)
+#define ROW_ESTIMATOR_TRIM_PERCENT 20
+// MAD rejection: a measurement is rejected when it is further from the median than
+// 3 standard deviations, estimated as 1.4826 MAD. Q8 fixed point: 3 * 1.4826 * 256
+#define ROW_ESTIMATOR_MAD_THRESHOLD_Q8 1139
+// MAD rejection needs at least this many measurements, fewer are just averaged
+#define ROW_ESTIMATOR_MAD_MIN_COUNT 3
+
+// --- function declarations ---------------------------------------------------
+int32_t estimate_row_value(int32_t *values, uint16_t count, uint16_t *rejected_count);
+
+#endif // ROW_ESTIMATOR_H
@@ -0,0 +1,204 @@
+/*
+ * Description:
+ *
+ * Source file that keeps a rolling window of the recent row values of every
+ * row and field. The row values of a cycle are overwritten on the next one,
+ * so the window is what gives the environment control and the cloud the
+ * trend of a row: the moving average, min, max and slope of the last
+ * ROW_WINDOW_SIZE row values. Every statistic is updated incrementally when a
+ * row value is added
+ *
+ */
+
+// --- includes ----------------------------------------------------------------
+#include "row_window.h"
+#include "measurements_fsm_timer.h"
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+// --- defines -----------------------------------------------------------------
+#define SECONDS_PER_HOUR 3600
+
+// --- structs -----------------------------------------------------------------
+// Window of a field of a row
+typedef struct field_window_s
+{
+    // Ring of the row values, values[head] is the oldest one when the ring is full
+    int32_t values[ROW_WINDOW_SIZE];
+    uint8_t head;
+    uint8_t count;
+    // Moving average, Q8
+    int64_t ewma_q8;
+    int32_t min;
+    int32_t max;
+    // Sums for the least squares slope, with the oldest row value at position 0:
+    // sum of the values, and sum of the values weighted by their position
+    int64_t sum;
+    int64_t weighted_sum;
+} field_window_t;
+
+// --- static function declarations --------------------------------------------
+static void update_field_window_limits(field_window_t *window);
+static int32_t get_field_window_slope(const field_window_t *window);
+
+// --- static variables definitions --------------------------------------------
+// The indexing is: row id = 1 -> row_windows[0], and the fields are in the order of
+// the MEASUREMENT_*_VALID flags
+static field_window_t row_windows[MAX_CONFIGURATION_ID][ROW_WINDOW_FIELD_COUNT];
+
+// --- static function definitions ---------------------------------------------
+/**
+ * @brief Find the min and max of the row values of a window again. Needed only
+ *        when the row value that left the window was the min or the max
+ *
+ * @param window Window of a field of a row
+ */
+static void update_field_window_limits(field_window_t *window)
+{
+    window->min = INT32_MAX;
+    window->max = INT32_MIN;
+    for (uint8_t index = 0; index < window->count; index++)
+    {
+        window->min = MIN(window->min, window->values[index]);
+        window->max = MAX(window->max, window->values[index]);
+    }
+}
+
+/**
+ * @brief Get the least squares slope of the row values of a window. The row values
+ *        are one measurement period apart
+ *
+ * @param window Window of a field of a row
+ * @return change per hour, 0 if there are less than 2 row values
+ */
+static int32_t get_field_window_slope(const field_window_t *window)
+{
+    int64_t count = window->count;
+    // Sum of the positions (0 to count - 1) and count * sum of their squares - (sum of the positions)^2
+    int64_t position_sum = count * (count - 1) / 2;
+    int64_t denominator = count * count * (count * count - 1) / 12;
+    int64_t slope;
+
+    if (count < 2)
+    {
+        return 0;
+    }
+
+    slope = ((count * window->weighted_sum - position_sum * window->sum) * SECONDS_PER_HOUR) /
+            (denominator * MEASUREMENT_PERIOD_IN_SEC);
+
+    return (int32_t)CLAMP(slope, INT32_MIN, INT32_MAX);
+}
+
+// --- functions definitions ---------------------------------------------------
+/**
+ * @brief Add the row value of a field to the window of the row. The oldest row value
+ *        leaves the window when it is full
+ *
+ * @param row_index Row id - 1
+ * @param row_field Field, in the order of the MEASUREMENT_*_VALID flags
+ * @param value Row value of this cycle
+ */
+void row_window_add(uint8_t row_index, uint8_t row_field, int32_t value)
+{
+    field_window_t *window;
+    int32_t oldest_value;
+    bool is_limit_removed = false;
+
+    if (row_index >= MAX_CONFIGURATION_ID || row_field >= ROW_WINDOW_FIELD_COUNT)
+    {
+        return;
+    }
+    window = &row_windows[row_index][row_field];
+
+    if (window->count == 0)
+    {
+        window->ewma_q8 = (int64_t)value * 256;
+        window->min = value;
+        window->max = value;
+    }
+    else
+    {
+        window->ewma_q8 += (((int64_t)value * 256 - window->ewma_q8) * ROW_WINDOW_EWMA_ALPHA_Q8) / 256;
+    }
+
+    if (window->count == ROW_WINDOW_SIZE)
+    {
+        // Every remaining row value moves one position back
+        oldest_value = window->values[window->head];
+        window->sum -= oldest_value;
+        window->weighted_sum -= window->sum;
+        is_limit_removed = (oldest_value == window->min) || (oldest_value == window->max);
+    }
+    else
+    {
+        window->count++;
+    }
+
+    window->values[window->head] = value;
+    window->head = (window->head + 1) % ROW_WINDOW_SIZE;
+    window->sum += value;
+    window->weighted_sum += (int64_t)(window->count - 1) * value;
+
+    if (is_limit_removed)
+    {
+        update_field_window_limits(window);
+    }
+    else
+    {
+        window->min = MIN(window->min, value);
+        window->max = MAX(window->max, value);
+    }
+}
+
+/**
+ * @brief Forget every row value of a row, when the row is no longer registered
+ *
+ * @param row_index Row id - 1
+ */
+void row_window_reset(uint8_t row_index)
+{
+    if (row_index < MAX_CONFIGURATION_ID)
+    {
+        memset(row_windows[row_index], 0, sizeof(row_windows[row_index]));
+    }
+}
+
+/**
+ * @brief Get the rolling window statistics of a row
+ *
+ * @param row_index Row id - 1
+ * @param row_window_data Statistics of every field, sample_count is 0 for a field
+ *        without row values
+ * @return true if at least one field of the row has row values
+ */
+bool row_window_get(uint8_t row_index, row_window_data_t *row_window_data)
+{
+    const field_window_t *window;
+    bool has_values = false;
+
+    if (row_index >= MAX_CONFIGURATION_ID)
+    {
+        return false;
+    }
+
+    memset(row_window_data, 0, sizeof(row_window_data_t));
+    row_window_data->row_id = row_index + 1;
+    for (uint8_t row_field = 0; row_field < ROW_WINDOW_FIELD_COUNT; row_field++)
+    {
+        window = &row_windows[row_index][row_field];
+        if (window->count == 0)
+        {
+            continue;
+        }
+        row_window_data->fields[row_field].sample_count = window->count;
+        row_window_data->fields[row_field].ewma = (int32_t)(window->ewma_q8 / 256);
+        row_window_data->fields[row_field].min = window->min;
+        row_window_data->fields[row_field].max = window->max;
+        row_window_data->fields[row_field].slope = get_field_window_slope(window);
+        has_values = true;
+    }
+
+    return has_values;
+}
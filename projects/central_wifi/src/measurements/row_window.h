@@ -0,0 +1,14 @@
+#ifndef ROW_WINDOW_H
+#define ROW_WINDOW_H
+
+// --- includes ----------------------------------------------------------------
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+
+// --- function declarations ---------------------------------------------------
+void row_window_add(uint8_t row_index, uint8_t row_field, int32_t value);
+void row_window_reset(uint8_t row_index);
+bool row_window_get(uint8_t row_index, row_window_data_t *row_window_data);
+
+#endif // ROW_WINDOW_H
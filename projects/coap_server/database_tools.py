@@ -1,4 +1,5 @@
 import os
+import struct
 from datetime import *
 import mysql.connector as database
 import time
@@ -13,6 +14,68 @@ connection = database.connect(
 
 cursor = connection.cursor()
 
+# Tables and columns added after row_mean_values and user_thresholds_request were created,
+# they are created on existing databases when the server starts
+SCHEMA_UPDATES = [
+    "ALTER TABLE row_mean_values ADD COLUMN rejected_readings TINYINT UNSIGNED NOT NULL DEFAULT 0",
+    "CREATE TABLE IF NOT EXISTS node_link_quality (id INT AUTO_INCREMENT PRIMARY KEY, mac_address VARCHAR(32) NOT NULL, timestamp DATETIME NOT NULL, mean_rssi FLOAT NULL, min_rssi SMALLINT NULL, mean_read_latency FLOAT NULL, max_read_latency INT NULL, read_timeouts INT NOT NULL, read_failures INT NOT NULL, reconnects INT NOT NULL, disconnects INT NOT NULL, disconnect_reasons VARCHAR(64) NOT NULL, read_latency_histogram VARCHAR(255) NOT NULL, sampling_period_ms INT NULL)",
+    "ALTER TABLE node_link_quality ADD COLUMN sampling_period_ms INT NULL",
+    "CREATE TABLE IF NOT EXISTS read_latency (id INT AUTO_INCREMENT PRIMARY KEY, read_kind VARCHAR(32) NOT NULL, timestamp DATETIME NOT NULL, histogram VARCHAR(255) NOT NULL)",
+    "CREATE TABLE IF NOT EXISTS row_window (id INT AUTO_INCREMENT PRIMARY KEY, row_id TINYINT UNSIGNED NOT NULL, timestamp DATETIME NOT NULL, field VARCHAR(32) NOT NULL, sample_count TINYINT UNSIGNED NOT NULL, ewma FLOAT NOT NULL, min FLOAT NOT NULL, max FLOAT NOT NULL, slope_per_hour FLOAT NOT NULL)",
+]
+# Error of an ALTER TABLE whose column already exists (ER_DUP_FIELDNAME)
+DUPLICATE_COLUMN_ERROR = 1060
+
+'''
+Function to bring an existing database up to the tables used by the parsers
+'''
+def update_database_schema():
+    for statement in SCHEMA_UPDATES:
+        try:
+            cursor.execute(statement)
+        except database.Error as e:
+            if e.errno != DUPLICATE_COLUMN_ERROR:
+                print(f"Error updating database schema: {e}")
+    connection.commit()
+
+update_database_schema()
+
+# Fixed point measurement values (measurement_values_t of common.h), the same format on every
+# hop: temperature (signed), humidity and soil moisture scaled by MEASUREMENT_VALUE_SCALE,
+# light intensity in lux
+MEASUREMENT_VALUE_SCALE = 100
+MEASUREMENT_VALUES_FORMAT = "<hHHH"
+
+'''
+Function to parse the measurement values at an offset of a message
+returns temperature (C), humidity (%), soil moisture (%) and light intensity (lux)
+'''
+def parse_measurement_values(payload: bytes, offset) -> tuple:
+    temperature, humidity, soilmoisture, lightintensity = struct.unpack_from(MEASUREMENT_VALUES_FORMAT, payload, offset)
+    return temperature / MEASUREMENT_VALUE_SCALE, humidity / MEASUREMENT_VALUE_SCALE, soilmoisture / MEASUREMENT_VALUE_SCALE, lightintensity
+
+'''
+Function to insert entries in the database with one statement, every entry is the key
+(row id, mac address, ...), the timestamp (unix time in ms of the central) and the values of a row
+'''
+def insert_into_database(statement, key, timestamp, rows):
+    try:
+        connection.reconnect(attempts=2, delay=1)
+    except database.Error as e:
+        print(f"Can't reconnect to database: {e}")
+    ts = int(timestamp/1000)
+    # Adjust summer time - This could be done through firmware.
+    ts += 3600 # summer time with +1 hour
+    date = datetime.utcfromtimestamp(ts).strftime('%Y-%m-%d %H:%M:%S')
+    try:
+        for values in rows:
+            cursor.execute(statement, (key, date) + tuple(values))
+        connection.commit()
+        connection.close()
+    except database.Error as e:
+        print(f"Error adding entry to database: {e}")
+        connection.close()
+
 '''
 Class to parse row mean data message sent from 9160 and store it in the database
 inside the table row_mean_values
@@ -30,41 +93,169 @@ class MessageParsing:
         self.lightswitch = False
         self.waterswitch = False
         self.fanswitch = False
+        self.rejectedreadings = 0
 
     @staticmethod
-    def insert_into_database(self, id, timestamp, temp, hum, soil, light, lswitch, wswitch, fswitch):
-        try:
-            connection.reconnect(attempts=2, delay=1)
-        except database.Error as e:
-            print(f"Can't reconnect to database: {e}")
-        ts = int(str(int(timestamp/1000)))
-        # Adjust summer time - This could be done through firmware.
-        ts += 3600 # summer time with +1 hour
-        statement = "INSERT INTO row_mean_values (row_id, timestamp, temperature, humidity, soil_moisture, light_exposure, light_switch, water_switch, fan_switch) VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s)"
-        data = (id, datetime.utcfromtimestamp(ts).strftime('%Y-%m-%d %H:%M:%S'), temp, hum, soil, light, lswitch, wswitch, fswitch)
-        try:
-            cursor.execute(statement, data)
-            connection.commit()
-            connection.close()
-        except database.Error as e:
-            print(f"Error adding entry to database: {e}")
-            connection.close()
+    def insert_into_database(self, id, timestamp, temp, hum, soil, light, lswitch, wswitch, fswitch, rejected):
+        statement = "INSERT INTO row_mean_values (row_id, timestamp, temperature, humidity, soil_moisture, light_exposure, light_switch, water_switch, fan_switch, rejected_readings) VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s)"
+        insert_into_database(statement, id, timestamp, [(temp, hum, soil, light, lswitch, wswitch, fswitch, rejected)])
 
     def row_mean_data_parsing(self, payload: bytes):
         # Save values on variables after parsing the message
         self.msgtype = payload[0:1]
         self.msglen  = int.from_bytes(payload[1:2], "little")
-        self.temperature = int.from_bytes((payload[2:4]), "little") / 100
-        self.humidity = int.from_bytes((payload[4:6]), "little") / 100
-        self.soilmoisture = int.from_bytes((payload[6:8]), "little") / 100
-        self.lightintensity = int.from_bytes((payload[8:10]), "little")
+        self.temperature, self.humidity, self.soilmoisture, self.lightintensity = parse_measurement_values(payload, 2)
         self.rowid = int.from_bytes((payload[10:11]), "little")
         self.timestamp = int.from_bytes((payload[11:19]), "little")
         self.lightswitch = bool.from_bytes((payload[19:20]), "little")
         self.waterswitch = bool.from_bytes((payload[20:21]), "little")
         self.fanswitch   = bool.from_bytes((payload[21:22]), "little")
+        self.rejectedreadings = int.from_bytes((payload[22:23]), "little")
         # Write row mean data to database
-        self.insert_into_database(self, self.rowid, self.timestamp, self.temperature, self.humidity, self.soilmoisture, self.lightintensity, self.lightswitch, self.waterswitch, self.fanswitch)
+        self.insert_into_database(self, self.rowid, self.timestamp, self.temperature, self.humidity, self.soilmoisture, self.lightintensity, self.lightswitch, self.waterswitch, self.fanswitch, self.rejectedreadings)
+
+'''
+Class to parse the device info message (link quality of a sensor node) sent from
+the central and store it in the database inside the table node_link_quality
+'''
+class DeviceInfoParsing:
+    # Ring sizes of link_quality_data_t (LINK_QUALITY_RING_SIZE, LINK_QUALITY_REASON_RING_SIZE)
+    RING_SIZE = 8
+    REASON_RING_SIZE = 4
+    # RSSI of a sample that could not be read, latency of a timed out read
+    RSSI_UNKNOWN = 127
+    LATENCY_TIMEOUT = 0xFFFF
+    # Buckets of a read latency histogram (READ_LATENCY_BUCKET_COUNT)
+    BUCKET_COUNT = 12
+
+    def __init__(self):
+        self.mac = ''
+        self.rssi = []
+        self.readlatency = []
+        self.readtimeouts = 0
+        self.readfailures = 0
+        self.reconnects = 0
+        self.disconnects = 0
+        self.disconnectreasons = []
+        self.readlatencyhistogram = []
+        self.samplingperiod = 0
+        self.timestamp = 0
+
+    @staticmethod
+    def address_to_str(address: bytes):
+        # bt_addr_le_t: address type, then the address bytes little endian
+        addresstype = "public" if address[0] == 0 else "random"
+        return ':'.join(f"{byte:02X}" for byte in reversed(address[1:7])) + f" ({addresstype})"
+
+    @staticmethod
+    def unroll_ring(ring, head, count):
+        # Oldest entry first
+        return [ring[(head - count + index) % len(ring)] for index in range(count)]
+
+    @staticmethod
+    def insert_into_database(self):
+        rssi = [value for value in self.rssi if value != self.RSSI_UNKNOWN]
+        latency = [value for value in self.readlatency if value != self.LATENCY_TIMEOUT]
+        statement = "INSERT INTO node_link_quality (mac_address, timestamp, mean_rssi, min_rssi, mean_read_latency, max_read_latency, read_timeouts, read_failures, reconnects, disconnects, disconnect_reasons, read_latency_histogram, sampling_period_ms) VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s)"
+        data = (sum(rssi) / len(rssi) if rssi else None, min(rssi) if rssi else None,
+                sum(latency) / len(latency) if latency else None, max(latency) if latency else None,
+                self.readtimeouts, self.readfailures, self.reconnects, self.disconnects,
+                ','.join(str(reason) for reason in self.disconnectreasons),
+                ','.join(str(count) for count in self.readlatencyhistogram),
+                self.samplingperiod if self.samplingperiod else None)
+        insert_into_database(statement, self.mac, self.timestamp, [data])
+
+    def device_info_parsing(self, payload: bytes):
+        # Save values on variables after parsing the message (see message_coap_device_info_t)
+        self.mac = self.address_to_str(payload[2:9])
+        samplecount = payload[9]
+        samplehead = payload[10]
+        rssiring = [int.from_bytes(payload[11 + index:12 + index], "little", signed=True) for index in range(self.RING_SIZE)]
+        latencyring = [int.from_bytes(payload[19 + 2 * index:21 + 2 * index], "little") for index in range(self.RING_SIZE)]
+        self.rssi = self.unroll_ring(rssiring, samplehead, samplecount)
+        self.readlatency = self.unroll_ring(latencyring, samplehead, samplecount)
+        self.readtimeouts = int.from_bytes(payload[35:37], "little")
+        self.readfailures = int.from_bytes(payload[37:39], "little")
+        self.reconnects = int.from_bytes(payload[39:41], "little")
+        self.disconnects = int.from_bytes(payload[41:43], "little")
+        reasoncount = payload[43]
+        reasonhead = payload[44]
+        self.disconnectreasons = self.unroll_ring(list(payload[45:49]), reasonhead, reasoncount)
+        self.readlatencyhistogram = [int.from_bytes(payload[49 + 4 * index:53 + 4 * index], "little") for index in range(self.BUCKET_COUNT)]
+        # Achieved sampling period (ms) of the node, 0 if not known (connected nodes)
+        self.samplingperiod = int.from_bytes(payload[97:101], "little")
+        self.timestamp = int.from_bytes(payload[101:109], "little")
+        # Write link quality to database
+        self.insert_into_database(self)
+
+'''
+Class to parse the read latency message (latency histogram of a kind of GATT read,
+over every sensor node) sent from the central and store it in the database inside
+the table read_latency
+'''
+class ReadLatencyParsing:
+    # Buckets of a read latency histogram (READ_LATENCY_BUCKET_COUNT)
+    BUCKET_COUNT = 12
+    # Kinds of read: characteristic indexes, then READ_LATENCY_KIND_RECORD and READ_LATENCY_KIND_MULTIPLE
+    READ_KINDS = ["temperature", "humidity", "soil_moisture", "light_intensity", "configuration", "battery",
+                  "measurement_record", "read_multiple"]
+
+    def __init__(self):
+        self.readkind = ''
+        self.histogram = []
+        self.timestamp = 0
+
+    @staticmethod
+    def insert_into_database(self):
+        statement = "INSERT INTO read_latency (read_kind, timestamp, histogram) VALUES (%s, %s, %s)"
+        insert_into_database(statement, self.readkind, self.timestamp, [(','.join(str(count) for count in self.histogram),)])
+
+    def read_latency_parsing(self, payload: bytes):
+        # Save values on variables after parsing the message (see message_coap_read_latency_t)
+        readkind = payload[2]
+        self.readkind = self.READ_KINDS[readkind] if readkind < len(self.READ_KINDS) else str(readkind)
+        # Bucket 0 counts the reads under 1024 us, every next bucket doubles the range
+        self.histogram = [int.from_bytes(payload[3 + 4 * index:7 + 4 * index], "little") for index in range(self.BUCKET_COUNT)]
+        self.timestamp = int.from_bytes(payload[51:59], "little")
+        # Write read latency to database
+        self.insert_into_database(self)
+
+'''
+Class to parse the row window message (statistics of the recent row values of a row)
+sent from the central and store it in the database inside the table row_window,
+one entry per field
+'''
+class RowWindowParsing:
+    # Fields of the window (ROW_WINDOW_FIELD_COUNT), with the scale of their row values
+    FIELDS = [("temperature", 100), ("humidity", 100), ("soil_moisture", 100), ("light_exposure", 1)]
+    # Size of row_window_field_t: the sample count, then ewma, min, max and slope (int32)
+    FIELD_SIZE = 17
+
+    def __init__(self):
+        self.rowid = 0
+        self.fields = []
+        self.timestamp = 0
+
+    @staticmethod
+    def insert_into_database(self):
+        statement = "INSERT INTO row_window (row_id, timestamp, field, sample_count, ewma, min, max, slope_per_hour) VALUES (%s, %s, %s, %s, %s, %s, %s, %s)"
+        insert_into_database(statement, self.rowid, self.timestamp, self.fields)
+
+    def row_window_parsing(self, payload: bytes):
+        # Save values on variables after parsing the message (see message_coap_row_window_t)
+        self.rowid = payload[2]
+        self.fields = []
+        for index, (name, scale) in enumerate(self.FIELDS):
+            offset = 3 + index * self.FIELD_SIZE
+            samplecount = payload[offset]
+            # A field without row values on the window is not stored
+            if samplecount == 0:
+                continue
+            ewma, minimum, maximum, slope = [value / scale for value in struct.unpack_from("<iiii", payload, offset + 1)]
+            self.fields.append((name, samplecount, ewma, minimum, maximum, slope))
+        self.timestamp = int.from_bytes(payload[71:79], "little")
+        # Write row window to database
+        self.insert_into_database(self)
 
 class GetDatabaseEntries:
     def __init__(self) -> None:
@@ -126,6 +317,26 @@ class GetDatabaseEntries:
             connection.close()
         return data_list
 
+    # Function to fetch the ids of the rows that have measurements, so that rows that were never
+    # registered on the central are not queried
+    def get_row_ids(self) -> list:
+        fetch_row_ids_query = "SELECT DISTINCT row_id FROM row_mean_values ORDER BY row_id ASC"
+        data_list = []
+        try:
+            connection.reconnect(attempts=2, delay=1)
+        except database.Error as e:
+            print(f"Can't reconnect to database: {e}")
+        try:
+            cursor.execute(fetch_row_ids_query)
+            # keep only the first element from the tuples
+            data_list = [i[0] for i in cursor.fetchall()]
+            connection.commit()
+            connection.close()
+        except database.Error as e:
+            print(f"Error getting row ids from database: {e}")
+            connection.close()
+        return data_list
+
     '''
     Function to create a list of data based on existance or not of entries for each timestamp in the list
 
@@ -20,6 +20,30 @@ class RowMeanData(resource.Resource):
             file.write(remote_endpoint)
         return aiocoap.Message(code=aiocoap.CHANGED, payload=request.payload)
 
+class DeviceInfo(resource.Resource):
+    def __init__(self):
+        super().__init__()
+
+    async def render_put(self, request):
+        DeviceInfoParsing().device_info_parsing(request.payload)
+        return aiocoap.Message(code=aiocoap.CHANGED, payload=request.payload)
+
+class ReadLatency(resource.Resource):
+    def __init__(self):
+        super().__init__()
+
+    async def render_put(self, request):
+        ReadLatencyParsing().read_latency_parsing(request.payload)
+        return aiocoap.Message(code=aiocoap.CHANGED, payload=request.payload)
+
+class RowWindow(resource.Resource):
+    def __init__(self):
+        super().__init__()
+
+    async def render_put(self, request):
+        RowWindowParsing().row_window_parsing(request.payload)
+        return aiocoap.Message(code=aiocoap.CHANGED, payload=request.payload)
+
 class UserPayload(resource.ObservableResource):
     # Initialize the last timestamp threshold
     last_timestamp_threshold = UserRequestsDBTools().get_latest_timestamp_threshold_request()
@@ -77,6 +101,9 @@ async def main():
     root.add_resource(['.well-known', 'core'],
             resource.WKCResource(root.get_resources_as_linkheader))
     root.add_resource(['rowmeandata'], RowMeanData())
+    root.add_resource(['deviceinfo'], DeviceInfo())
+    root.add_resource(['readlatency'], ReadLatency())
+    root.add_resource(['rowwindow'], RowWindow())
     root.add_resource(['userpayload'], UserPayload())
     await aiocoap.Context.create_server_context(root)
 
@@ -1,6 +1,7 @@
 import os
+import re
 from os.path import exists
-from flask import Flask, render_template, request, send_file
+from flask import Flask, render_template, request, send_file, abort
 from database_tools import *
 from datetime import *
 #app = Flask(__name__, template_folder='/home/pi/Desktop/coap/COAP_SERVER/templates')
@@ -91,463 +92,83 @@ def submit_control_configuration(id):
 def clear_measurement_diagrams():
     UserRequestsDBTools().clear_measurements_diagrams()
 
+# Rows that can be configured, must match MAX_CONFIGURATION_ID of the central
+ROW_COUNT = 5
+# Measurements that can be downloaded: route name -> (column of row_mean_values, file name)
+MEASUREMENT_FILES = {
+    'temps': ('temperature', 'temperatures'),
+    'hum': ('humidity', 'humidity'),
+    'light': ('light_exposure', 'light_exposure'),
+    'soil': ('soil_moisture', 'soil_moisture'),
+}
+
 timestamps=[]
-temperatures_row_1=[]
-temperatures_row_2=[]
-temperatures_row_3=[]
-temperatures_row_4=[]
-temperatures_row_5=[]
-humidity_row_1=[]
-humidity_row_2=[]
-humidity_row_3=[]
-humidity_row_4=[]
-humidity_row_5=[]
-soil_moisture_row_1=[]
-soil_moisture_row_2=[]
-soil_moisture_row_3=[]
-soil_moisture_row_4=[]
-soil_moisture_row_5=[]
-light_exposure_row_1=[]
-light_exposure_row_2=[]
-light_exposure_row_3=[]
-light_exposure_row_4=[]
-light_exposure_row_5=[]
+# Row ids that have measurements
+row_ids=[]
+# Measurements of every row by column, e.g. row_values['temperature'][row_id]
+row_values={}
 
 def create_data(len):
     global timestamps
-    global temperatures_row_1
-    global temperatures_row_2
-    global temperatures_row_3
-    global temperatures_row_4
-    global temperatures_row_5
-    global humidity_row_1
-    global humidity_row_2
-    global humidity_row_3
-    global humidity_row_4
-    global humidity_row_5
-    global soil_moisture_row_1
-    global soil_moisture_row_2
-    global soil_moisture_row_3
-    global soil_moisture_row_4
-    global soil_moisture_row_5
-    global light_exposure_row_1
-    global light_exposure_row_2
-    global light_exposure_row_3
-    global light_exposure_row_4
-    global light_exposure_row_5
-
-    timestamps   = GetDatabaseEntries().get_most_recent_timestamps(len)
-    # Then get the values
-    temperatures_row_1 = GetDatabaseEntries().create_list_of_data(1, 'temperature', timestamps)
-    temperatures_row_2 = GetDatabaseEntries().create_list_of_data(2, 'temperature', timestamps)
-    temperatures_row_3 = GetDatabaseEntries().create_list_of_data(3, 'temperature', timestamps)
-    temperatures_row_4 = GetDatabaseEntries().create_list_of_data(4, 'temperature', timestamps)
-    temperatures_row_5 = GetDatabaseEntries().create_list_of_data(5, 'temperature', timestamps)
-    humidity_row_1 = GetDatabaseEntries().create_list_of_data(1, 'humidity', timestamps)
-    humidity_row_2 = GetDatabaseEntries().create_list_of_data(2, 'humidity', timestamps)
-    humidity_row_3 = GetDatabaseEntries().create_list_of_data(3, 'humidity', timestamps)
-    humidity_row_4 = GetDatabaseEntries().create_list_of_data(4, 'humidity', timestamps)
-    humidity_row_5 = GetDatabaseEntries().create_list_of_data(5, 'humidity', timestamps)
-    soil_moisture_row_1 = GetDatabaseEntries().create_list_of_data(1, 'soil_moisture', timestamps)
-    soil_moisture_row_2 = GetDatabaseEntries().create_list_of_data(2, 'soil_moisture', timestamps)
-    soil_moisture_row_3 = GetDatabaseEntries().create_list_of_data(3, 'soil_moisture', timestamps)
-    soil_moisture_row_4 = GetDatabaseEntries().create_list_of_data(4, 'soil_moisture', timestamps)
-    soil_moisture_row_5 = GetDatabaseEntries().create_list_of_data(5, 'soil_moisture', timestamps)
-    light_exposure_row_1 = GetDatabaseEntries().create_list_of_data(1, 'light_exposure', timestamps)
-    light_exposure_row_2 = GetDatabaseEntries().create_list_of_data(2, 'light_exposure', timestamps)
-    light_exposure_row_3 = GetDatabaseEntries().create_list_of_data(3, 'light_exposure', timestamps)
-    light_exposure_row_4 = GetDatabaseEntries().create_list_of_data(4, 'light_exposure', timestamps)
-    light_exposure_row_5 = GetDatabaseEntries().create_list_of_data(5, 'light_exposure', timestamps)
+    global row_ids
+    global row_values
+
+    timestamps = GetDatabaseEntries().get_most_recent_timestamps(len)
+    row_ids = [row_id for row_id in GetDatabaseEntries().get_row_ids() if 1 <= row_id <= ROW_COUNT]
+    # Then get the values, only of the rows that have measurements
+    row_values = {}
+    for column, file_name in MEASUREMENT_FILES.values():
+        row_values[column] = {}
+        for row_id in row_ids:
+            row_values[column][row_id] = GetDatabaseEntries().create_list_of_data(row_id, column, timestamps)
 
 @app.route('/')
 def create_diagrams_page():
     create_data(60)
-    return render_template('index.html', 
-    temperature_values_1=temperatures_row_1, 
-    temperature_values_2=temperatures_row_2,
-    temperature_values_3=temperatures_row_3, 
-    temperature_values_4=temperatures_row_4, 
-    temperature_values_5=temperatures_row_5, 
-    humidity_values_1=humidity_row_1, 
-    humidity_values_2=humidity_row_2, 
-    humidity_values_3=humidity_row_3, 
-    humidity_values_4=humidity_row_4, 
-    humidity_values_5=humidity_row_5,
-    soil_moisture_values_1=soil_moisture_row_1,
-    soil_moisture_values_2=soil_moisture_row_2,
-    soil_moisture_values_3=soil_moisture_row_3, 
-    soil_moisture_values_4=soil_moisture_row_4, 
-    soil_moisture_values_5=soil_moisture_row_5, 
-    light_exposure_values_1=light_exposure_row_1,
-    light_exposure_values_2=light_exposure_row_2,
-    light_exposure_values_3=light_exposure_row_3,
-    light_exposure_values_4=light_exposure_row_4,
-    light_exposure_values_5=light_exposure_row_5,
+    return render_template('index.html',
+    rows=range(1, ROW_COUNT + 1),
+    row_ids=row_ids,
+    values=row_values,
     labels=timestamps)
 
 @app.route('/', methods=['POST'])
 def my_form_post():
-    if request.form['action'] == 'Submit row 1 thresholds':
-        submit_id=1
+    action = request.form['action']
+    submit = re.fullmatch(r'Submit row (\d+) thresholds', action)
+    if submit and 1 <= int(submit.group(1)) <= ROW_COUNT:
+        submit_id = int(submit.group(1))
         if submit_threshold_configuration(submit_id):
             return 'Done'
         else:
             return 'Wrong configuration'
-    elif request.form['action'] == 'Submit row 2 thresholds':
-        submit_id=2
-        if submit_threshold_configuration(submit_id):
-            return 'Done'
-        else:
-            return 'Wrong configuration'
-    elif request.form['action'] == 'Submit row 3 thresholds':
-        submit_id=3
-        if submit_threshold_configuration(submit_id):
-            return 'Done'
-        else:
-            return 'Wrong configuration'
-    elif request.form['action'] == 'Submit row 4 thresholds':
-        submit_id=4
-        if submit_threshold_configuration(submit_id):
-            return 'Done'
-        else:
-            return 'Wrong configuration'
-    elif request.form['action'] == 'Submit row 5 thresholds':
-        submit_id=5
-        if submit_threshold_configuration(submit_id):
-            return 'Done'
-        else:
-            return 'Wrong configuration'
-    elif request.form['action'] == 'Submit row 1 switches settings':
-        submit_id = 1
-        submit_control_configuration(submit_id)
-        # call function
-        return 'Row 1 control configured'
-    elif request.form['action'] == 'Submit row 2 switches settings':
-        submit_id = 2
+    submit = re.fullmatch(r'Submit row (\d+) switches settings', action)
+    if submit and 1 <= int(submit.group(1)) <= ROW_COUNT:
+        submit_id = int(submit.group(1))
         submit_control_configuration(submit_id)
-        # call function
-        return 'Row 2 control configured'
-    elif request.form['action'] == 'Submit row 3 switches settings':
-        submit_id = 3
-        submit_control_configuration(submit_id)
-        # call function
-        return 'Row 3 control configured'
-    elif request.form['action'] == 'Submit row 4 switches settings':
-        submit_id = 4
-        submit_control_configuration(submit_id)
-        # call function
-        return 'Row 4 control configured'
-    elif request.form['action'] == 'Submit row 5 switches settings':
-        submit_id = 5
-        submit_control_configuration(submit_id)
-        # call function
-        return 'Row 5 control configured'
-    elif request.form['action'] == 'Clear diagrams':
+        return 'Row {id} control configured'.format(id=submit_id)
+    if action == 'Clear diagrams':
         clear_measurement_diagrams()
         return 'Clear diagrams'
     return 'What do you want user???'
 
-# NOTE: The following code is garbage. Hardcoded non-maintainable stuff. Needs to be written in a more structured way -------------------------------------------
-@app.route('/generate_row_1_temps')
-def generate_row_1_temps():
-    create_data(0)
-    txt = ''
-    file_name = "row_1_temperatures.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if temperatures_row_1[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {temperatures_row_1[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_2_temps')
-def generate_row_2_temps():
-    create_data(0)
-    txt = ''
-    file_name = "row_2_temperatures.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if temperatures_row_2[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {temperatures_row_2[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_3_temps')
-def generate_row_3_temps():
-    create_data(0)
-    txt = ''
-    file_name = "row_3_temperatures.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if temperatures_row_3[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {temperatures_row_3[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_4_temps')
-def generate_row_4_temps():
-    create_data(0)
-    txt = ''
-    file_name = "row_4_temperatures.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if temperatures_row_4[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {temperatures_row_4[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_5_temps')
-def generate_row_5_temps():
-    create_data(0)
-    txt = ''
-    file_name = "row_5_temperatures.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if temperatures_row_5[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {temperatures_row_5[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_1_hum')
-def generate_row_1_hum():
-    create_data(0)
-    txt = ''
-    file_name = "row_1_humidity.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if humidity_row_1[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {humidity_row_1[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_2_hum')
-def generate_row_2_hum():
-    create_data(0)
-    txt = ''
-    file_name = "row_2_humidity.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if humidity_row_2[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {humidity_row_2[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_3_hum')
-def generate_row_3_hum():
-    create_data(0)
-    txt = ''
-    file_name = "row_3_humidity.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if humidity_row_3[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {humidity_row_3[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_4_hum')
-def generate_row_4_hum():
-    create_data(0)
-    txt = ''
-    file_name = "row_4_humidity.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if humidity_row_4[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {humidity_row_4[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_5_hum')
-def generate_row_5_hum():
-    create_data(0)
-    txt = ''
-    file_name = "row_5_humidity.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if humidity_row_5[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {humidity_row_5[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_1_light')
-def generate_row_1_light():
-    create_data(0)
-    txt = ''
-    file_name = "row_1_light_exposure.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if light_exposure_row_1[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {light_exposure_row_1[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_2_light')
-def generate_row_2_light():
-    create_data(0)
-    txt = ''
-    file_name = "row_2_light_exposure.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if light_exposure_row_2[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {light_exposure_row_2[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_3_light')
-def generate_row_3_light():
-    create_data(0)
-    txt = ''
-    file_name = "row_3_light_exposure.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if light_exposure_row_3[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {light_exposure_row_3[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_4_light')
-def generate_row_4_light():
-    create_data(0)
-    txt = ''
-    file_name = "row_4_light_exposure.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if light_exposure_row_4[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {light_exposure_row_4[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_5_light')
-def generate_row_5_light():
-    create_data(0)
-    txt = ''
-    file_name = "row_5_light_exposure.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if light_exposure_row_5[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {light_exposure_row_5[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_1_soil')
-def generate_row_1_soil():
-    create_data(0)
-    txt = ''
-    file_name = "row_1_soil_moisture.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if soil_moisture_row_1[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {soil_moisture_row_1[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_2_soil')
-def generate_row_2_soil():
-    create_data(0)
-    txt = ''
-    file_name = "row_2_soil_moisture.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if soil_moisture_row_2[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {soil_moisture_row_2[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_3_soil')
-def generate_row_3_soil():
-    create_data(0)
-    txt = ''
-    file_name = "row_3_soil_moisture.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if soil_moisture_row_3[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {soil_moisture_row_3[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_4_soil')
-def generate_row_4_soil():
-    create_data(0)
-    txt = ''
-    file_name = "row_4_soil_moisture.txt"
-
-    with open(file_name, 'w') as file:
-        file.write('timestamp; measurement\n')
-        for idx in range(len(timestamps)):
-            if soil_moisture_row_4[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {soil_moisture_row_4[idx]}\n'
-                file.write(line_to_write)
-
-    return send_file(file_name, as_attachment=True)
-
-@app.route('/generate_row_5_soil')
-def generate_row_5_soil():
+# Download the measurements of a row, e.g. /generate_row_1_temps
+@app.route('/generate_row_<int:row_id>_<kind>')
+def generate_row_measurements(row_id, kind):
+    if kind not in MEASUREMENT_FILES or row_id < 1 or row_id > ROW_COUNT:
+        abort(404)
+    column, file_name = MEASUREMENT_FILES[kind]
     create_data(0)
-    txt = ''
-    file_name = "row_5_soil_moisture.txt"
+    file_name = "row_{id}_{name}.txt".format(id=row_id, name=file_name)
+    values = row_values[column].get(row_id, ['None'] * len(timestamps))
 
     with open(file_name, 'w') as file:
         file.write('timestamp; measurement\n')
         for idx in range(len(timestamps)):
-            if soil_moisture_row_5[idx] != 'None':
-                line_to_write = f'{timestamps[idx]}; {soil_moisture_row_5[idx]}\n'
+            if values[idx] != 'None':
+                line_to_write = f'{timestamps[idx]}; {values[idx]}\n'
                 file.write(line_to_write)
 
     return send_file(file_name, as_attachment=True)
 
-# -------------------------------------------------------------------------------------------------------------------------------------------------------------
 if __name__ == "__main__":
     app.run(host="::", port=1068, debug=True)
@@ -90,14 +90,12 @@ void create_coap_row_mean_data_message(const row_mean_data_t* in_buffer, message
     out_buffer->type = MESSAGE_COAP_ROW_MEAN_DATA;
 
     // Set the message data
-    out_buffer->mean_hum = in_buffer->mean_row_humidity;
-    out_buffer->mean_temp = in_buffer->mean_row_temp;
-    out_buffer->mean_soil_moisture = in_buffer->mean_row_soil_moisture;
-    out_buffer->mean_light_intensity = in_buffer->mean_row_light;
+    out_buffer->mean = in_buffer->mean;
     out_buffer->is_fan_active = in_buffer->is_fan_active;
     out_buffer->is_water_on = in_buffer->is_watering_active;
     out_buffer->is_light_on = in_buffer->are_lights_active;
     out_buffer->row_id = in_buffer->row_id;
+    out_buffer->rejected_readings = in_buffer->rejected_readings;
 
     // Timestamp is in unix time
     out_buffer->timestamp = timestamp_val;
@@ -119,4 +117,73 @@ void create_update_timestamp_tx_message(message_update_timestamp_t *out_buffer)
 
     // Calculate crc of the message
     out_buffer->message_crc = crc16_ansi((uint8_t*)out_buffer, sizeof(message_update_timestamp_t) - sizeof(out_buffer->message_crc));
+}
+
+/**
+ * @brief Create a coap device info message object
+ * 
+ * @param in_buffer Link quality statistics of a sensor node
+ * @param out_buffer 
+ * @param timestamp_val 
+ */
+void create_coap_device_info_message(const link_quality_data_t *in_buffer, message_coap_device_info_t *out_buffer, int64_t timestamp_val)
+{
+    // Set type and length of message
+    out_buffer->len = sizeof(message_coap_device_info_t);
+    out_buffer->type = MESSAGE_COAP_DEVICE_INFO;
+
+    // Set the message data
+    memcpy(&out_buffer->link_quality, in_buffer, sizeof(link_quality_data_t));
+
+    // Timestamp is in unix time
+    out_buffer->timestamp = timestamp_val;
+
+    // Calculate crc of the message
+    out_buffer->message_crc = crc16_ansi((uint8_t*)out_buffer, sizeof(message_coap_device_info_t) - sizeof(out_buffer->message_crc));
+}
+
+/**
+ * @brief Create a coap read latency message object
+ * 
+ * @param in_buffer Read latency histogram of a kind of read
+ * @param out_buffer 
+ * @param timestamp_val 
+ */
+void create_coap_read_latency_message(const read_latency_data_t *in_buffer, message_coap_read_latency_t *out_buffer, int64_t timestamp_val)
+{
+    // Set type and length of message
+    out_buffer->len = sizeof(message_coap_read_latency_t);
+    out_buffer->type = MESSAGE_COAP_READ_LATENCY;
+
+    // Set the message data
+    memcpy(&out_buffer->read_latency, in_buffer, sizeof(read_latency_data_t));
+
+    // Timestamp is in unix time
+    out_buffer->timestamp = timestamp_val;
+
+    // Calculate crc of the message
+    out_buffer->message_crc = crc16_ansi((uint8_t*)out_buffer, sizeof(message_coap_read_latency_t) - sizeof(out_buffer->message_crc));
+}
+
+/**
+ * @brief Create a coap row window message object
+ * 
+ * @param in_buffer Rolling window statistics of a row
+ * @param out_buffer 
+ * @param timestamp_val 
+ */
+void create_coap_row_window_message(const row_window_data_t *in_buffer, message_coap_row_window_t *out_buffer, int64_t timestamp_val)
+{
+    // Set type and length of message
+    out_buffer->len = sizeof(message_coap_row_window_t);
+    out_buffer->type = MESSAGE_COAP_ROW_WINDOW;
+
+    // Set the message data
+    memcpy(&out_buffer->row_window, in_buffer, sizeof(row_window_data_t));
+
+    // Timestamp is in unix time
+    out_buffer->timestamp = timestamp_val;
+
+    // Calculate crc of the message
+    out_buffer->message_crc = crc16_ansi((uint8_t*)out_buffer, sizeof(message_coap_row_window_t) - sizeof(out_buffer->message_crc));
 }
\ No newline at end of file
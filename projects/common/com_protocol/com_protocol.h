@@ -23,6 +23,9 @@
 #define MESSAGE_COAP_ROW_MEAN_DATA 0xB1
 #define MESSAGE_COAP_ROW_CONTROL_USER_DATA 0xB2
 #define MESSAGE_COAP_ROW_THRESHOLDS_USER_DATA 0xB3
+#define MESSAGE_COAP_DEVICE_INFO 0xB4
+#define MESSAGE_COAP_READ_LATENCY 0xB5
+#define MESSAGE_COAP_ROW_WINDOW 0xB6
 
 // --- enums -------------------------------------------------------------------
 // --- MESSAGE_OPERATION_RESULT ---
@@ -93,9 +96,10 @@ typedef struct message_control_gpios_s
 {
     uint8_t type;
     uint8_t len;
-    bool row_fan_control[MAX_CONFIGURATION_ID];
-    bool row_water_control[MAX_CONFIGURATION_ID];
-    bool row_lights_control[MAX_CONFIGURATION_ID];
+    // Row bitmaps (see ROW_BITMAP_SIZE), a set bit turns the fan/water/lights of the row on
+    uint8_t row_fan_control[ROW_BITMAP_SIZE];
+    uint8_t row_water_control[ROW_BITMAP_SIZE];
+    uint8_t row_lights_control[ROW_BITMAP_SIZE];
     uint16_t message_crc;
 } message_control_gpios_t;
 #pragma pack(pop)
@@ -116,15 +120,13 @@ typedef struct message_coap_row_mean_data_s
 {
     uint8_t type;
     uint8_t len;
-    int16_t mean_temp;
-    uint16_t mean_hum;
-    uint16_t mean_soil_moisture;
-    uint16_t mean_light_intensity;
+    measurement_values_t mean;
     uint8_t row_id;
     int64_t timestamp;
     bool is_light_on;
     bool is_water_on;
     bool is_fan_active;
+    uint8_t rejected_readings;
     // TODO: currently unused
     uint16_t message_crc;
 } message_coap_row_mean_data_t;
@@ -162,6 +164,45 @@ typedef struct message_coap_row_thresholds_user_data_s
 } message_coap_row_thresholds_user_data_t;
 #pragma pack(pop)
 
+// --- MESSAGE_COAP_DEVICE_INFO ---
+#pragma pack(push, 1)
+typedef struct message_coap_device_info_s
+{
+    uint8_t type;
+    uint8_t len;
+    link_quality_data_t link_quality;
+    int64_t timestamp;
+    // TODO: currently unused
+    uint16_t message_crc;
+} message_coap_device_info_t;
+#pragma pack(pop)
+
+// --- MESSAGE_COAP_READ_LATENCY ---
+#pragma pack(push, 1)
+typedef struct message_coap_read_latency_s
+{
+    uint8_t type;
+    uint8_t len;
+    read_latency_data_t read_latency;
+    int64_t timestamp;
+    // TODO: currently unused
+    uint16_t message_crc;
+} message_coap_read_latency_t;
+#pragma pack(pop)
+
+// --- MESSAGE_COAP_ROW_WINDOW ---
+#pragma pack(push, 1)
+typedef struct message_coap_row_window_s
+{
+    uint8_t type;
+    uint8_t len;
+    row_window_data_t row_window;
+    int64_t timestamp;
+    // TODO: currently unused
+    uint16_t message_crc;
+} message_coap_row_window_t;
+#pragma pack(pop)
+
 // --- functions declarations --------------------------------------------------
 void create_measurements_data_tx_message(const measurements_data_t *in_buffer, message_measurement_data_t *out_buffer);
 void create_row_mean_data_tx_message(const row_mean_data_t *in_buffer, message_row_mean_data_t *out_buffer);
@@ -169,5 +210,8 @@ void create_operation_result_tx_message(message_operation_result_t *out_buffer,
 void create_ready_for_cloud_tx_message(message_ready_for_cloud_t *out_buffer);
 void create_coap_row_mean_data_message(const row_mean_data_t* in_buffer, message_coap_row_mean_data_t *out_buffer, int64_t timestamp_val);
 void create_update_timestamp_tx_message(message_update_timestamp_t *out_buffer);
+void create_coap_device_info_message(const link_quality_data_t *in_buffer, message_coap_device_info_t *out_buffer, int64_t timestamp_val);
+void create_coap_read_latency_message(const read_latency_data_t *in_buffer, message_coap_read_latency_t *out_buffer, int64_t timestamp_val);
+void create_coap_row_window_message(const row_window_data_t *in_buffer, message_coap_row_window_t *out_buffer, int64_t timestamp_val);
 
 #endif // COM_PROTOCOL_H
\ No newline at end of file
@@ -4,6 +4,7 @@
 // --- includes ----------------------------------------------------------------
 #include "zephyr/bluetooth/uuid.h"
 #include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/addr.h>
 
 // --- defines -----------------------------------------------------------------
 // --- ble services ---
@@ -27,6 +28,12 @@
 
 #define BT_UUID_LIGHT_EXPOSURE BT_UUID_DECLARE_128(LIGHT_EXPOSURE_UUID_VAL)
 
+// Every measurement of a single sampling pass, packed as measurement_record_t
+#define MEASUREMENT_RECORD_UUID_VAL \
+    BT_UUID_128_ENCODE(0x0b208f0a, 0xa0bf, 0x4d57, 0xb778, 0x38f899264e76)
+
+#define BT_UUID_MEASUREMENT_RECORD BT_UUID_DECLARE_128(MEASUREMENT_RECORD_UUID_VAL)
+
 // e4fd83a4-ba92-11ec-8422-0242ac120002
 #define CONFIGURATION_ID_UUID 0x02, 0x00, 0x12, 0xAC, 0x42, 0x02, 0x22, 0x84, \
                               0xEC, 0x11, 0x92, 0xBA, 0xA4, 0x83, 0xFD, 0xE4
@@ -41,11 +48,98 @@
                                 0xEC, 0x11, 0x92, 0xBA, 0xA4, 0x83, 0xFD, 0xCC
 #define BT_UUID_SOIL_DRY BT_UUID_DECLARE_128(SOIL_MOISTURE_DRY_CALIB)
 
+// ddfd83a4-ba92-11ec-8422-0242ac120002
+#define TIME_BEACON_UUID 0x02, 0x00, 0x12, 0xAC, 0x42, 0x02, 0x22, 0x84, \
+                         0xEC, 0x11, 0x92, 0xBA, 0xA4, 0x83, 0xFD, 0xDD
+#define BT_UUID_TIME_BEACON BT_UUID_DECLARE_128(TIME_BEACON_UUID)
+
 #define BT_UUID_CONFIGURE_SERVICE BT_UUID_DECLARE_128(CONFIGURE_SERVICE_UUID)
 
-// --- represents the max number of groups supported
+// --- represents the max number of groups supported (rows, row ids 1 to MAX_CONFIGURATION_ID)
+// Can be raised from CMakeLists.txt, up to 255 since row ids are 8 bit
+#ifndef MAX_CONFIGURATION_ID
 #define MAX_CONFIGURATION_ID 5
-#define MAC_ADDRESS_LENGTH 17
+#endif
+#if MAX_CONFIGURATION_ID > 255
+#error "MAX_CONFIGURATION_ID must fit the 8 bit row id"
+#endif
+
+// --- row bitmaps: one bit per row, the row with id 1 (row index 0) is bit 0 of byte 0
+#define ROW_BITMAP_SIZE ((MAX_CONFIGURATION_ID + 7) / 8)
+#define ROW_BITMAP_TEST(bitmap, row_index) (((bitmap)[(row_index) / 8] >> ((row_index) % 8)) & 1U)
+#define ROW_BITMAP_SET(bitmap, row_index) ((bitmap)[(row_index) / 8] |= (uint8_t)(1U << ((row_index) % 8)))
+#define ROW_BITMAP_CLEAR(bitmap, row_index) ((bitmap)[(row_index) / 8] &= (uint8_t)~(1U << ((row_index) % 8)))
+#define ROW_BITMAP_ASSIGN(bitmap, row_index, value) \
+    ((value) ? ROW_BITMAP_SET(bitmap, row_index) : ROW_BITMAP_CLEAR(bitmap, row_index))
+// Loop over the rows that are set on a bitmap, skipping 8 unset rows at a time
+#define ROW_BITMAP_FOR_EACH(bitmap, row_index) \
+    for ((row_index) = row_bitmap_next((bitmap), 0); (row_index) < MAX_CONFIGURATION_ID; \
+         (row_index) = row_bitmap_next((bitmap), (row_index) + 1))
+
+// --- measurements_data_t valid_fields flags, set when a field was read on the current cycle
+#define MEASUREMENT_TEMPERATURE_VALID BIT(0)
+#define MEASUREMENT_HUMIDITY_VALID BIT(1)
+#define MEASUREMENT_SOIL_MOISTURE_VALID BIT(2)
+#define MEASUREMENT_LIGHT_VALID BIT(3)
+#define MEASUREMENT_BATTERY_VALID BIT(4)
+#define MEASUREMENT_ROW_ID_VALID BIT(5)
+// A node is used on a cycle if at least one of its measurements is valid
+#define MEASUREMENT_VALUES_VALID_MASK (MEASUREMENT_TEMPERATURE_VALID | MEASUREMENT_HUMIDITY_VALID | \
+                                       MEASUREMENT_SOIL_MOISTURE_VALID | MEASUREMENT_LIGHT_VALID)
+
+// --- fixed point measurement values (measurement_values_t)
+// Temperature, humidity and soil moisture are sent scaled by MEASUREMENT_VALUE_SCALE
+// (2032 = 20.32 C), light intensity in lux
+#define MEASUREMENT_VALUE_SCALE 100
+
+// --- measurement record (measurement_record_t)
+// Incremented whenever measurement_record_t changes
+#define MEASUREMENT_RECORD_VERSION 2
+
+// --- sampling epochs: the central writes its time base (time_beacon_t) to the
+// nodes, which then sample at the start of every epoch of the central
+// Epoch numbers count modulo MEASUREMENT_EPOCH_WRAP, the last value is reserved
+#define MEASUREMENT_EPOCH_WRAP 0xFFFF
+// Epoch of a record sampled by a node without time base
+#define MEASUREMENT_EPOCH_UNSYNCHRONIZED 0xFFFF
+
+// --- connectionless telemetry: record advertised as manufacturer specific data
+// Company id of the record (0xFFFF is the id reserved for internal use)
+#define TELEMETRY_ADV_COMPANY_ID 0xFFFF
+
+// --- link quality of a sensor node (link_quality_data_t)
+// Read cycles kept on the sample ring, and disconnections kept on the reason ring
+#define LINK_QUALITY_RING_SIZE 8
+#define LINK_QUALITY_REASON_RING_SIZE 4
+// RSSI of a sample when it could not be read (same as HCI "not available")
+#define LINK_QUALITY_RSSI_UNKNOWN 127
+// Read latency of a sample whose read sequence timed out
+#define LINK_QUALITY_LATENCY_TIMEOUT 0xFFFF
+
+// --- GATT read latency histograms (link_quality_data_t, read_latency_data_t)
+// Bucket 0 counts the reads faster than 2^READ_LATENCY_BUCKET_0_SHIFT us (1 ms), every
+// next bucket doubles the range. The last bucket counts every slower read
+#define READ_LATENCY_BUCKET_COUNT 12
+#define READ_LATENCY_BUCKET_0_SHIFT 10
+// Kinds of read with a histogram: a single characteristic read (by characteristic
+// index), a measurement record read and a read multiple request
+#define READ_LATENCY_CHARACTERISTIC_COUNT 6
+#define READ_LATENCY_KIND_RECORD (READ_LATENCY_CHARACTERISTIC_COUNT)
+#define READ_LATENCY_KIND_MULTIPLE (READ_LATENCY_CHARACTERISTIC_COUNT + 1)
+#define READ_LATENCY_KIND_COUNT (READ_LATENCY_CHARACTERISTIC_COUNT + 2)
+
+// --- rolling window of the row values (row_window_data_t)
+// Row values kept per row and field, one per measurement cycle the field was measured on
+#define ROW_WINDOW_SIZE 16
+// Fields of a row window, in the order of the MEASUREMENT_*_VALID flags: temperature,
+// humidity, soil moisture and light intensity
+#define ROW_WINDOW_FIELD_COUNT 4
+#define ROW_WINDOW_FIELD_TEMPERATURE 0
+#define ROW_WINDOW_FIELD_HUMIDITY 1
+#define ROW_WINDOW_FIELD_SOIL_MOISTURE 2
+#define ROW_WINDOW_FIELD_LIGHT 3
+// Weight of a new row value on the exponentially weighted moving average, Q8 (0.25)
+#define ROW_WINDOW_EWMA_ALPHA_Q8 64
 
 // --- enums -------------------------------------------------------------------
 enum error_codes_e
@@ -55,39 +149,175 @@ enum error_codes_e
 };
 
 // --- structs -----------------------------------------------------------------
+// Fixed point measurement values (see MEASUREMENT_VALUE_SCALE). Same format on every
+// hop: BLE characteristics and record, measurements data, UART and CoAP messages
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct measurement_values_s
+{
+    int16_t temperature; // 2032 = 20.32 C
+    uint16_t humidity; // 6642 = 66.42 %
+    uint16_t soil_moisture; // 5000 = 50 %
+    uint16_t light_intensity; // lux
+} measurement_values_t;
+#pragma pack(pop)
+
 // Struct to store measurement data from each node
 #pragma pack(push, 1)
 typedef struct measurements_data_s
 {
-    // TODO: is there a better way to link each ble_connection_data_t bluetooth_devices member
-    // with a measurements_data_t member? (maybe ble MAC address?) for now by connection handle
-    struct bt_conn *ble_connection_handle;
-    //BT_ADDR_LE_STR_LEN
-    char mac_address[MAC_ADDRESS_LENGTH];
-    // TODO: change measurement values to int16_t type everywhere
-    int32_t ambient_temp_measurement;
-    int32_t ambient_hum_measurement;
-    int32_t soil_moisture_measurement;
-    int32_t light_measurement;
+    // Address of the sensor node (7 bytes, rendered with bt_addr_le_to_str() only to be shown)
+    bt_addr_le_t peer_address;
+    measurement_values_t values;
     uint8_t battery_level; // Takes values from 0-100 (%)
     uint8_t row_id;
+    // Fields read on the current cycle (see MEASUREMENT_TEMPERATURE_VALID)
+    uint8_t valid_fields;
 } measurements_data_t;
 #pragma pack(pop)
 
+// Every measurement of a sensor node, taken on a single sampling pass. Read by the
+// central as one characteristic, or advertised in connectionless telemetry mode
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct measurement_record_s
+{
+    uint8_t version;
+    // Incremented on every sampling pass, repeated reads or advertisements keep it
+    uint8_t sequence_number;
+    // Sampling epoch of the record (MEASUREMENT_EPOCH_UNSYNCHRONIZED without time base)
+    uint16_t epoch;
+    measurement_values_t values;
+    uint8_t battery_level; // Takes values from 0-100 (%)
+    uint8_t row_id;
+} measurement_record_t;
+#pragma pack(pop)
+
+// Measurement record advertised by sensor nodes in connectionless telemetry mode
+#pragma pack(push, 1)
+typedef struct telemetry_adv_record_s
+{
+    uint16_t company_id;
+    measurement_record_t measurement;
+} telemetry_adv_record_t;
+#pragma pack(pop)
+
+// Time base written by the central to the time beacon characteristic
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct time_beacon_s
+{
+    uint16_t epoch; // current sampling epoch of the central
+    uint32_t epoch_time; // ms elapsed since the start of the epoch
+    uint16_t epoch_period; // seconds
+} time_beacon_t;
+#pragma pack(pop)
+
 // Struct to store mean measurements for each row
 #pragma pack(push, 1)
 typedef struct row_mean_data_s
 {
-    int16_t mean_row_temp;
-    int16_t mean_row_humidity;
-    int16_t mean_row_soil_moisture;
-    int16_t mean_row_light;
+    // Row values of the row
+    measurement_values_t mean;
     bool is_fan_active;
     bool is_watering_active;
     bool are_lights_active;
     bool is_row_registered;
     uint8_t row_id;
+    // Measurements left out of the row values by the row estimator (outliers)
+    uint8_t rejected_readings;
 } row_mean_data_t;
 #pragma pack(pop)
 
+// Link quality statistics the central keeps for every sensor node. The rings
+// are written at the head index, the oldest entry follows it once the ring is full
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct link_quality_data_s
+{
+    bt_addr_le_t peer_address;
+    // Samples of the read cycles (oldest first from sample_head once full)
+    uint8_t sample_count;
+    uint8_t sample_head;
+    int8_t rssi[LINK_QUALITY_RING_SIZE]; // dBm
+    uint16_t read_latency[LINK_QUALITY_RING_SIZE]; // ms
+    // Counters since the central started
+    uint16_t read_timeouts;
+    uint16_t read_failures;
+    uint16_t reconnects;
+    uint16_t disconnects;
+    // HCI reasons of the last disconnections
+    uint8_t reason_count;
+    uint8_t reason_head;
+    uint8_t disconnect_reasons[LINK_QUALITY_REASON_RING_SIZE];
+    // Latency of every read of the node (see READ_LATENCY_BUCKET_COUNT)
+    uint32_t read_latency_histogram[READ_LATENCY_BUCKET_COUNT];
+    // Achieved sampling period (ms) of the node in rotation and telemetry modes,
+    // 0 if it is not known
+    uint32_t sampling_period;
+} link_quality_data_t;
+#pragma pack(pop)
+
+// Latency of a kind of read (see READ_LATENCY_KIND_COUNT), over every sensor node
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct read_latency_data_s
+{
+    // Takes values like: READ_LATENCY_KIND_RECORD, or a characteristic index
+    uint8_t read_kind;
+    uint32_t read_latency_histogram[READ_LATENCY_BUCKET_COUNT];
+} read_latency_data_t;
+#pragma pack(pop)
+
+// Statistics of a field over the window of a row, in the unit of the row value
+// Every multi-byte field is little endian
+#pragma pack(push, 1)
+typedef struct row_window_field_s
+{
+    // Row values on the window, up to ROW_WINDOW_SIZE
+    uint8_t sample_count;
+    // 32 bit values, light intensity (up to 65535 lux) does not fit in int16
+    int32_t ewma;
+    int32_t min;
+    int32_t max;
+    // Least squares slope over the window, change per hour
+    int32_t slope;
+} row_window_field_t;
+#pragma pack(pop)
+
+// Rolling window statistics of a row (see ROW_WINDOW_SIZE)
+#pragma pack(push, 1)
+typedef struct row_window_data_s
+{
+    uint8_t row_id;
+    row_window_field_t fields[ROW_WINDOW_FIELD_COUNT];
+} row_window_data_t;
+#pragma pack(pop)
+
+// --- inline functions --------------------------------------------------------
+/**
+ * @brief Find the first row that is set on a row bitmap, starting from a row
+ *
+ * @param bitmap Row bitmap of ROW_BITMAP_SIZE bytes
+ * @param row_index Row to start from
+ * @return row index, MAX_CONFIGURATION_ID if no row is set from row_index on
+ */
+static inline uint16_t row_bitmap_next(const uint8_t *bitmap, uint16_t row_index)
+{
+    uint8_t rows;
+
+    while (row_index < MAX_CONFIGURATION_ID)
+    {
+        rows = bitmap[row_index / 8] >> (row_index % 8);
+        if (rows != 0)
+        {
+            return row_index + __builtin_ctz(rows);
+        }
+        // No row is set on the rest of this byte
+        row_index = (row_index / 8 + 1) * 8;
+    }
+
+    return MAX_CONFIGURATION_ID;
+}
+
 #endif // COMMON_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 // --- includes ----------------------------------------------------------------
 #include "ble_configure_service.h"
+#include "ble_measurement_service.h"
 #include "../flash_system/flash_system.h"
 #include "../../common/common.h"
 #include "../soil_moisture/soil_moisture.h"
@@ -23,6 +24,12 @@ static ssize_t configuration_write_id(struct bt_conn *conn,
                           uint16_t len,
                           uint16_t offset,
                           uint8_t flags);
+static ssize_t time_beacon_write(struct bt_conn *conn,
+                                 const struct bt_gatt_attr *attr,
+                                 const void *buf,
+                                 uint16_t len,
+                                 uint16_t offset,
+                                 uint8_t flags);
 static ssize_t on_read_soil_dry_calib(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                       void *buf, uint16_t len, uint16_t offset);
 static ssize_t on_read_soil_wet_calib(struct bt_conn *conn, const struct bt_gatt_attr *attr,
@@ -62,6 +69,32 @@ static ssize_t configuration_write_id(struct bt_conn *conn,
     return len;
 }
 
+/* This function is called whenever the central writes its time base */
+static ssize_t time_beacon_write(struct bt_conn *conn,
+                                 const struct bt_gatt_attr *attr,
+                                 const void *buf,
+                                 uint16_t len,
+                                 uint16_t offset,
+                                 uint8_t flags)
+{
+    time_beacon_t beacon;
+
+    if (offset != 0)
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != sizeof(beacon))
+    {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    memcpy(&beacon, buf, sizeof(beacon));
+    set_time_beacon(&beacon);
+
+    return len;
+}
+
 static ssize_t on_read_battery_level(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                 void *buf, uint16_t len, uint16_t offset)
 {
@@ -118,4 +151,5 @@ BT_GATT_SERVICE_DEFINE(configuration_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_CO
                        BT_GATT_CHARACTERISTIC(BT_UUID_SOIL_DRY, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_soil_dry_calib, NULL, NULL),
                        BT_GATT_CCC(NULL, BT_GATT_PERM_READ),
                        BT_GATT_CHARACTERISTIC(BT_UUID_SOIL_WET, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_soil_wet_calib, NULL, NULL),
-                       BT_GATT_CCC(NULL, BT_GATT_PERM_READ));
\ No newline at end of file
+                       BT_GATT_CCC(NULL, BT_GATT_PERM_READ),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_TIME_BEACON, BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE, NULL, time_beacon_write, NULL));
\ No newline at end of file
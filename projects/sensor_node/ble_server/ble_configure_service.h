@@ -5,7 +5,9 @@
 #include <stdint.h>
 
 // --- defines -----------------------------------------------------------------
-// --- represents the max number of groups supported
+// --- represents the max number of groups supported (same as on the central)
+#ifndef MAX_CONFIGURATION_ID
 #define MAX_CONFIGURATION_ID 5
+#endif
 
 #endif // BLE_CONFIGURE_SERVICE
\ No newline at end of file
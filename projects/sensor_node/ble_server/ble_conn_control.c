@@ -1,9 +1,14 @@
 // --- includes ----------------------------------------------------------------
 #include "ble_conn_control.h"
+#include "ble_measurement_service.h"
 #include "../../common/common.h"
 
 #include <zephyr/logging/log.h>
 
+#if defined(ADV_TELEMETRY_MODE) && !defined(CONFIG_BT_EXT_ADV)
+#error "ADV_TELEMETRY_MODE needs CONFIG_BT_EXT_ADV (see prj.conf)"
+#endif
+
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_DECLARE(ble_m);
 
@@ -41,6 +46,11 @@ static const struct bt_data sd[] =
 
 static K_SEM_DEFINE(ble_init_ok, 0, 1);
 
+#ifdef ADV_TELEMETRY_MODE
+// Extended advertising set carrying the measurement record
+static struct bt_le_ext_adv *telemetry_adv;
+#endif
+
 // --- structs -----------------------------------------------------------------
 static struct bt_conn_cb conn_callbacks =
 {
@@ -66,6 +76,8 @@ static void connected(struct bt_conn *conn, uint8_t err)
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
     LOG_INF("Disconnected (reason %u)\n", reason);
+    // Nothing reads the epoch samples until the central connects again
+    stop_epoch_sampling();
 }
 
 static void bt_ready(int err)
@@ -170,3 +182,54 @@ void start_operating_state_adv(void)
 
     LOG_INF("Advertising successfully started\n");
 }
+
+#ifdef ADV_TELEMETRY_MODE
+// Function to start advertising the measurement record (connectionless telemetry)
+// This function is called instead of start_operating_state_adv(). The advertising
+// set is non connectable; the identity address is used so that the central keeps
+// recognizing the node
+void start_telemetry_adv(void)
+{
+    int err;
+
+    err = bt_le_ext_adv_create(BT_LE_ADV_PARAM(BT_LE_ADV_OPT_EXT_ADV | BT_LE_ADV_OPT_USE_IDENTITY,
+                                               BT_GAP_ADV_SLOW_INT_MIN, BT_GAP_ADV_SLOW_INT_MAX, NULL),
+                               NULL, &telemetry_adv);
+    if (err)
+    {
+        LOG_INF("Telemetry advertising set failed to be created (err %d)\n", err);
+        return;
+    }
+
+    err = bt_le_ext_adv_start(telemetry_adv, BT_LE_EXT_ADV_START_DEFAULT);
+    if (err)
+    {
+        LOG_INF("Telemetry advertising failed to start (err %d)\n", err);
+        return;
+    }
+
+    LOG_INF("Telemetry advertising successfully started\n");
+}
+
+// Function to replace the advertised measurement record
+// This function is called every time the sensors are sampled
+void update_telemetry_adv(const telemetry_adv_record_t *record)
+{
+    int err;
+    const struct bt_data telemetry_adv_data[] =
+    {
+        BT_DATA(BT_DATA_MANUFACTURER_DATA, record, sizeof(telemetry_adv_record_t)),
+    };
+
+    if (telemetry_adv == NULL)
+    {
+        return;
+    }
+
+    err = bt_le_ext_adv_set_data(telemetry_adv, telemetry_adv_data, ARRAY_SIZE(telemetry_adv_data), NULL, 0);
+    if (err)
+    {
+        LOG_INF("Telemetry advertising data failed to be set (err %d)\n", err);
+    }
+}
+#endif // ADV_TELEMETRY_MODE
@@ -9,6 +9,7 @@
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
+#include "../../common/common.h"
 
 // --- defines -----------------------------------------------------------------
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
@@ -19,5 +20,9 @@ void ble_init(void);
 struct bt_conn* get_ble_connection(void);
 void start_configure_state_adv(void);
 void start_operating_state_adv(void);
+#ifdef ADV_TELEMETRY_MODE
+void start_telemetry_adv(void);
+void update_telemetry_adv(const telemetry_adv_record_t *record);
+#endif
 
 #endif // BLE_CONN_CONTROL_H
\ No newline at end of file
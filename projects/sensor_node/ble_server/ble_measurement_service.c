@@ -5,9 +5,12 @@
 #include "../../common/common.h"
 #include "../gpio/gpioif.h"
 #include "../soil_moisture/soil_moisture.h"
+#include "../timer_module/timer_module.h"
+#include "../flash_system/flash_system.h"
 #include <zephyr/logging/log.h>
 
 #include <zephyr/bluetooth/addr.h>
+#include <zephyr/sys/byteorder.h>
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(ble_m);
@@ -18,13 +21,50 @@ static ssize_t on_read_temperature(struct bt_conn *conn, const struct bt_gatt_at
                                    void *buf, uint16_t len, uint16_t offset);
 static ssize_t on_read_humidity(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                 void *buf, uint16_t len, uint16_t offset);
+static int16_t sample_temperature(void);
+static uint16_t sample_humidity(void);
+static uint16_t sample_light_exposure(void);
+static uint16_t sample_soil_moisture(void);
+static void sample_measurement_record(measurement_record_t *record);
+static ssize_t on_read_measurement_record(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                          void *buf, uint16_t len, uint16_t offset);
+static bool is_any_measurement_subscribed(void);
+static void measurement_notify_work_handler(struct k_work *work);
+static void sampling_epoch_work_handler(struct k_work *work);
+static uint16_t get_sampling_epoch(void);
+#ifdef ADV_TELEMETRY_MODE
+static void advertise_telemetry_record(void);
+#endif
+
+// --- static variables definitions --------------------------------------------
+// Work item that samples the sensors and notifies the central (or advertises the
+// measurements in telemetry mode). It is submitted by the measurement notify timer
+// (see timer_module)
+static K_WORK_DEFINE(measurement_notify_work, measurement_notify_work_handler);
+// Sequence number of the last sampled record, lets the central skip repeated records
+static uint8_t measurement_sequence_number;
+// Record sent on the measurement record characteristic, kept for long reads
+static measurement_record_t read_measurement_record;
+// Work item that samples the sensors at the start of every sampling epoch of the
+// central. It is submitted by the sampling epoch timer (see timer_module)
+static K_WORK_DEFINE(sampling_epoch_work, sampling_epoch_work_handler);
+// Time base written by the central (see set_time_beacon()): local uptime (ms) of
+// the start of time_base_epoch, and the epoch period
+static bool is_time_synchronized;
+static int64_t time_base_start;
+static uint16_t time_base_epoch;
+static uint32_t epoch_period_ms;
+// Record sampled at the start of the last epoch
+static measurement_record_t epoch_record;
+static bool is_epoch_record_valid;
+// Time base and epoch record are used by the bt rx thread and the system workqueue
+static K_MUTEX_DEFINE(epoch_record_mutex);
 
 // --- static functions definitions --------------------------------------------
 /*
  * This function is called whenever the CCCD register has been changed by the
- * client
- *
- * TODO: not useful right now but might need in the future
+ * client. While at least one measurement characteristic is subscribed, the node
+ * samples its sensors and notifies the central every MEASUREMENT_NOTIFY_PERIOD_IN_SEC
  */
 static void on_cccd_changed_measurement(const struct bt_gatt_attr *attr, uint16_t value)
 {
@@ -32,7 +72,8 @@ static void on_cccd_changed_measurement(const struct bt_gatt_attr *attr, uint16_
     switch (value)
     {
     case BT_GATT_CCC_NOTIFY:
-        // Start sending stuff!
+        // Start sending stuff! First notification right away
+        start_measurement_notify_timer(K_NO_WAIT, K_SECONDS(MEASUREMENT_NOTIFY_PERIOD_IN_SEC));
         break;
 
     case BT_GATT_CCC_INDICATE:
@@ -40,7 +81,11 @@ static void on_cccd_changed_measurement(const struct bt_gatt_attr *attr, uint16_
         break;
 
     case 0:
-        // Stop sending stuff
+        // Stop sending stuff when no characteristic is subscribed anymore
+        if (!is_any_measurement_subscribed())
+        {
+            stop_measurement_notify_timer();
+        }
         break;
 
     default:
@@ -48,8 +93,12 @@ static void on_cccd_changed_measurement(const struct bt_gatt_attr *attr, uint16_
     }
 }
 
-static ssize_t on_read_temperature(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-                                   void *buf, uint16_t len, uint16_t offset)
+/**
+ * @brief Take a temperature measurement
+ *
+ * @return int16_t temperature, 2032 = 20.32 C
+ */
+static int16_t sample_temperature(void)
 {
     int32_t temperature_value;
 #ifndef SW_SENSOR_EMULATION_MODE
@@ -60,22 +109,22 @@ static ssize_t on_read_temperature(struct bt_conn *conn, const struct bt_gatt_at
     // Fetch the measurement on a local variable
     temperature = get_temperature_measurement();
 
-    // Convert temperature from sensor_value format to int32_t
+    // Convert temperature from sensor_value format to fixed point
     temperature_value = temperature.val1 * 100 + temperature.val2 / 10000;
 #else
     temperature_value = 3266;
 #endif
-    // Send the measurement
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &temperature_value,
-                             sizeof(temperature_value));
+    return (int16_t)temperature_value;
 }
 
-static ssize_t on_read_humidity(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-                                void *buf, uint16_t len, uint16_t offset)
+/**
+ * @brief Take a humidity measurement
+ *
+ * @return uint16_t humidity, 6642 = 66.42%
+ */
+static uint16_t sample_humidity(void)
 {
-
     int32_t humidity_value;
-
 #ifndef SW_SENSOR_EMULATION_MODE
     struct sensor_value humidity;
 
@@ -84,19 +133,21 @@ static ssize_t on_read_humidity(struct bt_conn *conn, const struct bt_gatt_attr
     // Fetch the measurement on a local variable
     humidity = get_humidity_measurement();
 
-    // Convert humidity from sensor_value format to int32_t
+    // Convert humidity from sensor_value format to fixed point
     humidity_value = humidity.val1 * 100 + humidity.val2 / 10000;
 
 #else 
     humidity_value = 6642;
 #endif
-    // Send the measurement
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &humidity_value,
-                             sizeof(humidity_value));
+    return (uint16_t)humidity_value;
 }
 
-static ssize_t on_read_light_exposure(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-                                      void *buf, uint16_t len, uint16_t offset)
+/**
+ * @brief Take a light exposure measurement
+ *
+ * @return uint16_t light exposure in lux
+ */
+static uint16_t sample_light_exposure(void)
 {
     int32_t light_exposure;
 #ifndef SW_SENSOR_EMULATION_MODE
@@ -108,12 +159,16 @@ static ssize_t on_read_light_exposure(struct bt_conn *conn, const struct bt_gatt
 #else
     light_exposure = 18000;
 #endif
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, &light_exposure,
-                             sizeof(light_exposure));
+    // BH1750 measures up to 65535 lux
+    return (uint16_t)CLAMP(light_exposure, 0, UINT16_MAX);
 }
 
-static ssize_t on_read_soil_moisture(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-                                     void *buf, uint16_t len, uint16_t offset)
+/**
+ * @brief Take a soil moisture measurement
+ *
+ * @return uint16_t soil moisture, 5000 = 50%
+ */
+static uint16_t sample_soil_moisture(void)
 {
     int32_t soil_moisture;
 #ifndef SW_SENSOR_EMULATION_MODE
@@ -126,21 +181,315 @@ static ssize_t on_read_soil_moisture(struct bt_conn *conn, const struct bt_gatt_
 #else
     soil_moisture = 5000; // 50%
 #endif
+    return (uint16_t)soil_moisture;
+}
+
+/**
+ * @brief Sample every sensor once and fill a measurement record. Temperature and
+ *        humidity come from a single fetch of the temp hum sensor
+ *
+ * @param record Filled with the sampled measurements (little endian)
+ */
+static void sample_measurement_record(measurement_record_t *record)
+{
+    int32_t temperature_value;
+    int32_t humidity_value;
+    uint8_t configuration_id = 0;
+#ifndef SW_SENSOR_EMULATION_MODE
+    struct sensor_value temperature;
+    struct sensor_value humidity;
+
+    measure_temperature_humidity();
+    temperature = get_temperature_measurement();
+    humidity = get_humidity_measurement();
+    temperature_value = temperature.val1 * 100 + temperature.val2 / 10000;
+    humidity_value = humidity.val1 * 100 + humidity.val2 / 10000;
+#else
+    temperature_value = sample_temperature();
+    humidity_value = sample_humidity();
+#endif
+
+    // Read stored configuration id
+    nvs_read(get_file_system_handle(), DEVICE_CONFIGURATION_FLASH_KEY, &configuration_id, sizeof(configuration_id));
+
+    record->version = MEASUREMENT_RECORD_VERSION;
+    record->sequence_number = ++measurement_sequence_number;
+    record->epoch = sys_cpu_to_le16(get_sampling_epoch());
+    record->values.temperature = sys_cpu_to_le16((int16_t)temperature_value);
+    record->values.humidity = sys_cpu_to_le16((uint16_t)humidity_value);
+    record->values.soil_moisture = sys_cpu_to_le16(sample_soil_moisture());
+    record->values.light_intensity = sys_cpu_to_le16(sample_light_exposure());
+    // Same value as the battery level characteristic (battery is not measured yet)
+    record->battery_level = 64;
+    record->row_id = configuration_id;
+}
+
+static ssize_t on_read_temperature(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                   void *buf, uint16_t len, uint16_t offset)
+{
+    // Sent as the temperature of measurement_values_t
+    int16_t temperature_value = sys_cpu_to_le16(sample_temperature());
+
+    // Send the measurement
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &temperature_value,
+                             sizeof(temperature_value));
+}
+
+static ssize_t on_read_humidity(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                void *buf, uint16_t len, uint16_t offset)
+{
+    uint16_t humidity_value = sys_cpu_to_le16(sample_humidity());
+
+    // Send the measurement
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &humidity_value,
+                             sizeof(humidity_value));
+}
+
+static ssize_t on_read_light_exposure(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                      void *buf, uint16_t len, uint16_t offset)
+{
+    uint16_t light_exposure = sys_cpu_to_le16(sample_light_exposure());
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &light_exposure,
+                             sizeof(light_exposure));
+}
+
+static ssize_t on_read_soil_moisture(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                     void *buf, uint16_t len, uint16_t offset)
+{
+    uint16_t soil_moisture = sys_cpu_to_le16(sample_soil_moisture());
+
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &soil_moisture,
                              sizeof(soil_moisture));
 }
 
+static ssize_t on_read_measurement_record(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                          void *buf, uint16_t len, uint16_t offset)
+{
+    bool is_epoch_record_current = false;
+
+    // A read that does not fit in the ATT MTU goes on with an offset, the rest
+    // of the same record is sent then
+    if (offset == 0)
+    {
+        // Send the record sampled at the start of the current epoch, so every node
+        // of the row reports the same instant
+        k_mutex_lock(&epoch_record_mutex, K_FOREVER);
+        is_epoch_record_current = is_epoch_record_valid &&
+                                  sys_le16_to_cpu(epoch_record.epoch) == get_sampling_epoch();
+        if (is_epoch_record_current)
+        {
+            read_measurement_record = epoch_record;
+        }
+        k_mutex_unlock(&epoch_record_mutex);
+
+        // No time base, or the epoch was not sampled yet (e.g. right after the beacon)
+        if (!is_epoch_record_current)
+        {
+            sample_measurement_record(&read_measurement_record);
+        }
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &read_measurement_record,
+                             sizeof(read_measurement_record));
+}
+
 BT_GATT_SERVICE_DEFINE(measurement_service, BT_GATT_PRIMARY_SERVICE(BT_UUID_MEASUREMENT_SERVICE),
                        BT_GATT_CHARACTERISTIC(BT_UUID_HUMIDITY, BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_humidity, NULL, NULL),
                        BT_GATT_CCC(on_cccd_changed_measurement, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
                        BT_GATT_CHARACTERISTIC(BT_UUID_TEMPERATURE, BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_temperature, NULL, NULL),
                        BT_GATT_CCC(on_cccd_changed_measurement, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
-                       BT_GATT_CHARACTERISTIC(BT_UUID_SOIL_MOISTURE, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_soil_moisture, NULL, NULL),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_SOIL_MOISTURE, BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_soil_moisture, NULL, NULL),
+                       BT_GATT_CCC(on_cccd_changed_measurement, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+                       BT_GATT_CHARACTERISTIC(BT_UUID_LIGHT_EXPOSURE, BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_light_exposure, NULL, NULL),
                        BT_GATT_CCC(on_cccd_changed_measurement, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
-                       BT_GATT_CHARACTERISTIC(BT_UUID_LIGHT_EXPOSURE, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_light_exposure, NULL, NULL),
-                       BT_GATT_CCC(on_cccd_changed_measurement, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE));
+                       BT_GATT_CHARACTERISTIC(BT_UUID_MEASUREMENT_RECORD, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, on_read_measurement_record, NULL, NULL));
+
+// --- static functions definitions (need measurement_service) ----------------
+/**
+ * @brief Check if the central is subscribed to at least one measurement characteristic
+ *
+ */
+static bool is_any_measurement_subscribed(void)
+{
+    const uint8_t attr_indexes[] = {HUMIDITY_ATTR_INDEX, TEMPERATURE_ATTR_INDEX,
+                                    SOIL_MOISTURE_ATTR_INDEX, LIGHT_EXPOSURE_ATTR_INDEX};
+
+    for (uint8_t index = 0; index < ARRAY_SIZE(attr_indexes); index++)
+    {
+        if (bt_gatt_is_subscribed(get_ble_connection(), &measurement_service.attrs[attr_indexes[index]], BT_GATT_CCC_NOTIFY))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Work handler that samples every sensor once and notifies the subscribed
+ *        measurement characteristics. Runs on the system workqueue
+ *
+ * @param work
+ */
+static void measurement_notify_work_handler(struct k_work *work)
+{
+    // A field of measurement_values_t (little endian)
+    uint16_t value;
+
+#ifdef ADV_TELEMETRY_MODE
+    // There is no connection in telemetry mode, the measurements are advertised
+    advertise_telemetry_record();
+    return;
+#endif
+
+    if (get_ble_connection() == NULL)
+    {
+        return;
+    }
+
+    // Sample only what the central subscribed to
+    if (bt_gatt_is_subscribed(get_ble_connection(), &measurement_service.attrs[TEMPERATURE_ATTR_INDEX], BT_GATT_CCC_NOTIFY))
+    {
+        value = sys_cpu_to_le16((uint16_t)sample_temperature());
+        measurement_ble_send(&value, sizeof(value), BT_UUID_TEMPERATURE, TEMPERATURE_ATTR_INDEX);
+    }
+    if (bt_gatt_is_subscribed(get_ble_connection(), &measurement_service.attrs[HUMIDITY_ATTR_INDEX], BT_GATT_CCC_NOTIFY))
+    {
+        value = sys_cpu_to_le16(sample_humidity());
+        measurement_ble_send(&value, sizeof(value), BT_UUID_HUMIDITY, HUMIDITY_ATTR_INDEX);
+    }
+    if (bt_gatt_is_subscribed(get_ble_connection(), &measurement_service.attrs[SOIL_MOISTURE_ATTR_INDEX], BT_GATT_CCC_NOTIFY))
+    {
+        value = sys_cpu_to_le16(sample_soil_moisture());
+        measurement_ble_send(&value, sizeof(value), BT_UUID_SOIL_MOISTURE, SOIL_MOISTURE_ATTR_INDEX);
+    }
+    if (bt_gatt_is_subscribed(get_ble_connection(), &measurement_service.attrs[LIGHT_EXPOSURE_ATTR_INDEX], BT_GATT_CCC_NOTIFY))
+    {
+        value = sys_cpu_to_le16(sample_light_exposure());
+        measurement_ble_send(&value, sizeof(value), BT_UUID_LIGHT_EXPOSURE, LIGHT_EXPOSURE_ATTR_INDEX);
+    }
+}
+
+/**
+ * @brief Get the sampling epoch of the central, from the time base of the last
+ *        time beacon
+ *
+ * @return uint16_t epoch, MEASUREMENT_EPOCH_UNSYNCHRONIZED if no beacon was received
+ */
+static uint16_t get_sampling_epoch(void)
+{
+    uint16_t epoch = MEASUREMENT_EPOCH_UNSYNCHRONIZED;
+
+    k_mutex_lock(&epoch_record_mutex, K_FOREVER);
+    if (is_time_synchronized)
+    {
+        epoch = (time_base_epoch + (k_uptime_get() - time_base_start) / epoch_period_ms) % MEASUREMENT_EPOCH_WRAP;
+    }
+    k_mutex_unlock(&epoch_record_mutex);
+
+    return epoch;
+}
+
+/**
+ * @brief Work handler that samples every sensor at the start of a sampling epoch
+ *        and keeps the record for the reads of the central. Runs on the system workqueue
+ *
+ * @param work
+ */
+static void sampling_epoch_work_handler(struct k_work *work)
+{
+    measurement_record_t record;
+
+    sample_measurement_record(&record);
+
+    k_mutex_lock(&epoch_record_mutex, K_FOREVER);
+    epoch_record = record;
+    is_epoch_record_valid = true;
+    k_mutex_unlock(&epoch_record_mutex);
+}
+
+#ifdef ADV_TELEMETRY_MODE
+/**
+ * @brief Sample every sensor once and advertise the measurement record
+ *        (connectionless telemetry mode)
+ *
+ */
+static void advertise_telemetry_record(void)
+{
+    telemetry_adv_record_t record;
+
+    record.company_id = sys_cpu_to_le16(TELEMETRY_ADV_COMPANY_ID);
+    sample_measurement_record(&record.measurement);
+
+    update_telemetry_adv(&record);
+}
+#endif // ADV_TELEMETRY_MODE
 
 // --- functions definitions ---------------------------------------------------
+/**
+ * @brief Get the measurement notify work item. It is submitted by the measurement
+ *        notify timer
+ *
+ * @return struct k_work*
+ */
+struct k_work *get_measurement_notify_work_item(void)
+{
+    return &measurement_notify_work;
+}
+
+/**
+ * @brief Get the sampling epoch work item. It is submitted by the sampling epoch timer
+ *
+ * @return struct k_work*
+ */
+struct k_work *get_sampling_epoch_work_item(void)
+{
+    return &sampling_epoch_work;
+}
+
+/**
+ * @brief Take the time base of the central, written to the time beacon characteristic.
+ *        The sensors are then sampled at the start of every epoch of the central
+ *
+ * @param beacon Time beacon as written by the central (little endian)
+ */
+void set_time_beacon(const time_beacon_t *beacon)
+{
+    uint32_t epoch_time = sys_le32_to_cpu(beacon->epoch_time);
+    uint32_t period_ms = sys_le16_to_cpu(beacon->epoch_period) * MSEC_PER_SEC;
+
+    if (period_ms == 0 || epoch_time >= period_ms)
+    {
+        LOG_INF("Invalid time beacon");
+        return;
+    }
+
+    k_mutex_lock(&epoch_record_mutex, K_FOREVER);
+    time_base_start = k_uptime_get() - epoch_time;
+    time_base_epoch = sys_le16_to_cpu(beacon->epoch);
+    epoch_period_ms = period_ms;
+    is_time_synchronized = true;
+    k_mutex_unlock(&epoch_record_mutex);
+
+    // First sample at the start of the next epoch
+    start_sampling_epoch_timer(K_MSEC(period_ms - epoch_time), K_MSEC(period_ms));
+}
+
+/**
+ * @brief Stop sampling on every epoch (e.g. after disconnection). The time base is
+ *        kept, reads sample on demand and still tag the record with its epoch
+ *
+ */
+void stop_epoch_sampling(void)
+{
+    stop_sampling_epoch_timer();
+
+    k_mutex_lock(&epoch_record_mutex, K_FOREVER);
+    is_epoch_record_valid = false;
+    k_mutex_unlock(&epoch_record_mutex);
+}
+
 void measurement_ble_send(void *data, uint16_t len,
                           const struct bt_uuid *char_uuid, uint8_t attr_index)
 {
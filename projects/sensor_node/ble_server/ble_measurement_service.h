@@ -3,6 +3,7 @@
 
 // --- includes ----------------------------------------------------------------
 #include <stdint.h>
+#include <zephyr/kernel.h>
 
 #include <zephyr/drivers/sensor.h>
 
@@ -11,7 +12,24 @@
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 
+#include "../../common/common.h"
+
+// --- defines -----------------------------------------------------------------
+// Period of the measurement notifications, while the central is subscribed
+#define MEASUREMENT_NOTIFY_PERIOD_IN_SEC 15
+
+// Indexes of the characteristic value attributes on measurement_service.attrs
+// (every characteristic takes a declaration, a value and a CCC attribute)
+#define HUMIDITY_ATTR_INDEX 2
+#define TEMPERATURE_ATTR_INDEX 5
+#define SOIL_MOISTURE_ATTR_INDEX 8
+#define LIGHT_EXPOSURE_ATTR_INDEX 11
+
 // --- functions declarations --------------------------------------------------
+struct k_work *get_measurement_notify_work_item(void);
+struct k_work *get_sampling_epoch_work_item(void);
+void set_time_beacon(const time_beacon_t *beacon);
+void stop_epoch_sampling(void);
 void measurement_ble_send(void *data, uint16_t len, 
                           const struct bt_uuid *char_uuid, uint8_t attr_index);
 
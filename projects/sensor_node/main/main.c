@@ -162,6 +162,10 @@ static void configure_state_entry(void *o)
 
     init_adc_calibration_timer();
     start_adc_calibration_timer(K_SECONDS(1), K_SECONDS(30));
+    // Started when the central subscribes to measurement notifications
+    init_measurement_notify_timer();
+    // Started when the central writes its time base (time beacon)
+    init_sampling_epoch_timer();
 
 #ifdef BME_280
     pm_device_action_run(bme_spi_device, PM_DEVICE_ACTION_SUSPEND);
@@ -191,8 +195,14 @@ static void configure_state_run(void *o)
 
 static void operating_state_run(void *o)
 {
+#ifdef ADV_TELEMETRY_MODE
+    // Advertise the measurements instead of waiting for the central to connect
+    start_telemetry_adv();
+    start_measurement_notify_timer(K_NO_WAIT, K_SECONDS(MEASUREMENT_NOTIFY_PERIOD_IN_SEC));
+#else
     // Start advertising operating adv data
     start_operating_state_adv();
+#endif
 
     k_thread_abort(sensor_fsm_id);
 }
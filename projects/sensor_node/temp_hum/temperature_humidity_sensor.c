@@ -108,6 +108,50 @@ void measure_humidity(void)
 #endif
 }
 
+// Update temp_hum_measurements struct with temperature and humidity of a single
+// sensor fetch (one bus transaction instead of one per channel)
+void measure_temperature_humidity(void)
+{
+    int err;
+
+#ifdef CONFIG_BME280
+    const static struct device *bme_spi_device = DEVICE_DT_GET_ANY(nordic_nrf_spim);
+    pm_device_action_run(bme_spi_device, PM_DEVICE_ACTION_RESUME);
+#endif
+
+    const static struct device *temp_hum_sensor_dev = DEVICE_DT_GET_ANY(TEMP_HUM_SENSOR_TYPE);
+
+    if ((temp_hum_sensor_dev == NULL) || !device_is_ready(temp_hum_sensor_dev))
+    {
+        LOG_INF("Check temp_hum_sensor sensor: not available\n");
+        return;
+    }
+
+    // Take measurements of every channel and store them on sensor buffer
+    err = sensor_sample_fetch(temp_hum_sensor_dev);
+    if (err != 0)
+    {
+        LOG_INF("Error in fetching sample %d", err);
+    }
+
+    err = sensor_channel_get(temp_hum_sensor_dev, SENSOR_CHAN_AMBIENT_TEMP, &temp_hum_measurements.temperature);
+    if (err != 0)
+    {
+        LOG_INF("Error in retreiving sample %d", err);
+    }
+
+    err = sensor_channel_get(temp_hum_sensor_dev, SENSOR_CHAN_HUMIDITY, &temp_hum_measurements.humidity);
+    if (err != 0)
+    {
+        LOG_INF("Error in retreiving sample %d", err);
+    }
+
+#ifdef CONFIG_BME280
+    // Disable spi to save power
+    pm_device_action_run(bme_spi_device, PM_DEVICE_ACTION_SUSPEND);
+#endif
+}
+
 // --- getters -----------------------------------------------------------------
 // Getter for temperature value
 struct sensor_value get_temperature_measurement(void)
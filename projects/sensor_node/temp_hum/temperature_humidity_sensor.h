@@ -26,6 +26,7 @@ typedef struct bme_measurements_s
 // --- functions declarations --------------------------------------------------
 void measure_temperature(void);
 void measure_humidity(void);
+void measure_temperature_humidity(void);
 bool init_temp_hum_sensor(void);
 struct sensor_value get_temperature_measurement(void);
 struct sensor_value get_humidity_measurement(void);
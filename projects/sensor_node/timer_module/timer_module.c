@@ -2,12 +2,15 @@
 #include <zephyr/logging/log.h>
 #include "timer_module.h"
 #include "../adc_calibration/adc_calibration.h"
+#include "../ble_server/ble_measurement_service.h"
 
 // --- logging settings --------------------------------------------------------
 LOG_MODULE_REGISTER(timer_m);
 
 // --- structs -----------------------------------------------------------------
 static struct k_timer adc_calibration_timer;
+static struct k_timer measurement_notify_timer;
+static struct k_timer sampling_epoch_timer;
 
 // --- interrupt handlers  -------------------------------------------
 
@@ -17,6 +20,18 @@ static void adc_calibration_timer_handler(struct k_timer *timer_id)
     k_work_submit(adc_calibration_item);
 }
 
+static void measurement_notify_timer_handler(struct k_timer *timer_id)
+{
+    struct k_work *measurement_notify_item = get_measurement_notify_work_item();
+    k_work_submit(measurement_notify_item);
+}
+
+static void sampling_epoch_timer_handler(struct k_timer *timer_id)
+{
+    struct k_work *sampling_epoch_item = get_sampling_epoch_work_item();
+    k_work_submit(sampling_epoch_item);
+}
+
 // --- functions declarations -------------------------------------------
 void init_adc_calibration_timer(void)
 {
@@ -31,4 +46,34 @@ void start_adc_calibration_timer(k_timeout_t duration, k_timeout_t period)
 void stop_adc_calibration_timer(k_timeout_t duration, k_timeout_t period)
 {
     k_timer_stop(&adc_calibration_timer);
+}
+
+void init_measurement_notify_timer(void)
+{
+    k_timer_init(&measurement_notify_timer, measurement_notify_timer_handler, NULL);
+}
+
+void start_measurement_notify_timer(k_timeout_t duration, k_timeout_t period)
+{
+    k_timer_start(&measurement_notify_timer, duration, period);
+}
+
+void stop_measurement_notify_timer(void)
+{
+    k_timer_stop(&measurement_notify_timer);
+}
+
+void init_sampling_epoch_timer(void)
+{
+    k_timer_init(&sampling_epoch_timer, sampling_epoch_timer_handler, NULL);
+}
+
+void start_sampling_epoch_timer(k_timeout_t duration, k_timeout_t period)
+{
+    k_timer_start(&sampling_epoch_timer, duration, period);
+}
+
+void stop_sampling_epoch_timer(void)
+{
+    k_timer_stop(&sampling_epoch_timer);
 }
\ No newline at end of file
@@ -10,5 +10,11 @@
 void init_adc_calibration_timer(void);
 void start_adc_calibration_timer(k_timeout_t duration, k_timeout_t period);
 void stop_adc_calibration_timer(k_timeout_t duration, k_timeout_t period);
+void init_measurement_notify_timer(void);
+void start_measurement_notify_timer(k_timeout_t duration, k_timeout_t period);
+void stop_measurement_notify_timer(void);
+void init_sampling_epoch_timer(void);
+void start_sampling_epoch_timer(k_timeout_t duration, k_timeout_t period);
+void stop_sampling_epoch_timer(void);
 
 #endif /* INCLUDE_TIMER_MODULE_H */
\ No newline at end of file